@@ -29,6 +29,7 @@ export default (variant: string) => {
     ENABLE_GUI: ENABLE_GRAPHICS,
 
     RENDER_RESOLUTION_X: 1 << 12,
+    SUMMARY_LEAF_SIZE_LOG2: Math.min(10, Number(CHUNK_SIZE_LOG2)), // Finest level of the min/max pyramid plots draw from when zoomed out; see series/summarypyramid.h
 
     // The maximum merge gap in bytes.
     // When updating flags, flags separated by a gap smaller than this value will be merged.
@@ -44,7 +45,8 @@ export default (variant: string) => {
     ENABLE_CHUNK_DEBUG: '!defined(NDEBUG) && 1', // Also requires SPDLOG_ACTIVE_LEVEL to be 'SPDLOG_LEVEL_TRACE' and --log-level trace
     ENABLE_NOTIFICATION_TRACING: '!defined(NDEBUG) && 0', // Requires ENABLE_CHUNK_DEBUG; also requires SPDLOG_ACTIVE_LEVEL to be 'SPDLOG_LEVEL_TRACE' and --log-level trace
 
-    ENABLE_CHUNK_MULTITHREADING: 0,
+    ENABLE_CHUNK_MULTITHREADING: variant.match(/\btsan\b/) ? 1 : 0, // The tsan variants run the regular test suite multithreaded
+    ENABLE_CHUNK_SLAB_ALLOCATOR: 1, // Recycle chunk memory through util::SlabAllocator; see --chunk-hugepages
     ENABLE_FILEPOLLER_YIELD_KEYWORD:
       variant === 'qtc' || variant.match(/\btest\b/) ? 1 : 0, // Only used for tests; has a more predictable effect when multithreading is disabled
     ENABLE_FILEPOLLER_BLOCKING: 0,
@@ -52,18 +54,23 @@ export default (variant: string) => {
     FILEPOLLER_MAX_QUEUE_SIZE: 1000000,
 
     PROPAGATE_EVERY_ROW: variant.match(/\blive\b/) ? 1 : 0,
+    ENABLE_BOUNDED_RETENTION: variant.match(/\blive\b/) ? 1 : 0, // Retire input chunks once they're behind every consumer's lookback, so a long-running process stays in constant memory; see DataSeriesBase::getHorizon()
 
     ENABLE_PMUOI_FLAG: 1, // --print-memory-usage-output-index
 
     INPUT_SERIES_ELEMENT_TYPE: 'double',
 
+    ENABLE_APPROX_SIMD_MATH: 0, // Vectorize exp, log, expm1, tanh and sigmoid with the approximations in util/simdmath.h
+
     CHUNK_SIZE_LOG2,
     CONV_CACHE_KERNEL_FFT_GTE_SIZE_LOG2: 10,
     // CONV_CACHE_TS_FFT_GTE_SIZE_LOG2: CHUNK_SIZE_LOG2 - 2,
     CONV_CACHE_TS_FFT_GTE_SIZE_LOG2: CHUNK_SIZE_LOG2,
     CONV_USE_FFT_GTE_SIZE_LOG2: 10,
+    CONV_BANK_BATCH_SIZE: 4, // Convolutions of the same series run their prior-chunk inverse FFTs this many at a time; see series/type/helper/convbank.h
 
     ENABLE_CONV_MIN_COMPUTE_FLAG: ENABLE_GRAPHICS, // --conv-min-compute-log2
+    ENABLE_SCAN_SPLIT_FLAG: variant.match(/\btest\b/) ? 1 : 0, // --scan-split; only used for tests, see tests/scan.ts
 
     // Refer to https://docs.google.com/spreadsheets/d/1bx1zbFPLz8JTu8aoTONM20n3F2VC5FLHwV885wqKi4I/edit for information on how they work
     CONV_VARIANT: 'series::convvariant::ZpTs1',
@@ -83,6 +90,6 @@ export default (variant: string) => {
     // FFTWX_PLANNING_LEVEL: 'FFTW_PATIENT',
     // FFTWX_PLANNING_LEVEL: 'FFTW_EXHAUSTIVE',
 
-    GARBAGE_COLLECTOR_LEVELS: 1,
+    GARBAGE_COLLECTOR_LEVELS: 8,
   };
 };
@@ -50,6 +50,8 @@ public:
     static void setInstance(Options newInstance);
 
     enum EmitFormat { None, Json, Floats, Doubles };
+    enum class HugePages { None, Transparent, Explicit };
+    enum class InputFormat { Json, Binary };
 
     std::string title;
     std::string wisdomDir;
@@ -57,17 +59,26 @@ public:
     bool writeWisdom = true;
 
     unsigned int convMinComputeLog2 = 0;
+    bool scanSplit = false;
 
     std::size_t gcMemoryLimit = static_cast<std::size_t>(-1);
+    HugePages chunkHugePages = HugePages::Transparent;
+    std::string spillDir;
+    bool compressEvicted = false;
+    std::string chunkCacheDir;
     std::size_t printMemoryUsageOutputIndex = static_cast<std::size_t>(-1);
     std::string debugSeriesToFile;
 
+    InputFormat inputFormat = InputFormat::Json;
     EmitFormat emitFormat = EmitFormat::None;
 
     std::vector<MeterIndex> meterIndices;
 
     std::size_t maxFps = 0;
 
+    // Zero means propagate input as PROPAGATE_EVERY_ROW says, see InputManager::shouldYield()
+    std::size_t propagateLatencyUs = 0;
+
     bool dontExit = false;
 
 private:
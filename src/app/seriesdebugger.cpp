@@ -49,7 +49,9 @@ void SeriesDebugger::tick(app::TickerContext &tickerContext) {
     formatBytes(file, memoryUsage);
     file << " / ";
     formatBytes(file, memoryLimit);
-    file << std::endl << std::endl;
+    file << std::endl;
+    tickerContext.getAppContext().get<series::GarbageCollector<series::ChunkBase>>().writeStats(file);
+    file << std::endl;
 
     for (series::DataSeriesBase *ds : context.get<series::DataSeriesBase::Registry>().registry) {
         ds->writeDebug(file);
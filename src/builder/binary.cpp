@@ -1,14 +1,83 @@
 #include "program/resolver.h"
-#include "series/type/parallelopseries.h"
+#include "series/type/fusedopseries.h"
+#include "util/simd.h"
 
+template <typename RealType> using Vec = typename util::Simd<RealType>::Vec;
+
+template <typename RealType> struct FuncAdd {
+    RealType operator()(RealType a, RealType b) const { return a + b; }
+    Vec<RealType> operator()(Vec<RealType> a, Vec<RealType> b) const { return a + b; }
+};
+template <typename RealType> struct FuncSub {
+    RealType operator()(RealType a, RealType b) const { return a - b; }
+    Vec<RealType> operator()(Vec<RealType> a, Vec<RealType> b) const { return a - b; }
+};
+template <typename RealType> struct FuncMul {
+    RealType operator()(RealType a, RealType b) const { return a * b; }
+    Vec<RealType> operator()(Vec<RealType> a, Vec<RealType> b) const { return a * b; }
+};
+template <typename RealType> struct FuncDiv {
+    RealType operator()(RealType a, RealType b) const { return a / b; }
+    Vec<RealType> operator()(Vec<RealType> a, Vec<RealType> b) const { return a / b; }
+};
 template <typename RealType> struct FuncMod { RealType operator()(RealType a, RealType b) const { return std::fmod(a, b); } };
 template <typename RealType> struct FuncPow { RealType operator()(RealType a, RealType b) const { return std::pow(a, b); } };
 template <typename RealType> struct FuncAtan2 { RealType operator()(RealType a, RealType b) const { return std::atan2(a, b); } };
-template <typename RealType> struct FuncMinimum { RealType operator()(RealType a, RealType b) const { return std::fmin(a, b); } };
-template <typename RealType> struct FuncMaximum { RealType operator()(RealType a, RealType b) const { return std::fmax(a, b); } };
-template <typename RealType> struct FuncShrink { RealType operator()(RealType a, RealType b) const { return a > 0 ? (a <= b ? 0 : a - b) : a < 0 ? (a >= -b ? 0 : a + b) : a; } };
-template <typename RealType> struct FuncClamp { RealType operator()(RealType a, RealType b) const { return std::isnan(a) ? a : std::fmax(-b, std::fmin(a, b)); } };
-template <typename RealType> struct FuncNanTo { RealType operator()(RealType a, RealType b) const { return std::isnan(a) ? b : a; } };
+template <typename RealType> struct FuncLt {
+    static constexpr bool isPredicate = true;
+    RealType operator()(RealType a, RealType b) const { return a < b; }
+    Vec<RealType> operator()(Vec<RealType> a, Vec<RealType> b) const { return util::Simd<RealType>::fromMask(a < b); }
+};
+template <typename RealType> struct FuncLte {
+    static constexpr bool isPredicate = true;
+    RealType operator()(RealType a, RealType b) const { return a <= b; }
+    Vec<RealType> operator()(Vec<RealType> a, Vec<RealType> b) const { return util::Simd<RealType>::fromMask(a <= b); }
+};
+template <typename RealType> struct FuncGt {
+    static constexpr bool isPredicate = true;
+    RealType operator()(RealType a, RealType b) const { return a > b; }
+    Vec<RealType> operator()(Vec<RealType> a, Vec<RealType> b) const { return util::Simd<RealType>::fromMask(a > b); }
+};
+template <typename RealType> struct FuncGte {
+    static constexpr bool isPredicate = true;
+    RealType operator()(RealType a, RealType b) const { return a >= b; }
+    Vec<RealType> operator()(Vec<RealType> a, Vec<RealType> b) const { return util::Simd<RealType>::fromMask(a >= b); }
+};
+template <typename RealType> struct FuncEq {
+    static constexpr bool isPredicate = true;
+    RealType operator()(RealType a, RealType b) const { return a == b; }
+    Vec<RealType> operator()(Vec<RealType> a, Vec<RealType> b) const { return util::Simd<RealType>::fromMask(a == b); }
+};
+template <typename RealType> struct FuncNeq {
+    static constexpr bool isPredicate = true;
+    RealType operator()(RealType a, RealType b) const { return a != b; }
+    Vec<RealType> operator()(Vec<RealType> a, Vec<RealType> b) const { return util::Simd<RealType>::fromMask(a != b); }
+};
+// Like fmin and fmax, a NaN only comes out when both sides are NaN
+template <typename RealType> struct FuncMinimum {
+    RealType operator()(RealType a, RealType b) const { return std::fmin(a, b); }
+    Vec<RealType> operator()(Vec<RealType> a, Vec<RealType> b) const { return util::Simd<RealType>::select((typename util::Simd<RealType>::Mask) (a < b) | util::Simd<RealType>::isNan(b), a, b); }
+};
+template <typename RealType> struct FuncMaximum {
+    RealType operator()(RealType a, RealType b) const { return std::fmax(a, b); }
+    Vec<RealType> operator()(Vec<RealType> a, Vec<RealType> b) const { return util::Simd<RealType>::select((typename util::Simd<RealType>::Mask) (a > b) | util::Simd<RealType>::isNan(b), a, b); }
+};
+template <typename RealType> struct FuncShrink {
+    RealType operator()(RealType a, RealType b) const { return a > 0 ? (a <= b ? 0 : a - b) : a < 0 ? (a >= -b ? 0 : a + b) : a; }
+    Vec<RealType> operator()(Vec<RealType> a, Vec<RealType> b) const {
+        typedef util::Simd<RealType> S;
+        Vec<RealType> zero = S::broadcast(0);
+        return S::select(a > zero, S::select(a <= b, zero, a - b), S::select(a < zero, S::select(a >= -b, zero, a + b), a));
+    }
+};
+template <typename RealType> struct FuncClamp {
+    RealType operator()(RealType a, RealType b) const { return std::isnan(a) ? a : std::fmax(-b, std::fmin(a, b)); }
+    Vec<RealType> operator()(Vec<RealType> a, Vec<RealType> b) const { return util::Simd<RealType>::select(util::Simd<RealType>::isNan(a), a, FuncMaximum<RealType>()(-b, FuncMinimum<RealType>()(a, b))); }
+};
+template <typename RealType> struct FuncNanTo {
+    RealType operator()(RealType a, RealType b) const { return std::isnan(a) ? b : a; }
+    Vec<RealType> operator()(Vec<RealType> a, Vec<RealType> b) const { return util::Simd<RealType>::select(util::Simd<RealType>::isNan(a), b, a); }
+};
 
 template <template <typename> typename Operator>
 void declBinaryOp(app::AppContext &context, program::Resolver &resolver, const char *funcName) {
@@ -17,43 +86,51 @@ void declBinaryOp(app::AppContext &context, program::Resolver &resolver, const c
     resolver.decl(funcName, [](double a, float b) -> double { return Operator<double>()(a, b); });
     resolver.decl(funcName, [](double a, double b) -> double { return Operator<double>()(a, b); });
     resolver.decl(funcName, [&context](series::DataSeries<float> *a, float b){
-        auto op = [b](float a) {return Operator<float>()(a, b);};
-        return new series::ParallelOpSeries<float, decltype(op), series::DataSeries<float> &>(context, op, *a);
+        auto op = [b](auto a) -> decltype(Operator<float>()(a, util::simdBroadcast<decltype(a)>(b))) {
+            return Operator<float>()(a, util::simdBroadcast<decltype(a)>(b));
+        };
+        return series::makeFusedOpSeries<Operator<float>, float>(context, op, *a);
     });
     resolver.decl(funcName, [&context](series::DataSeries<double> *a, double b){
-        auto op = [b](double a) {return Operator<double>()(a, b);};
-        return new series::ParallelOpSeries<double, decltype(op), series::DataSeries<double> &>(context, op, *a);
+        auto op = [b](auto a) -> decltype(Operator<double>()(a, util::simdBroadcast<decltype(a)>(b))) {
+            return Operator<double>()(a, util::simdBroadcast<decltype(a)>(b));
+        };
+        return series::makeFusedOpSeries<Operator<double>, double>(context, op, *a);
     });
     resolver.decl(funcName, [&context](float a, series::DataSeries<float> *b){
-        auto op = [a](float b) {return Operator<float>()(a, b);};
-        return new series::ParallelOpSeries<float, decltype(op), series::DataSeries<float> &>(context, op, *b);
+        auto op = [a](auto b) -> decltype(Operator<float>()(util::simdBroadcast<decltype(b)>(a), b)) {
+            return Operator<float>()(util::simdBroadcast<decltype(b)>(a), b);
+        };
+        return series::makeFusedOpSeries<Operator<float>, float>(context, op, *b);
     });
     resolver.decl(funcName, [&context](double a, series::DataSeries<double> *b){
-        auto op = [a](double b) {return Operator<double>()(a, b);};
-        return new series::ParallelOpSeries<double, decltype(op), series::DataSeries<double> &>(context, op, *b);
+        auto op = [a](auto b) -> decltype(Operator<double>()(util::simdBroadcast<decltype(b)>(a), b)) {
+            return Operator<double>()(util::simdBroadcast<decltype(b)>(a), b);
+        };
+        return series::makeFusedOpSeries<Operator<double>, double>(context, op, *b);
     });
     resolver.decl(funcName, [&context](series::DataSeries<float> *a, series::DataSeries<float> *b){
-        return new series::ParallelOpSeries<float, Operator<float>, series::DataSeries<float> &, series::DataSeries<float> &>(context, Operator<float>(), *a, *b);
+        return series::makeFusedOpSeries<Operator<float>, float>(context, Operator<float>(), *a, *b);
     });
     resolver.decl(funcName, [&context](series::DataSeries<double> *a, series::DataSeries<double> *b){
-        return new series::ParallelOpSeries<double, Operator<double>, series::DataSeries<double> &, series::DataSeries<double> &>(context, Operator<double>(), *a, *b);
+        return series::makeFusedOpSeries<Operator<double>, double>(context, Operator<double>(), *a, *b);
     });
 }
 
 static int _ = program::Resolver::registerBuilder([](app::AppContext &context, program::Resolver &resolver) {
-    declBinaryOp<std::plus>(context, resolver, "add");
-    declBinaryOp<std::minus>(context, resolver, "sub");
-    declBinaryOp<std::multiplies>(context, resolver, "mul");
-    declBinaryOp<std::divides>(context, resolver, "div");
+    declBinaryOp<FuncAdd>(context, resolver, "add");
+    declBinaryOp<FuncSub>(context, resolver, "sub");
+    declBinaryOp<FuncMul>(context, resolver, "mul");
+    declBinaryOp<FuncDiv>(context, resolver, "div");
     declBinaryOp<FuncMod>(context, resolver, "mod");
     declBinaryOp<FuncPow>(context, resolver, "pow");
     declBinaryOp<FuncAtan2>(context, resolver, "atan2");
-    declBinaryOp<std::less>(context, resolver, "lt");
-    declBinaryOp<std::less_equal>(context, resolver, "lte");
-    declBinaryOp<std::greater>(context, resolver, "gt");
-    declBinaryOp<std::greater_equal>(context, resolver, "gte");
-    declBinaryOp<std::equal_to>(context, resolver, "eq");
-    declBinaryOp<std::not_equal_to>(context, resolver, "neq");
+    declBinaryOp<FuncLt>(context, resolver, "lt");
+    declBinaryOp<FuncLte>(context, resolver, "lte");
+    declBinaryOp<FuncGt>(context, resolver, "gt");
+    declBinaryOp<FuncGte>(context, resolver, "gte");
+    declBinaryOp<FuncEq>(context, resolver, "eq");
+    declBinaryOp<FuncNeq>(context, resolver, "neq");
     declBinaryOp<FuncMinimum>(context, resolver, "min");
     declBinaryOp<FuncMaximum>(context, resolver, "max");
     declBinaryOp<FuncShrink>(context, resolver, "shrink");
@@ -0,0 +1,131 @@
+#include "program/resolver.h"
+#include "series/type/multichannelseries.h"
+#include "series/type/helper/matrixkernels.h"
+#include "series/invalidparameterexception.h"
+#include "util/testrunner.h"
+
+template <typename RealType>
+void declMultiChannel(app::AppContext &context, program::Resolver &resolver) {
+    typedef series::DataSeries<RealType> Series;
+    typedef program::ProgObjArray<Series *> SeriesArray;
+
+    resolver.decl("cov_decay", [&context](const SeriesArray &a, RealType rate) {
+        series::DecayedCovarianceKernel<RealType> kernel(a.getArr().size(), rate);
+        return SeriesArray(series::MultiChannelSeries<RealType, decltype(kernel)>::create(context, std::move(kernel), a.getArr()));
+    });
+
+    resolver.decl("pca_decay", [&context](const SeriesArray &a, RealType rate, const program::ProgObjArray<double> &initialVec, std::int64_t iters) {
+        std::vector<RealType> init(initialVec.getArr().cbegin(), initialVec.getArr().cend());
+        series::DecayedPcaKernel<RealType> kernel(a.getArr().size(), rate, std::move(init), iters);
+        return SeriesArray(series::MultiChannelSeries<RealType, decltype(kernel)>::create(context, std::move(kernel), a.getArr()));
+    });
+
+    resolver.decl("regress_decay", [&context](Series *y, const SeriesArray &xs, RealType rate) {
+        std::vector<Series *> inputs;
+        inputs.push_back(y);
+        inputs.insert(inputs.end(), xs.getArr().cbegin(), xs.getArr().cend());
+
+        series::DecayedRegressionKernel<RealType> kernel(xs.getArr().size(), rate);
+        return SeriesArray(series::MultiChannelSeries<RealType, decltype(kernel)>::create(context, std::move(kernel), std::move(inputs)));
+    });
+
+    resolver.decl("solve", [&context](const SeriesArray &a, const SeriesArray &b) {
+        std::size_t size = b.getArr().size();
+        if (a.getArr().size() != size * size) {
+            throw series::InvalidParameterException("solve: Expected " + std::to_string(size * size) + " matrix entries for " + std::to_string(size) + " equations, got " + std::to_string(a.getArr().size()));
+        }
+
+        std::vector<Series *> inputs = a.getArr();
+        inputs.insert(inputs.end(), b.getArr().cbegin(), b.getArr().cend());
+
+        series::SolveKernel<RealType> kernel(size);
+        return SeriesArray(series::MultiChannelSeries<RealType, decltype(kernel)>::create(context, std::move(kernel), std::move(inputs)));
+    });
+
+    resolver.decl("at", [](const SeriesArray &a, std::int64_t index) {
+        if (index < 0 || static_cast<std::size_t>(index) >= a.getArr().size()) {
+            throw series::InvalidParameterException("at: Index " + std::to_string(index) + " is out of range for an array of " + std::to_string(a.getArr().size()));
+        }
+        return a.getArr()[index];
+    });
+}
+
+static int _ = program::Resolver::registerBuilder([](app::AppContext &context, program::Resolver &resolver) {
+    declMultiChannel<float>(context, resolver);
+    declMultiChannel<double>(context, resolver);
+});
+
+// Checks the kernels against the scalar math ts/mat.ts does with a series per entry
+static int _test = util::TestRunner::getInstance().registerTest([](app::AppContext &context) {
+    (void) context;
+
+    static constexpr std::size_t size = 3;
+    static constexpr double rate = 0.05;
+    static constexpr double tolerance = 1e-9;
+
+    std::vector<std::vector<double>> rows;
+    for (std::size_t t = 0; t < 200; t++) {
+        std::vector<double> row(size + 1);
+        for (std::size_t i = 0; i <= size; i++) {
+            row[i] = std::sin(t * (0.3 + i * 0.17)) + (t % (i + 5) == 0 ? 0.5 : 0.0);
+        }
+        if (t == 50) {
+            row[1] = NAN;
+        }
+        rows.push_back(std::move(row));
+    }
+
+    // Same as decay(window, mul(s0, s1)) for each pair
+    series::DecayedCovarianceKernel<double> covKernel(size + 1, rate);
+    series::DecayedCovarianceKernel<double>::State covState = covKernel.getInitialState();
+    std::vector<double> expectedCov((size + 1) * (size + 1), 0.0);
+    std::vector<double> cov((size + 1) * (size + 1));
+    for (const std::vector<double> &row : rows) {
+        for (std::size_t i = 0; i <= size; i++) {
+            for (std::size_t j = 0; j <= size; j++) {
+                double product = row[i] * row[j];
+                expectedCov[i * (size + 1) + j] = expectedCov[i * (size + 1) + j] * (1.0 - rate) + (std::isfinite(product) ? product : 0.0) * rate;
+            }
+        }
+
+        covKernel.step(covState, row.data(), cov.data(), 1);
+        for (std::size_t i = 0; i < cov.size(); i++) {
+            assert(std::fabs(cov[i] - expectedCov[i]) < tolerance);
+        }
+    }
+
+    // The regression coefficients solve the regressors' block of the covariance against their covariance with the target
+    series::DecayedRegressionKernel<double> regressKernel(size, rate);
+    series::DecayedRegressionKernel<double>::State regressState = regressKernel.getInitialState();
+    std::vector<double> coefs(size);
+    for (const std::vector<double> &row : rows) {
+        regressKernel.step(regressState, row.data(), coefs.data(), 1);
+    }
+    for (std::size_t i = 0; i < size; i++) {
+        double sum = 0.0;
+        for (std::size_t j = 0; j < size; j++) {
+            sum += expectedCov[(i + 1) * (size + 1) + j + 1] * coefs[j];
+        }
+        assert(std::fabs(sum - expectedCov[(i + 1) * (size + 1)]) < tolerance);
+        (void) sum;
+    }
+
+    // Solving A x = b for b = A x gives back x, like mSolveTest()
+    series::SolveKernel<double> solveKernel(size);
+    series::SolveKernel<double>::State solveState = solveKernel.getInitialState();
+    static constexpr double a[size * size] = {2.0, -0.5, 0.25, 0.75, 1.5, -1.0, -0.3, 0.4, 1.2};
+    static constexpr double x[size] = {0.4, -1.1, 0.7};
+    std::vector<double> inputs(a, a + size * size);
+    for (std::size_t i = 0; i < size; i++) {
+        double sum = 0.0;
+        for (std::size_t j = 0; j < size; j++) {
+            sum += a[i * size + j] * x[j];
+        }
+        inputs.push_back(sum);
+    }
+    std::vector<double> solution(size);
+    solveKernel.step(solveState, inputs.data(), solution.data(), 1);
+    for (std::size_t i = 0; i < size; i++) {
+        assert(std::fabs(solution[i] - x[i]) < tolerance);
+    }
+});
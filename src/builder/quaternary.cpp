@@ -1,69 +1,105 @@
 #include "program/resolver.h"
-#include "series/type/parallelopseries.h"
+#include "series/type/fusedopseries.h"
+#include "util/simd.h"
 
-template <typename RealType> struct FuncTriCond { RealType operator()(RealType a, RealType b, RealType c, RealType d) const { return a < static_cast<RealType>(0.0) ? b : a > static_cast<RealType>(0.0) ? d : c; } };
+template <typename RealType> using Vec = typename util::Simd<RealType>::Vec;
+
+template <typename RealType> struct FuncTriCond {
+    RealType operator()(RealType a, RealType b, RealType c, RealType d) const { return a < static_cast<RealType>(0.0) ? b : a > static_cast<RealType>(0.0) ? d : c; }
+    Vec<RealType> operator()(Vec<RealType> a, Vec<RealType> b, Vec<RealType> c, Vec<RealType> d) const {
+        return util::Simd<RealType>::select(a < static_cast<RealType>(0.0), b, util::Simd<RealType>::select(a > static_cast<RealType>(0.0), d, c));
+    }
+};
 
 template <template <typename> typename Operator, typename RealType>
 void declQuaternaryOp(app::AppContext &context, program::Resolver &resolver, const char *funcName) {
     resolver.decl(funcName, [](RealType a, RealType b, RealType c, RealType d) -> RealType { return Operator<RealType>()(a, b, c, d); });
     resolver.decl(funcName, [&context](RealType a, RealType b, RealType c, series::DataSeries<RealType> *d){
-        auto op = [a, b, c](RealType d) {return Operator<RealType>()(a, b, c, d);};
-        return new series::ParallelOpSeries<RealType, decltype(op), series::DataSeries<RealType> &>(context, op, *d);
+        auto op = [a, b, c](auto d) -> decltype(Operator<RealType>()(util::simdBroadcast<decltype(d)>(a), util::simdBroadcast<decltype(d)>(b), util::simdBroadcast<decltype(d)>(c), d)) {
+            return Operator<RealType>()(util::simdBroadcast<decltype(d)>(a), util::simdBroadcast<decltype(d)>(b), util::simdBroadcast<decltype(d)>(c), d);
+        };
+        return new series::FusedOpSeries<RealType>(context, op, *d);
     });
     resolver.decl(funcName, [&context](RealType a, RealType b, series::DataSeries<RealType> *c, RealType d){
-        auto op = [a, b, d](RealType c) {return Operator<RealType>()(a, b, c, d);};
-        return new series::ParallelOpSeries<RealType, decltype(op), series::DataSeries<RealType> &>(context, op, *c);
+        auto op = [a, b, d](auto c) -> decltype(Operator<RealType>()(util::simdBroadcast<decltype(c)>(a), util::simdBroadcast<decltype(c)>(b), c, util::simdBroadcast<decltype(c)>(d))) {
+            return Operator<RealType>()(util::simdBroadcast<decltype(c)>(a), util::simdBroadcast<decltype(c)>(b), c, util::simdBroadcast<decltype(c)>(d));
+        };
+        return new series::FusedOpSeries<RealType>(context, op, *c);
     });
     resolver.decl(funcName, [&context](RealType a, RealType b, series::DataSeries<RealType> *c, series::DataSeries<RealType> *d){
-        auto op = [a, b](RealType c, RealType d) {return Operator<RealType>()(a, b, c, d);};
-        return new series::ParallelOpSeries<RealType, decltype(op), series::DataSeries<RealType> &, series::DataSeries<RealType> &>(context, op, *c, *d);
+        auto op = [a, b](auto c, auto d) -> decltype(Operator<RealType>()(util::simdBroadcast<decltype(c)>(a), util::simdBroadcast<decltype(c)>(b), c, d)) {
+            return Operator<RealType>()(util::simdBroadcast<decltype(c)>(a), util::simdBroadcast<decltype(c)>(b), c, d);
+        };
+        return new series::FusedOpSeries<RealType>(context, op, *c, *d);
     });
     resolver.decl(funcName, [&context](RealType a, series::DataSeries<RealType> *b, RealType c, RealType d){
-        auto op = [a, c, d](RealType b) {return Operator<RealType>()(a, b, c, d);};
-        return new series::ParallelOpSeries<RealType, decltype(op), series::DataSeries<RealType> &>(context, op, *b);
+        auto op = [a, c, d](auto b) -> decltype(Operator<RealType>()(util::simdBroadcast<decltype(b)>(a), b, util::simdBroadcast<decltype(b)>(c), util::simdBroadcast<decltype(b)>(d))) {
+            return Operator<RealType>()(util::simdBroadcast<decltype(b)>(a), b, util::simdBroadcast<decltype(b)>(c), util::simdBroadcast<decltype(b)>(d));
+        };
+        return new series::FusedOpSeries<RealType>(context, op, *b);
     });
     resolver.decl(funcName, [&context](RealType a, series::DataSeries<RealType> *b, RealType c, series::DataSeries<RealType> *d){
-        auto op = [a, c](RealType b, RealType d) {return Operator<RealType>()(a, b, c, d);};
-        return new series::ParallelOpSeries<RealType, decltype(op), series::DataSeries<RealType> &, series::DataSeries<RealType> &>(context, op, *b, *d);
+        auto op = [a, c](auto b, auto d) -> decltype(Operator<RealType>()(util::simdBroadcast<decltype(b)>(a), b, util::simdBroadcast<decltype(b)>(c), d)) {
+            return Operator<RealType>()(util::simdBroadcast<decltype(b)>(a), b, util::simdBroadcast<decltype(b)>(c), d);
+        };
+        return new series::FusedOpSeries<RealType>(context, op, *b, *d);
     });
     resolver.decl(funcName, [&context](RealType a, series::DataSeries<RealType> *b, series::DataSeries<RealType> *c, RealType d){
-        auto op = [a, d](RealType b, RealType c) {return Operator<RealType>()(a, b, c, d);};
-        return new series::ParallelOpSeries<RealType, decltype(op), series::DataSeries<RealType> &, series::DataSeries<RealType> &>(context, op, *b, *c);
+        auto op = [a, d](auto b, auto c) -> decltype(Operator<RealType>()(util::simdBroadcast<decltype(b)>(a), b, c, util::simdBroadcast<decltype(b)>(d))) {
+            return Operator<RealType>()(util::simdBroadcast<decltype(b)>(a), b, c, util::simdBroadcast<decltype(b)>(d));
+        };
+        return new series::FusedOpSeries<RealType>(context, op, *b, *c);
     });
     resolver.decl(funcName, [&context](RealType a, series::DataSeries<RealType> *b, series::DataSeries<RealType> *c, series::DataSeries<RealType> *d){
-        auto op = [a](RealType b, RealType c, RealType d) {return Operator<RealType>()(a, b, c, d);};
-        return new series::ParallelOpSeries<RealType, decltype(op), series::DataSeries<RealType> &, series::DataSeries<RealType> &, series::DataSeries<RealType> &>(context, op, *b, *c, *d);
+        auto op = [a](auto b, auto c, auto d) -> decltype(Operator<RealType>()(util::simdBroadcast<decltype(b)>(a), b, c, d)) {
+            return Operator<RealType>()(util::simdBroadcast<decltype(b)>(a), b, c, d);
+        };
+        return new series::FusedOpSeries<RealType>(context, op, *b, *c, *d);
     });
     resolver.decl(funcName, [&context](series::DataSeries<RealType> *a, RealType b, RealType c, RealType d){
-        auto op = [b, c, d](RealType a) {return Operator<RealType>()(a, b, c, d);};
-        return new series::ParallelOpSeries<RealType, decltype(op), series::DataSeries<RealType> &>(context, op, *a);
+        auto op = [b, c, d](auto a) -> decltype(Operator<RealType>()(a, util::simdBroadcast<decltype(a)>(b), util::simdBroadcast<decltype(a)>(c), util::simdBroadcast<decltype(a)>(d))) {
+            return Operator<RealType>()(a, util::simdBroadcast<decltype(a)>(b), util::simdBroadcast<decltype(a)>(c), util::simdBroadcast<decltype(a)>(d));
+        };
+        return new series::FusedOpSeries<RealType>(context, op, *a);
     });
     resolver.decl(funcName, [&context](series::DataSeries<RealType> *a, RealType b, RealType c, series::DataSeries<RealType> *d){
-        auto op = [b, c](RealType a, RealType d) {return Operator<RealType>()(a, b, c, d);};
-        return new series::ParallelOpSeries<RealType, decltype(op), series::DataSeries<RealType> &, series::DataSeries<RealType> &>(context, op, *a, *d);
+        auto op = [b, c](auto a, auto d) -> decltype(Operator<RealType>()(a, util::simdBroadcast<decltype(a)>(b), util::simdBroadcast<decltype(a)>(c), d)) {
+            return Operator<RealType>()(a, util::simdBroadcast<decltype(a)>(b), util::simdBroadcast<decltype(a)>(c), d);
+        };
+        return new series::FusedOpSeries<RealType>(context, op, *a, *d);
     });
     resolver.decl(funcName, [&context](series::DataSeries<RealType> *a, RealType b, series::DataSeries<RealType> *c, RealType d){
-        auto op = [b, d](RealType a, RealType c) {return Operator<RealType>()(a, b, c, d);};
-        return new series::ParallelOpSeries<RealType, decltype(op), series::DataSeries<RealType> &, series::DataSeries<RealType> &>(context, op, *a, *c);
+        auto op = [b, d](auto a, auto c) -> decltype(Operator<RealType>()(a, util::simdBroadcast<decltype(a)>(b), c, util::simdBroadcast<decltype(a)>(d))) {
+            return Operator<RealType>()(a, util::simdBroadcast<decltype(a)>(b), c, util::simdBroadcast<decltype(a)>(d));
+        };
+        return new series::FusedOpSeries<RealType>(context, op, *a, *c);
     });
     resolver.decl(funcName, [&context](series::DataSeries<RealType> *a, RealType b, series::DataSeries<RealType> *c, series::DataSeries<RealType> *d){
-        auto op = [b](RealType a, RealType c, RealType d) {return Operator<RealType>()(a, b, c, d);};
-        return new series::ParallelOpSeries<RealType, decltype(op), series::DataSeries<RealType> &, series::DataSeries<RealType> &, series::DataSeries<RealType> &>(context, op, *a, *c, *d);
+        auto op = [b](auto a, auto c, auto d) -> decltype(Operator<RealType>()(a, util::simdBroadcast<decltype(a)>(b), c, d)) {
+            return Operator<RealType>()(a, util::simdBroadcast<decltype(a)>(b), c, d);
+        };
+        return new series::FusedOpSeries<RealType>(context, op, *a, *c, *d);
     });
     resolver.decl(funcName, [&context](series::DataSeries<RealType> *a, series::DataSeries<RealType> *b, RealType c, RealType d){
-        auto op = [c, d](RealType a, RealType b) {return Operator<RealType>()(a, b, c, d);};
-        return new series::ParallelOpSeries<RealType, decltype(op), series::DataSeries<RealType> &, series::DataSeries<RealType> &>(context, op, *a, *b);
+        auto op = [c, d](auto a, auto b) -> decltype(Operator<RealType>()(a, b, util::simdBroadcast<decltype(a)>(c), util::simdBroadcast<decltype(a)>(d))) {
+            return Operator<RealType>()(a, b, util::simdBroadcast<decltype(a)>(c), util::simdBroadcast<decltype(a)>(d));
+        };
+        return new series::FusedOpSeries<RealType>(context, op, *a, *b);
     });
     resolver.decl(funcName, [&context](series::DataSeries<RealType> *a, series::DataSeries<RealType> *b, RealType c, series::DataSeries<RealType> *d){
-        auto op = [c](RealType a, RealType b, RealType d) {return Operator<RealType>()(a, b, c, d);};
-        return new series::ParallelOpSeries<RealType, decltype(op), series::DataSeries<RealType> &, series::DataSeries<RealType> &, series::DataSeries<RealType> &>(context, op, *a, *b, *d);
+        auto op = [c](auto a, auto b, auto d) -> decltype(Operator<RealType>()(a, b, util::simdBroadcast<decltype(a)>(c), d)) {
+            return Operator<RealType>()(a, b, util::simdBroadcast<decltype(a)>(c), d);
+        };
+        return new series::FusedOpSeries<RealType>(context, op, *a, *b, *d);
     });
     resolver.decl(funcName, [&context](series::DataSeries<RealType> *a, series::DataSeries<RealType> *b, series::DataSeries<RealType> *c, RealType d){
-        auto op = [d](RealType a, RealType b, RealType c) {return Operator<RealType>()(a, b, c, d);};
-        return new series::ParallelOpSeries<RealType, decltype(op), series::DataSeries<RealType> &, series::DataSeries<RealType> &, series::DataSeries<RealType> &>(context, op, *a, *b, *c);
+        auto op = [d](auto a, auto b, auto c) -> decltype(Operator<RealType>()(a, b, c, util::simdBroadcast<decltype(a)>(d))) {
+            return Operator<RealType>()(a, b, c, util::simdBroadcast<decltype(a)>(d));
+        };
+        return new series::FusedOpSeries<RealType>(context, op, *a, *b, *c);
     });
     resolver.decl(funcName, [&context](series::DataSeries<RealType> *a, series::DataSeries<RealType> *b, series::DataSeries<RealType> *c, series::DataSeries<RealType> *d){
-        return new series::ParallelOpSeries<RealType, Operator<RealType>, series::DataSeries<RealType> &, series::DataSeries<RealType> &, series::DataSeries<RealType> &, series::DataSeries<RealType> &>(context, Operator<RealType>(), *a, *b, *c, *d);
+        return new series::FusedOpSeries<RealType>(context, Operator<RealType>(), *a, *b, *c, *d);
     });
 }
 
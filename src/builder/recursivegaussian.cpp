@@ -0,0 +1,102 @@
+#include "program/resolver.h"
+#include "series/type/recursivegaussianseries.h"
+#include "util/testrunner.h"
+
+template <typename RealType>
+void declRecursiveGaussian(app::AppContext &context, program::Resolver &resolver) {
+    typedef series::RecursiveGaussianFilter Filter;
+
+    resolver.decl("recursive_gaussian", [&context](series::DataSeries<RealType> *a, RealType scale, std::int64_t width, std::int64_t order, bool backfillZeros) {
+        Filter filter({{scale, 1.0}}, false, order, width, backfillZeros);
+        return new series::RecursiveGaussianSeries<RealType>(context, *a, std::move(filter));
+    });
+    resolver.decl("recursive_gaussian_smooth", [&context](series::DataSeries<RealType> *a, RealType scale_0, RealType scale_1, std::int64_t width, std::int64_t order, bool backfillZeros) {
+        Filter filter({{scale_0, 1.0}, {scale_1, -1.0}}, false, order, width, backfillZeros);
+        return new series::RecursiveGaussianSeries<RealType>(context, *a, std::move(filter));
+    });
+    resolver.decl("recursive_gaussian_delta", [&context](series::DataSeries<RealType> *a, RealType scale_0, RealType scale_1, std::int64_t width, std::int64_t order, bool backfillZeros) {
+        Filter filter({{scale_0, 1.0}, {scale_1, -1.0}}, true, order, width, backfillZeros);
+        return new series::RecursiveGaussianSeries<RealType>(context, *a, std::move(filter));
+    });
+}
+
+static int _ = program::Resolver::registerBuilder([](app::AppContext &context, program::Resolver &resolver) {
+    declRecursiveGaussian<float>(context, resolver);
+    declRecursiveGaussian<double>(context, resolver);
+});
+
+// Checks the filter against what conv() computes with the matching window kernel from ts/base.ts
+static int _test = util::TestRunner::getInstance().registerTest([](app::AppContext &context) {
+    typedef series::RecursiveGaussianFilter Filter;
+
+    auto gaussian = [](double scale, std::int64_t width) {
+        // Same as norm(gaussian(scale), width)
+        std::vector<double> kernel(width);
+        double sum = 0.0;
+        for (std::int64_t i = 0; i < width; i++) {
+            kernel[i] = std::exp(-(i / scale) * (i / scale));
+            sum += kernel[i];
+        }
+        for (double &value : kernel) {
+            value /= sum;
+        }
+        return kernel;
+    };
+
+    auto check = [](const Filter &filter, const std::vector<double> &kernel, double tolerance) {
+        std::size_t size = kernel.size() * 3;
+        std::vector<double> input(size);
+        for (std::size_t i = 0; i < size; i++) {
+            input[i] = std::sin(i * 0.37) + (i % 7 == 0 ? 1.0 : 0.0);
+        }
+        input[size / 2] = NAN;
+
+        Filter::State state = filter.getInitialState();
+        std::int64_t nanEnd = kernel.size() - 1;
+        for (std::size_t t = 0; t < size; t++) {
+            if (std::isnan(input[t])) {
+                nanEnd = t + kernel.size();
+            }
+
+            double actual = filter.step(state, input[t]);
+            if (static_cast<std::int64_t>(t) < nanEnd) {
+                assert(std::isnan(actual));
+                continue;
+            }
+
+            double expected = 0.0;
+            for (std::size_t j = 0; j < kernel.size() && j <= t; j++) {
+                expected += kernel[j] * input[t - j];
+            }
+            assert(std::fabs(actual - expected) < tolerance);
+            (void) expected;
+        }
+    };
+
+    for (double scale : {1.5, 10.0, 200.0}) {
+        std::int64_t width = std::sqrt(-std::log(1e-9)) * scale * 2.0 + 1.0;
+        std::vector<double> g0 = gaussian(scale, width);
+        std::vector<double> g1 = gaussian(scale * 2.0, width);
+
+        std::vector<double> simple = g0;
+        std::vector<double> delta(width);
+        std::vector<double> smooth(width);
+        double smoothSum = 0.0;
+        for (std::int64_t i = 0; i < width; i++) {
+            delta[i] = g0[i] - g1[i];
+            smooth[i] = std::exp(-(i / scale) * (i / scale)) - std::exp(-(i / scale / 2.0) * (i / scale / 2.0));
+            smoothSum += smooth[i];
+        }
+        for (double &value : smooth) {
+            value /= smoothSum;
+        }
+
+        static constexpr double tolerances[Filter::maxOrder] = {1e-1, 2e-3, 5e-5, 2e-6};
+        for (std::int64_t order = 1; order <= Filter::maxOrder; order++) {
+            double tolerance = tolerances[order - 1];
+            check(Filter({{scale, 1.0}}, false, order, width, false), simple, tolerance);
+            check(Filter({{scale, 1.0}, {scale * 2.0, -1.0}}, true, order, width, false), delta, tolerance);
+            check(Filter({{scale, 1.0}, {scale * 2.0, -1.0}}, false, order, width, false), smooth, tolerance);
+        }
+    }
+});
@@ -8,6 +8,7 @@ template <typename RealType> struct DecayingPlus {
     {}
 
     RealType operator()(RealType a, RealType b) const { return a * mul1 + b * mul2; }
+    RealType getCarryFactor() const { return mul1; }
 
 private:
     RealType mul1;
@@ -19,6 +20,7 @@ template <typename RealType> struct DecayingPlusVarying {
 };
 
 template <typename RealType> struct LogSumExp {
+    static constexpr bool isAssociative = true;
     RealType operator()(RealType a, RealType b) const {
         RealType max = std::max(a, b);
         a = std::exp(a - max);
@@ -34,10 +36,12 @@ template <typename RealType> struct ClampedSum {
 };
 
 template <typename RealType> struct FuncFwdFillZero {
+    static constexpr bool isAssociative = true;
     RealType operator()(RealType a, RealType b) const { return b == static_cast<RealType>(0.0) ? a : b; }
 };
 
 template <typename RealType> struct FuncMonotonify {
+    static constexpr bool isAssociative = true;
     RealType operator()(RealType a, RealType b) const { return std::max(a, b); }
 };
 
@@ -59,6 +63,13 @@ template <typename RealType> struct FuncScanIf {
     RealType operator()(RealType prev, RealType cond, RealType _else) const { return cond && std::isfinite(cond) ? prev : _else; }
 };
 
+template <template <typename> typename Operator> struct FuncAssociativeOp {
+    template <typename RealType>
+    struct type : Operator<RealType> {
+        static constexpr bool isAssociative = true;
+    };
+};
+
 template <template <typename> typename Operator> struct FuncSafeOp {
     template <typename RealType>
     struct type : private Operator<RealType> {
@@ -71,6 +82,12 @@ template <template <typename> typename Operator> struct FuncSafeOp {
         RealType operator()(ArgTypes... args) const {
             return Operator<RealType>::operator()((std::isfinite(args) ? args : RealType(0.0))...);
         }
+
+        // Mapping non-finite values to zero keeps these properties, see ScannedSeries
+        static constexpr bool isAssociative = requires { requires Operator<RealType>::isAssociative; };
+        RealType getCarryFactor() const requires requires (const Operator<RealType> &op) { op.getCarryFactor(); } {
+            return Operator<RealType>::getCarryFactor();
+        }
     };
 };
 
@@ -114,10 +131,10 @@ void declScanTernaryOp(app::AppContext &context, program::Resolver &resolver, co
 }
 
 static int _ = program::Resolver::registerBuilder([](app::AppContext &context, program::Resolver &resolver) {
-    declScanOp<FuncSafeOp<std::plus>::type>(context, resolver, "cum_sum", 0.0);
+    declScanOp<FuncSafeOp<FuncAssociativeOp<std::plus>::type>::type>(context, resolver, "cum_sum", 0.0);
     declScanOp<FuncSafeOp<ClampedSum>::type>(context, resolver, "cum_sum_clamped", 0.0);
     declScanOpP1<FuncSafeOp<DecayingPlus>::type, FuncSafeOp<DecayingPlusVarying>::type>(context, resolver, "decaying_sum", 0.0);
-    declScanOp<FuncSafeOp<std::multiplies>::type>(context, resolver, "cum_prod", 1.0);
+    declScanOp<FuncSafeOp<FuncAssociativeOp<std::multiplies>::type>::type>(context, resolver, "cum_prod", 1.0);
     declScanOp<FuncSafeOp<LogSumExp>::type>(context, resolver, "cum_log_sum_exp", 0.0);
     declScanOp<FuncSafeOp<FuncFwdFillZero>::type>(context, resolver, "fwd_fill_zero", 0.0);
     declScanOp<FuncSafeOp<FuncMonotonify>::type>(context, resolver, "monotonify", -INFINITY);
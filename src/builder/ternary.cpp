@@ -1,37 +1,56 @@
 #include "program/resolver.h"
-#include "series/type/parallelopseries.h"
+#include "series/type/fusedopseries.h"
+#include "util/simd.h"
 
-template <typename RealType> struct FuncCond { RealType operator()(RealType a, RealType b, RealType c) const { return a ? b : c; } };
+template <typename RealType> using Vec = typename util::Simd<RealType>::Vec;
+
+template <typename RealType> struct FuncCond {
+    RealType operator()(RealType a, RealType b, RealType c) const { return a ? b : c; }
+    // NaN is truthy here too, since it compares unequal to zero
+    Vec<RealType> operator()(Vec<RealType> a, Vec<RealType> b, Vec<RealType> c) const { return util::Simd<RealType>::select(a != static_cast<RealType>(0), b, c); }
+};
 
 template <template <typename> typename Operator, typename RealType>
 void declTernaryOp(app::AppContext &context, program::Resolver &resolver, const char *funcName) {
     resolver.decl(funcName, [](RealType a, RealType b, RealType c) -> RealType { return Operator<RealType>()(a, b, c); });
     resolver.decl(funcName, [&context](RealType a, RealType b, series::DataSeries<RealType> *c){
-        auto op = [a, b](RealType c) {return Operator<RealType>()(a, b, c);};
-        return new series::ParallelOpSeries<RealType, decltype(op), series::DataSeries<RealType> &>(context, op, *c);
+        auto op = [a, b](auto c) -> decltype(Operator<RealType>()(util::simdBroadcast<decltype(c)>(a), util::simdBroadcast<decltype(c)>(b), c)) {
+            return Operator<RealType>()(util::simdBroadcast<decltype(c)>(a), util::simdBroadcast<decltype(c)>(b), c);
+        };
+        return new series::FusedOpSeries<RealType>(context, op, *c);
     });
     resolver.decl(funcName, [&context](RealType a, series::DataSeries<RealType> *b, RealType c){
-        auto op = [a, c](RealType b) {return Operator<RealType>()(a, b, c);};
-        return new series::ParallelOpSeries<RealType, decltype(op), series::DataSeries<RealType> &>(context, op, *b);
+        auto op = [a, c](auto b) -> decltype(Operator<RealType>()(util::simdBroadcast<decltype(b)>(a), b, util::simdBroadcast<decltype(b)>(c))) {
+            return Operator<RealType>()(util::simdBroadcast<decltype(b)>(a), b, util::simdBroadcast<decltype(b)>(c));
+        };
+        return new series::FusedOpSeries<RealType>(context, op, *b);
     });
     resolver.decl(funcName, [&context](RealType a, series::DataSeries<RealType> *b, series::DataSeries<RealType> *c){
-        auto op = [a](RealType b, RealType c) {return Operator<RealType>()(a, b, c);};
-        return new series::ParallelOpSeries<RealType, decltype(op), series::DataSeries<RealType> &, series::DataSeries<RealType> &>(context, op, *b, *c);
+        auto op = [a](auto b, auto c) -> decltype(Operator<RealType>()(util::simdBroadcast<decltype(b)>(a), b, c)) {
+            return Operator<RealType>()(util::simdBroadcast<decltype(b)>(a), b, c);
+        };
+        return new series::FusedOpSeries<RealType>(context, op, *b, *c);
     });
     resolver.decl(funcName, [&context](series::DataSeries<RealType> *a, RealType b, RealType c){
-        auto op = [b, c](RealType a) {return Operator<RealType>()(a, b, c);};
-        return new series::ParallelOpSeries<RealType, decltype(op), series::DataSeries<RealType> &>(context, op, *a);
+        auto op = [b, c](auto a) -> decltype(Operator<RealType>()(a, util::simdBroadcast<decltype(a)>(b), util::simdBroadcast<decltype(a)>(c))) {
+            return Operator<RealType>()(a, util::simdBroadcast<decltype(a)>(b), util::simdBroadcast<decltype(a)>(c));
+        };
+        return new series::FusedOpSeries<RealType>(context, op, *a);
     });
     resolver.decl(funcName, [&context](series::DataSeries<RealType> *a, RealType b, series::DataSeries<RealType> *c){
-        auto op = [b](RealType a, RealType c) {return Operator<RealType>()(a, b, c);};
-        return new series::ParallelOpSeries<RealType, decltype(op), series::DataSeries<RealType> &, series::DataSeries<RealType> &>(context, op, *a, *c);
+        auto op = [b](auto a, auto c) -> decltype(Operator<RealType>()(a, util::simdBroadcast<decltype(a)>(b), c)) {
+            return Operator<RealType>()(a, util::simdBroadcast<decltype(a)>(b), c);
+        };
+        return new series::FusedOpSeries<RealType>(context, op, *a, *c);
     });
     resolver.decl(funcName, [&context](series::DataSeries<RealType> *a, series::DataSeries<RealType> *b, RealType c){
-        auto op = [c](RealType a, RealType b) {return Operator<RealType>()(a, b, c);};
-        return new series::ParallelOpSeries<RealType, decltype(op), series::DataSeries<RealType> &, series::DataSeries<RealType> &>(context, op, *a, *b);
+        auto op = [c](auto a, auto b) -> decltype(Operator<RealType>()(a, b, util::simdBroadcast<decltype(a)>(c))) {
+            return Operator<RealType>()(a, b, util::simdBroadcast<decltype(a)>(c));
+        };
+        return new series::FusedOpSeries<RealType>(context, op, *a, *b);
     });
     resolver.decl(funcName, [&context](series::DataSeries<RealType> *a, series::DataSeries<RealType> *b, series::DataSeries<RealType> *c){
-        return new series::ParallelOpSeries<RealType, Operator<RealType>, series::DataSeries<RealType> &, series::DataSeries<RealType> &, series::DataSeries<RealType> &>(context, Operator<RealType>(), *a, *b, *c);
+        return new series::FusedOpSeries<RealType>(context, Operator<RealType>(), *a, *b, *c);
     });
 }
 
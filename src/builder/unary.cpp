@@ -1,23 +1,65 @@
 #include "program/resolver.h"
-#include "series/type/parallelopseries.h"
+#include "series/type/fusedopseries.h"
+#include "util/simd.h"
+#include "util/simdmath.h"
+
+#include "defs/ENABLE_APPROX_SIMD_MATH.h"
+
+// Ops that also take a Vec get vectorized
+template <typename RealType> using Vec = typename util::Simd<RealType>::Vec;
 
 template <typename RealType> struct FuncSgn {
     RealType operator()(RealType a) const {
         static_assert((static_cast<RealType>(0) < NAN) == (NAN < static_cast<RealType>(0)), "NaN behavior is unexpected");
         return (static_cast<RealType>(0) < a) - (a < static_cast<RealType>(0));
     }
+    Vec<RealType> operator()(Vec<RealType> a) const {
+        return util::Simd<RealType>::fromMask(static_cast<RealType>(0) < a) - util::Simd<RealType>::fromMask(a < static_cast<RealType>(0));
+    }
 };
 
-template <typename RealType> struct FuncAbs { RealType operator()(RealType a) const { return std::abs(a); } };
-template <typename RealType> struct FuncInv { RealType operator()(RealType a) const { return RealType(1.0) / a; } };
-template <typename RealType> struct FuncSquare { RealType operator()(RealType a) const { return a * a; } };
-template <typename RealType> struct FuncSqrt { RealType operator()(RealType a) const { return std::sqrt(a); } };
+template <typename RealType> struct FuncAbs {
+    RealType operator()(RealType a) const { return std::abs(a); }
+    Vec<RealType> operator()(Vec<RealType> a) const { return (Vec<RealType>) ((typename util::Simd<RealType>::Mask) a & ~(typename util::Simd<RealType>::Mask) util::Simd<RealType>::broadcast(-0.0)); }
+};
+template <typename RealType> struct FuncInv {
+    RealType operator()(RealType a) const { return RealType(1.0) / a; }
+    Vec<RealType> operator()(Vec<RealType> a) const { return RealType(1.0) / a; }
+};
+template <typename RealType> struct FuncSquare {
+    RealType operator()(RealType a) const { return a * a; }
+    Vec<RealType> operator()(Vec<RealType> a) const { return a * a; }
+};
+template <typename RealType> struct FuncSqrt {
+    RealType operator()(RealType a) const { return std::sqrt(a); }
+    Vec<RealType> operator()(Vec<RealType> a) const { return util::Simd<RealType>::map(a, [](RealType x) { return std::sqrt(x); }); }
+};
 template <typename RealType> struct FuncCbrt { RealType operator()(RealType a) const { return std::cbrt(a); } };
-template <typename RealType> struct FuncExp { RealType operator()(RealType a) const { return std::exp(a); } };
-template <typename RealType> struct FuncLog { RealType operator()(RealType a) const { return std::log(a); } };
-template <typename RealType> struct FuncExpm1 { RealType operator()(RealType a) const { return std::expm1(a); } };
+template <typename RealType> struct FuncExp {
+    RealType operator()(RealType a) const { return std::exp(a); }
+#if ENABLE_APPROX_SIMD_MATH
+    Vec<RealType> operator()(Vec<RealType> a) const { return util::simdExp<RealType>(a); }
+#endif
+};
+template <typename RealType> struct FuncLog {
+    RealType operator()(RealType a) const { return std::log(a); }
+#if ENABLE_APPROX_SIMD_MATH
+    Vec<RealType> operator()(Vec<RealType> a) const { return util::simdLog<RealType>(a); }
+#endif
+};
+template <typename RealType> struct FuncExpm1 {
+    RealType operator()(RealType a) const { return std::expm1(a); }
+#if ENABLE_APPROX_SIMD_MATH
+    Vec<RealType> operator()(Vec<RealType> a) const { return util::simdExpm1<RealType>(a); }
+#endif
+};
 template <typename RealType> struct FuncLog1p { RealType operator()(RealType a) const { return std::log1p(a); } };
-template <typename RealType> struct FuncSigmoid { RealType operator()(RealType a) const { return RealType(1.0) / (RealType(1.0) + std::exp(-a)); } };
+template <typename RealType> struct FuncSigmoid {
+    RealType operator()(RealType a) const { return RealType(1.0) / (RealType(1.0) + std::exp(-a)); }
+#if ENABLE_APPROX_SIMD_MATH
+    Vec<RealType> operator()(Vec<RealType> a) const { return util::simdSigmoid<RealType>(a); }
+#endif
+};
 template <typename RealType> struct FuncSin { RealType operator()(RealType a) const { return std::sin(a); } };
 template <typename RealType> struct FuncCos { RealType operator()(RealType a) const { return std::cos(a); } };
 template <typename RealType> struct FuncTan { RealType operator()(RealType a) const { return std::tan(a); } };
@@ -26,7 +68,12 @@ template <typename RealType> struct FuncAcos { RealType operator()(RealType a) c
 template <typename RealType> struct FuncAtan { RealType operator()(RealType a) const { return std::atan(a); } };
 template <typename RealType> struct FuncSinh { RealType operator()(RealType a) const { return std::sinh(a); } };
 template <typename RealType> struct FuncCosh { RealType operator()(RealType a) const { return std::cosh(a); } };
-template <typename RealType> struct FuncTanh { RealType operator()(RealType a) const { return std::tanh(a); } };
+template <typename RealType> struct FuncTanh {
+    RealType operator()(RealType a) const { return std::tanh(a); }
+#if ENABLE_APPROX_SIMD_MATH
+    Vec<RealType> operator()(Vec<RealType> a) const { return util::simdTanh<RealType>(a); }
+#endif
+};
 template <typename RealType> struct FuncAsinh { RealType operator()(RealType a) const { return std::asinh(a); } };
 template <typename RealType> struct FuncAcosh { RealType operator()(RealType a) const { return std::acosh(a); } };
 template <typename RealType> struct FuncAtanh { RealType operator()(RealType a) const { return std::atanh(a); } };
@@ -34,22 +81,40 @@ template <typename RealType> struct FuncErf { RealType operator()(RealType a) co
 template <typename RealType> struct FuncErfc { RealType operator()(RealType a) const { return std::erfc(a); } };
 template <typename RealType> struct FuncLgamma { RealType operator()(RealType a) const { return std::lgamma(a); } };
 template <typename RealType> struct FuncTgamma { RealType operator()(RealType a) const { return std::tgamma(a); } };
-template <typename RealType> struct FuncFloor { RealType operator()(RealType a) const { return std::floor(a); } };
-template <typename RealType> struct FuncCeil { RealType operator()(RealType a) const { return std::ceil(a); } };
+template <typename RealType> struct FuncFloor {
+    RealType operator()(RealType a) const { return std::floor(a); }
+    Vec<RealType> operator()(Vec<RealType> a) const { return util::Simd<RealType>::map(a, [](RealType x) { return std::floor(x); }); }
+};
+template <typename RealType> struct FuncCeil {
+    RealType operator()(RealType a) const { return std::ceil(a); }
+    Vec<RealType> operator()(Vec<RealType> a) const { return util::Simd<RealType>::map(a, [](RealType x) { return std::ceil(x); }); }
+};
 template <typename RealType> struct FuncRound { RealType operator()(RealType a) const { return std::round(a); } };
-template <typename RealType> struct FuncNot { RealType operator()(RealType a) const { return !a; } };
-template <typename RealType> struct FuncIsNan { RealType operator()(RealType a) const { return std::isnan(a); } };
-template <typename RealType> struct FuncIsNum { RealType operator()(RealType a) const { return !std::isnan(a); } };
+template <typename RealType> struct FuncNot {
+    static constexpr bool isPredicate = true;
+    RealType operator()(RealType a) const { return !a; }
+    Vec<RealType> operator()(Vec<RealType> a) const { return util::Simd<RealType>::fromMask(a == static_cast<RealType>(0)); }
+};
+template <typename RealType> struct FuncIsNan {
+    static constexpr bool isPredicate = true;
+    RealType operator()(RealType a) const { return std::isnan(a); }
+    Vec<RealType> operator()(Vec<RealType> a) const { return util::Simd<RealType>::fromMask(util::Simd<RealType>::isNan(a)); }
+};
+template <typename RealType> struct FuncIsNum {
+    static constexpr bool isPredicate = true;
+    RealType operator()(RealType a) const { return !std::isnan(a); }
+    Vec<RealType> operator()(Vec<RealType> a) const { return util::Simd<RealType>::fromMask(~util::Simd<RealType>::isNan(a)); }
+};
 
 template <template <typename> typename Operator>
 void declUnaryOp(app::AppContext &context, program::Resolver &resolver, const char *funcName) {
-    resolver.decl(funcName, Operator<float>());
-    resolver.decl(funcName, Operator<double>());
+    resolver.decl(funcName, [](float a) -> float { return Operator<float>()(a); });
+    resolver.decl(funcName, [](double a) -> double { return Operator<double>()(a); });
     resolver.decl(funcName, [&context](series::DataSeries<float> *a){
-        return new series::ParallelOpSeries<float, Operator<float>, series::DataSeries<float> &>(context, Operator<float>(), *a);
+        return series::makeFusedOpSeries<Operator<float>, float>(context, Operator<float>(), *a);
     });
     resolver.decl(funcName, [&context](series::DataSeries<double> *a){
-        return new series::ParallelOpSeries<double, Operator<double>, series::DataSeries<double> &>(context, Operator<double>(), *a);
+        return series::makeFusedOpSeries<Operator<double>, double>(context, Operator<double>(), *a);
     });
 }
 
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <array>
+#include <algorithm>
+
+#include "jw_util/baseexception.h"
+
+#include "graphics/glbufferbase.h"
+
+namespace graphics {
+
+// A buffer for data that's mostly appended to, like a plot that grows as samples come in.
+// The caller keeps its own copy of the data and says which part changed with invalidate(), and sync() only uploads that part.
+// With ARB_buffer_storage, the buffer holds num_regions copies of the data that stay persistently mapped.
+// Frames rotate through them with a fence each, so we never write to a copy the GPU might still be drawing from.
+// Without it there's a single copy updated with glBufferSubData, and the driver takes care of that.
+template <typename Type, unsigned int num_regions = 3>
+class StreamBuffer : public GlBufferBase {
+public:
+    class Exception : public jw_util::BaseException {
+        friend class StreamBuffer;
+
+    private:
+        Exception(const std::string &msg)
+            : BaseException(msg)
+        {}
+    };
+
+    typedef unsigned int Index;
+
+    StreamBuffer(GLenum target)
+        : GlBufferBase(target, GL_STREAM_DRAW)
+        , is_persistent(GLEW_ARB_buffer_storage)
+    {}
+
+    ~StreamBuffer()
+    {
+        // Deleting the buffer unmaps it too
+        clear_fences();
+    }
+
+    bool needs_resize(Index size) const
+    {
+        return size > region_size;
+    }
+
+    // Unlike GlBuffer::update_size(), this drops the contents, so sync() uploads everything again
+    void update_size(Index size)
+    {
+        assert(needs_resize(size));
+
+        // Storage is immutable when it's persistent, so we need a new buffer either way
+        clear_fences();
+        glDeleteBuffers(1, &vbo_id);
+        glGenBuffers(1, &vbo_id);
+        glBindBuffer(target, vbo_id);
+
+        region_size = size * 3 / 2;
+        if (is_persistent) {
+            static constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(target, num_regions * region_size * sizeof(Type), 0, flags);
+
+            mapped = static_cast<Type *>(glMapBufferRange(target, 0, num_regions * region_size * sizeof(Type), flags));
+            if (!mapped) {
+                throw Exception("Cannot persistently map buffer of " + std::to_string(num_regions * region_size * sizeof(Type)) + " bytes: " + GL::getErrors());
+            }
+        } else {
+            glBufferData(target, region_size * sizeof(Type), 0, buffer_hint);
+        }
+        GL::catchErrors();
+
+        valid_sizes.fill(0);
+    }
+
+    // The data from index onwards changed
+    void invalidate(Index index)
+    {
+        for (Index &valid_size : valid_sizes) {
+            valid_size = std::min(valid_size, index);
+        }
+    }
+
+    // Brings the next copy up to date with data[0, size), and returns the index to draw it from, as in glDrawArrays()
+    Index sync(const Type *data, Index size)
+    {
+        assert_bound();
+        assert(size <= region_size);
+
+        if (is_persistent) {
+            region = (region + 1) % num_regions;
+        }
+
+        Index base = region * region_size;
+        Index &valid_size = valid_sizes[region];
+        if (valid_size < size) {
+            if (is_persistent) {
+                wait_fence(region);
+                std::copy(data + valid_size, data + size, mapped + base + valid_size);
+            } else {
+                glBufferSubData(target, (base + valid_size) * sizeof(Type), (size - valid_size) * sizeof(Type), data + valid_size);
+                GL::catchErrors();
+            }
+        }
+        valid_size = size;
+
+        return base;
+    }
+
+    // Call after the draws that read what sync() returned
+    void fence()
+    {
+        if (is_persistent) {
+            if (fences[region]) {
+                glDeleteSync(fences[region]);
+            }
+            fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            GL::catchErrors();
+        }
+    }
+
+private:
+    const bool is_persistent;
+
+    Index region_size = 0;
+    Index region = 0;
+    Type *mapped = 0;
+
+    // How much of each copy matches the caller's data
+    std::array<Index, num_regions> valid_sizes{};
+    std::array<GLsync, num_regions> fences{};
+
+    void wait_fence(Index index)
+    {
+        if (!fences[index]) {
+            return;
+        }
+
+        GLenum res;
+        do {
+            res = glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        } while (res == GL_TIMEOUT_EXPIRED);
+        if (res == GL_WAIT_FAILED) {
+            throw Exception("Cannot wait for buffer fence: " + GL::getErrors());
+        }
+
+        glDeleteSync(fences[index]);
+        fences[index] = 0;
+    }
+
+    void clear_fences()
+    {
+        for (GLsync &fence : fences) {
+            if (fence) {
+                glDeleteSync(fence);
+                fence = 0;
+            }
+        }
+    }
+};
+
+}
@@ -13,17 +13,23 @@
 #include "version.h"
 #include "stream/filepoller.h"
 #include "stream/jsonunwrapper.h"
+#include "stream/binaryunwrapper.h"
 #include "program/programmanager.h"
 #include "stream/inputmanager.h"
 #include "util/testrunner.h"
+#include "util/schedulerbenchmark.h"
+#include "series/convbenchmark.h"
 #include "util/wrapper.h"
 #include "jw_util/thread.h"
 #include "app/seriesdebugger.h"
+#include "series/chunkcache.h"
 
 #include "defs/CHUNK_SIZE_LOG2.h"
 #include "defs/ENABLE_CONV_MIN_COMPUTE_FLAG.h"
+#include "defs/ENABLE_SCAN_SPLIT_FLAG.h"
 #include "defs/ENABLE_PMUOI_FLAG.h"
 #include "defs/ENABLE_CHUNK_DEBUG.h"
+#include "defs/ENABLE_CHUNK_SLAB_ALLOCATOR.h"
 
 int main(int argc, char **argv) {
     jw_util::Thread::set_main_thread();
@@ -70,11 +76,43 @@ int main(int argc, char **argv) {
             .action([](const std::string& value) -> unsigned int { return std::max(0, std::min(std::stoi(value), CHUNK_SIZE_LOG2)); });
 #endif
 
+#if ENABLE_SCAN_SPLIT_FLAG
+    args.add_argument("--scan-split")
+            .help("Scan every chunk on its own and fold in the previous chunk's result after, even when that's already done")
+            .default_value(false)
+            .implicit_value(true);
+#endif
+
     args.add_argument("--gc-memory-limit")
             .help("Enable garbage collector above this value")
             .default_value(static_cast<std::size_t>(-1))
             .action([](const std::string& value) -> std::size_t { return std::stoull(value); });
 
+    args.add_argument("--spill-dir")
+            .help("Write complete chunks that are expensive to recompute here when the garbage collector frees them, instead of dropping them")
+            .default_value(std::string());
+
+    args.add_argument("--compress-evicted")
+            .help("Keep complete chunks that compress well in memory when the garbage collector frees them, using up to half of --gc-memory-limit")
+            .default_value(false)
+            .implicit_value(true);
+
+    args.add_argument("--chunk-cache-dir")
+            .help("Keep complete chunks here across runs, and read them back instead of recomputing them when the program and data file haven't changed")
+            .default_value(std::string());
+
+#if ENABLE_CHUNK_SLAB_ALLOCATOR
+    args.add_argument("--chunk-hugepages")
+            .help("Backing for the chunk slabs: none, transparent, or explicit (needs vm.nr_hugepages)")
+            .default_value(app::Options::HugePages::Transparent)
+            .action([](const std::string& value) -> app::Options::HugePages {
+        if (value == "none") { return app::Options::HugePages::None; }
+        else if (value == "transparent") { return app::Options::HugePages::Transparent; }
+        else if (value == "explicit") { return app::Options::HugePages::Explicit; }
+        else { throw std::runtime_error("Invalid value of --chunk-hugepages"); }
+    });
+#endif
+
 #if ENABLE_PMUOI_FLAG
     args.add_argument("--print-memory-usage-output-index")
             .help("Prints the memory usage required to compute and output the nth record")
@@ -88,6 +126,15 @@ int main(int argc, char **argv) {
             .default_value(std::string());
 #endif
 
+    args.add_argument("--input-format")
+            .help("Format of the data file: json (one object per line), or binary (length-prefixed column blocks, see stream/binaryunwrapper.h)")
+            .default_value(app::Options::InputFormat::Json)
+            .action([](const std::string& value) -> app::Options::InputFormat {
+        if (value == "json") { return app::Options::InputFormat::Json; }
+        else if (value == "binary") { return app::Options::InputFormat::Binary; }
+        else { throw std::runtime_error("Invalid value of --input-format"); }
+    });
+
     args.add_argument("--emit-format")
             .help("Sets the format of emitted records: none, json, floats, or doubles")
             .default_value(app::Options::EmitFormat::None)
@@ -142,11 +189,26 @@ int main(int argc, char **argv) {
             .default_value(static_cast<std::size_t>(0))
             .action([](const std::string& value) -> std::size_t { return std::stoull(value); });
 
+    args.add_argument("--propagate-latency-us")
+            .help("Batch input rows adaptively, aiming to propagate 99% of them within this many microseconds of arriving, or zero to disable")
+            .default_value(static_cast<std::size_t>(0))
+            .action([](const std::string& value) -> std::size_t { return std::stoull(value); });
+
     args.add_argument("--dont-exit")
             .help("Don't exit, even if the program pipe and data pipes end")
             .default_value(false)
             .implicit_value(true);
 
+    args.add_argument("--benchmark-scheduler")
+            .help("Run the task scheduler scaling benchmark with 1 up to this many threads, then exit")
+            .default_value(static_cast<std::size_t>(0))
+            .action([](const std::string& value) -> std::size_t { return std::stoull(value); });
+
+    args.add_argument("--benchmark-conv")
+            .help("Time the prior-chunk convolution step per inverse FFT against accumulated in the frequency domain, then exit")
+            .default_value(false)
+            .implicit_value(true);
+
     try {
         args.parse_args(argc, argv);
     }
@@ -162,17 +224,28 @@ int main(int argc, char **argv) {
     app::Options::getMutableInstance().writeWisdom = !args.get<bool>("--dont-write-wisdom");
 #if ENABLE_CONV_MIN_COMPUTE_FLAG
     app::Options::getMutableInstance().convMinComputeLog2 = args.get<unsigned int>("--conv-min-compute-log2");
+#endif
+#if ENABLE_SCAN_SPLIT_FLAG
+    app::Options::getMutableInstance().scanSplit = args.get<bool>("--scan-split");
 #endif
     app::Options::getMutableInstance().gcMemoryLimit = args.get<std::size_t>("--gc-memory-limit");
+    app::Options::getMutableInstance().spillDir = args.get<std::string>("--spill-dir");
+    app::Options::getMutableInstance().compressEvicted = args.get<bool>("--compress-evicted");
+    app::Options::getMutableInstance().chunkCacheDir = args.get<std::string>("--chunk-cache-dir");
+#if ENABLE_CHUNK_SLAB_ALLOCATOR
+    app::Options::getMutableInstance().chunkHugePages = args.get<app::Options::HugePages>("--chunk-hugepages");
+#endif
 #if ENABLE_PMUOI_FLAG
     app::Options::getMutableInstance().printMemoryUsageOutputIndex = args.get<std::size_t>("--print-memory-usage-output-index");
 #endif
 #if ENABLE_CHUNK_DEBUG
     app::Options::getMutableInstance().debugSeriesToFile = args.get<std::string>("--debug-series-to-file");
 #endif
+    app::Options::getMutableInstance().inputFormat = args.get<app::Options::InputFormat>("--input-format");
     app::Options::getMutableInstance().emitFormat = args.get<app::Options::EmitFormat>("--emit-format");
     app::Options::getMutableInstance().meterIndices = args.get<util::PrivateWrapper<std::vector<app::Options::MeterIndex>>>("--meter-indices").val;
     app::Options::getMutableInstance().maxFps = args.get<std::size_t>("--max-fps");
+    app::Options::getMutableInstance().propagateLatencyUs = args.get<std::size_t>("--propagate-latency-us");
     app::Options::getMutableInstance().dontExit = args.get<bool>("--dont-exit");
 
     // Setup logger
@@ -204,6 +277,17 @@ int main(int argc, char **argv) {
     SPDLOG_INFO("An unsigned long long is {} bits", sizeof(unsigned long long) * CHAR_BIT);
     SPDLOG_INFO("Chunk size log2 is: {}", CHUNK_SIZE_LOG2);
 
+    std::size_t benchmarkSchedulerThreads = args.get<std::size_t>("--benchmark-scheduler");
+    if (benchmarkSchedulerThreads) {
+        util::runSchedulerBenchmark(context, benchmarkSchedulerThreads);
+        return 0;
+    }
+
+    if (args.get<bool>("--benchmark-conv")) {
+        series::runConvBenchmark(context);
+        return 0;
+    }
+
 #ifndef NDEBUG
     SPDLOG_INFO("Running tests...");
     util::TestRunner::getInstance().run();
@@ -211,8 +295,20 @@ int main(int argc, char **argv) {
 
     SPDLOG_INFO("Starting...");
 
+    if (series::ChunkCache::isEnabled()) {
+        // Has to happen before the program resolves, since the input series' cache keys depend on it
+        series::ChunkCache::setInputPath(args.get<std::string>("data-path"));
+    }
+
     context.get<stream::FilePoller>().addFile<stream::JsonUnwrapper<program::ProgramManager>>(args.get<std::string>("program-path"), false);
-    context.get<stream::FilePoller>().addFile<stream::JsonUnwrapper<stream::InputManager>>(args.get<std::string>("data-path"), true);
+    switch (app::Options::getInstance().inputFormat) {
+        case app::Options::InputFormat::Json:
+            context.get<stream::FilePoller>().addFile<stream::JsonUnwrapper<stream::InputManager>>(args.get<std::string>("data-path"), true);
+            break;
+        case app::Options::InputFormat::Binary:
+            context.get<stream::FilePoller>().addFile<stream::BinaryUnwrapper<stream::InputManager>>(args.get<std::string>("data-path"), true, stream::FilePoller::Framing::LengthPrefixed);
+            break;
+    }
 
     if (!app::Options::getMutableInstance().debugSeriesToFile.empty()) {
         context.get<app::SeriesDebugger>();
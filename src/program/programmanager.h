@@ -24,6 +24,7 @@ public:
     ProgramManager(app::AppContext &context);
 
     void recvRecord(const rapidjson::Document &row);
+    bool shouldYield() const { return false; }
     void yield();
     void end();
 
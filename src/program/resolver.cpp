@@ -1,9 +1,12 @@
 #include "resolver.h"
 
+#include <algorithm>
+
 #include "log.h"
 
 #include "app/appcontext.h"
 #include "series/dataseries.h"
+#include "series/chunkcache.h"
 
 namespace program {
 
@@ -17,6 +20,36 @@ Resolver::Resolver(app::AppContext &context)
     SPDLOG_INFO("Registered {} declarations", declarations.size());
 }
 
+// Whether obj is one of the series in the array arr
+static bool isItemOf(const ProgObj &obj, const ProgObj &arr) {
+    if (std::holds_alternative<series::DataSeries<float> *>(obj) && std::holds_alternative<ProgObjArray<series::DataSeries<float> *>>(arr)) {
+        const std::vector<series::DataSeries<float> *> &items = std::get<ProgObjArray<series::DataSeries<float> *>>(arr).getArr();
+        return std::find(items.cbegin(), items.cend(), std::get<series::DataSeries<float> *>(obj)) != items.cend();
+    } else if (std::holds_alternative<series::DataSeries<double> *>(obj) && std::holds_alternative<ProgObjArray<series::DataSeries<double> *>>(arr)) {
+        const std::vector<series::DataSeries<double> *> &items = std::get<ProgObjArray<series::DataSeries<double> *>>(arr).getArr();
+        return std::find(items.cbegin(), items.cend(), std::get<series::DataSeries<double> *>(obj)) != items.cend();
+    } else {
+        return false;
+    }
+}
+
+template <typename ArgType>
+static void forEachSeries(const ProgObj &arg, ArgType func) {
+    if (std::holds_alternative<series::DataSeries<float> *>(arg)) {
+        func(std::get<series::DataSeries<float> *>(arg));
+    } else if (std::holds_alternative<series::DataSeries<double> *>(arg)) {
+        func(std::get<series::DataSeries<double> *>(arg));
+    } else if (std::holds_alternative<ProgObjArray<series::DataSeries<float> *>>(arg)) {
+        for (series::DataSeries<float> *item : std::get<ProgObjArray<series::DataSeries<float> *>>(arg).getArr()) {
+            func(item);
+        }
+    } else if (std::holds_alternative<ProgObjArray<series::DataSeries<double> *>>(arg)) {
+        for (series::DataSeries<double> *item : std::get<ProgObjArray<series::DataSeries<double> *>>(arg).getArr()) {
+            func(item);
+        }
+    }
+}
+
 ProgObj Resolver::call(const std::string &name, const std::vector<ProgObj> &args) {
     auto foundValue = calls.emplace(Call(name, args), ProgObj());
     if (foundValue.second) {
@@ -26,10 +59,145 @@ ProgObj Resolver::call(const std::string &name, const std::vector<ProgObj> &args
             calls.erase(foundValue.first);
             throw;
         }
+
+        for (const ProgObj &arg : args) {
+            // Passthroughs like meta() and at() don't read their argument
+            if (!(arg == foundValue.first->second) && !isItemOf(foundValue.first->second, arg)) {
+                addConsumer(arg);
+                addReader(arg, foundValue.first->second);
+            }
+        }
+
+        setCacheKey(name, args, foundValue.first->second);
+    } else {
+        // A program loaded later can't see old input that was already retired and freed
+        forEachSeries(foundValue.first->second, [&name](series::DataSeriesBase *series) {
+            if (std::size_t lostEnd = series->getLostEnd()) {
+                SPDLOG_WARN("{}() reads as NaN before element {}, since that data was retired and freed before this program was loaded", name, lostEnd);
+            }
+        });
     }
     return foundValue.first->second;
 }
 
+template <typename ValueType>
+static bool hashCacheKey(std::uint64_t &key, const ValueType &value) {
+    if constexpr (std::is_same<ValueType, std::monostate>::value) {
+        return true;
+    } else if constexpr (std::is_same<ValueType, std::string>::value) {
+        std::uint64_t size = value.size();
+        key = series::ChunkCache::hash(key, &size, sizeof(size));
+        key = series::ChunkCache::hash(key, value.data(), value.size());
+        return true;
+    } else if constexpr (std::is_same<ValueType, bool>::value || std::is_same<ValueType, UncastNumber>::value || std::is_arithmetic<ValueType>::value) {
+        key = series::ChunkCache::hash(key, &value, sizeof(value));
+        return true;
+    } else if constexpr (std::is_same<ValueType, series::DataSeries<float> *>::value || std::is_same<ValueType, series::DataSeries<double> *>::value) {
+        std::uint64_t seriesKey = value->getCacheKey();
+        key = series::ChunkCache::hash(key, &seriesKey, sizeof(seriesKey));
+        return seriesKey != 0;
+    } else {
+        // Renderers, emitters, metrics and variables don't have a value that's stable across runs
+        return false;
+    }
+}
+
+template <typename ItemType>
+static bool hashCacheKey(std::uint64_t &key, const ProgObjArray<ItemType> &value) {
+    std::uint64_t size = value.getArr().size();
+    key = series::ChunkCache::hash(key, &size, sizeof(size));
+    for (const ItemType &item : value.getArr()) {
+        if (!hashCacheKey(key, item)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Resolver::setCacheKey(const std::string &name, const std::vector<ProgObj> &args, const ProgObj &result) {
+    series::DataSeriesBase *resultSeries;
+    if (std::holds_alternative<series::DataSeries<float> *>(result)) {
+        resultSeries = std::get<series::DataSeries<float> *>(result);
+    } else if (std::holds_alternative<series::DataSeries<double> *>(result)) {
+        resultSeries = std::get<series::DataSeries<double> *>(result);
+    } else {
+        return;
+    }
+
+    if (resultSeries->getCacheKey()) {
+        // Passthroughs return a series that already has its key
+        return;
+    }
+
+    std::uint64_t key = series::ChunkCache::getBaseKey();
+    if (!hashCacheKey(key, name)) {
+        return;
+    }
+
+    std::size_t resultType = result.index();
+    key = series::ChunkCache::hash(key, &resultType, sizeof(resultType));
+
+    for (const ProgObj &arg : args) {
+        std::size_t argType = arg.index();
+        key = series::ChunkCache::hash(key, &argType, sizeof(argType));
+
+        if (!std::visit([&key](const auto &value) {return hashCacheKey(key, value);}, arg)) {
+            return;
+        }
+    }
+
+    if (name == "input") {
+        std::uint64_t inputIdentity = series::ChunkCache::getInputIdentity();
+        if (!inputIdentity) {
+            return;
+        }
+        key = series::ChunkCache::hash(key, &inputIdentity, sizeof(inputIdentity));
+    }
+
+    resultSeries->setCacheKey(key ? key : 1);
+}
+
+void Resolver::addConsumer(const ProgObj &arg) {
+    if (std::holds_alternative<series::DataSeries<float> *>(arg)) {
+        std::get<series::DataSeries<float> *>(arg)->addConsumer();
+    } else if (std::holds_alternative<series::DataSeries<double> *>(arg)) {
+        std::get<series::DataSeries<double> *>(arg)->addConsumer();
+    } else if (std::holds_alternative<ProgObjArray<series::DataSeries<float> *>>(arg)) {
+        for (series::DataSeries<float> *item : std::get<ProgObjArray<series::DataSeries<float> *>>(arg).getArr()) {
+            item->addConsumer();
+        }
+    } else if (std::holds_alternative<ProgObjArray<series::DataSeries<double> *>>(arg)) {
+        for (series::DataSeries<double> *item : std::get<ProgObjArray<series::DataSeries<double> *>>(arg).getArr()) {
+            item->addConsumer();
+        }
+    }
+}
+
+void Resolver::addReader(const ProgObj &arg, const ProgObj &result) {
+    if (std::holds_alternative<series::DataSeries<float> *>(result) || std::holds_alternative<series::DataSeries<double> *>(result)) {
+        series::DataSeriesBase *reader = std::holds_alternative<series::DataSeries<float> *>(result)
+            ? static_cast<series::DataSeriesBase *>(std::get<series::DataSeries<float> *>(result))
+            : static_cast<series::DataSeriesBase *>(std::get<series::DataSeries<double> *>(result));
+        forEachSeries(arg, [reader](series::DataSeriesBase *series) {series->addReader(reader);});
+    } else if (std::holds_alternative<ProgObjArray<series::DataSeries<float> *>>(result) || std::holds_alternative<ProgObjArray<series::DataSeries<double> *>>(result)) {
+        if (isItemOf(arg, result)) {
+            // arr() just collects its arguments. Whatever reads the array reads its items, and is recorded then.
+            return;
+        }
+
+        // Each item is a channel computed from the arguments, like with MultiChannelSeries
+        forEachSeries(result, [&arg](series::DataSeriesBase *reader) {
+            forEachSeries(arg, [reader](series::DataSeriesBase *series) {series->addReader(reader);});
+        });
+    } else if (std::holds_alternative<stream::SeriesEmitter *>(result) || std::holds_alternative<stream::SeriesMetric *>(result)) {
+        // These only ever read the newest elements
+        forEachSeries(arg, [](series::DataSeriesBase *series) {series->addSink(0);});
+    } else {
+        // Renderers can be scrolled anywhere
+        forEachSeries(arg, [](series::DataSeriesBase *series) {series->addSink(series::DataSeriesBase::unboundedLookback);});
+    }
+}
+
 template <typename ItemType>
 static ProgObjArray<ItemType> extractArray(const std::vector<ProgObj> &args) {
     std::vector<ItemType> vec;
@@ -151,6 +151,15 @@ private:
     static std::vector<std::function<void (app::AppContext &, Resolver &)> > &getBuilders();
 
     ProgObj execDecl(const std::string &name, const std::vector<ProgObj> &args);
+
+    // Counts how many calls read each series, which is what decides whether elementwise ops get fused
+    static void addConsumer(const ProgObj &arg);
+
+    // Records how far back the result reads the arg, see series::DataSeriesBase::getHorizon()
+    static void addReader(const ProgObj &arg, const ProgObj &result);
+
+    // Identifies the series a call returns across runs, so its chunks can be found in the chunk cache
+    static void setCacheKey(const std::string &name, const std::vector<ProgObj> &args, const ProgObj &result);
 };
 
 }
@@ -19,17 +19,49 @@ void DataSeriesRenderer<ElementType>::draw(std::size_t begin, std::size_t end, s
         return;
     }
 
-    static thread_local std::vector<ElementType> sample;
-    sample.clear();
-
-    std::size_t camLimitX;
-    for (std::size_t i = begin; i < end; i += stride) {
-        series::ChunkPtr<ElementType> chunk = data->getChunk(i / CHUNK_SIZE);
-        if (i % CHUNK_SIZE < chunk->getComputedCount()) {
-            sample.push_back(chunk->getElement(i % CHUNK_SIZE) * scale + offset);
-            camLimitX = i;
-        } else {
-            sample.push_back(NAN);
+    // Each x gets the min, max and mean of its whole stride rather than a sample, so zooming out never drops a spike.
+    // Buckets stay from frame to frame while the view and transform do, and the leading ones whose data was all complete can't change anymore.
+    // So while streaming, only the last few get summarized and uploaded again.
+    if (begin != windowBegin || stride != windowStride || offset != windowOffset || scale != windowScale) {
+        windowBegin = begin;
+        windowStride = stride;
+        windowOffset = offset;
+        windowScale = scale;
+        numSettled = 0;
+    }
+
+    std::size_t count = (end - begin + stride - 1) / stride;
+    numSettled = std::min(numSettled, count);
+    buckets.resize(count);
+    lineValues.resize(count);
+    bandValues.resize(count * 2);
+
+    std::size_t dirtyBegin = numSettled;
+    for (std::size_t j = dirtyBegin; j < count; j++) {
+        std::size_t i = begin + j * stride;
+
+        Summary &bucket = buckets[j];
+        bool isComplete;
+        bucket = summarize(i, std::min(i + stride, end), stride, isComplete);
+
+        // A bucket cut short by the end of the view gets more once the view grows
+        if (numSettled == j && isComplete && i + stride <= end) {
+            numSettled++;
+        }
+
+        lineValues[j] = bucket.getMean() * scale + offset;
+        bandValues[j * 2] = bucket.count ? bucket.min * scale + offset : NAN;
+        bandValues[j * 2 + 1] = bucket.count ? bucket.max * scale + offset : NAN;
+    }
+
+    lineBuffer.invalidate(dirtyBegin);
+    bandBuffer.invalidate(dirtyBegin * 2);
+
+    std::size_t camLimitX = begin;
+    for (std::size_t j = count; j-- > 0;) {
+        if (buckets[j].covered) {
+            camLimitX = begin + j * stride + buckets[j].covered - 1;
+            break;
         }
     }
 
@@ -46,10 +78,12 @@ void DataSeriesRenderer<ElementType>::draw(std::size_t begin, std::size_t end, s
         ElementType min = std::numeric_limits<float>::infinity();
         ElementType max = -std::numeric_limits<float>::infinity();
 
-        for (ElementType val : sample) {
-            if (!std::isnan(val)) {
-                if (val < min) { min = val; }
-                if (val > max) { max = val; }
+        for (const Summary &bucket : buckets) {
+            if (bucket.count) {
+                ElementType low = bucket.min * scale + offset;
+                ElementType high = bucket.max * scale + offset;
+                if (low < min) { min = low; }
+                if (high > max) { max = high; }
             }
         }
 
@@ -71,24 +105,54 @@ void DataSeriesRenderer<ElementType>::draw(std::size_t begin, std::size_t end, s
         }
     }
 
-    vao.bind();
+    if (stride > 1) {
+        BandProgram<ElementType> &bandProgram = context.get<BandProgram<ElementType>>();
+
+        bandVao.bind();
+
+        bandBuffer.bind();
+        if (bandBuffer.needs_resize(count * 2)) {
+            bandBuffer.update_size(count * 2);
+
+            bandVao.assertBound();
+            bandBuffer.bind();
+
+            bandProgram.make();
+        }
+        std::size_t first = bandBuffer.sync(bandValues.data(), count * 2);
+
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        graphics::GL::catchErrors();
+
+        glm::vec4 bandColor(drawStyle.color[0], drawStyle.color[1], drawStyle.color[2], bandAlpha);
+        bandProgram.draw(begin, stride, first, count * 2, bandColor);
+
+        glDisable(GL_BLEND);
+
+        bandBuffer.fence();
+        bandVao.unbind();
+    }
+
+    LineStripProgram<ElementType> &lineProgram = context.get<LineStripProgram<ElementType>>();
 
-    LineStripProgram<ElementType> &program = context.get<LineStripProgram<ElementType>>();
+    lineVao.bind();
 
-    remoteBuffer.bind();
-    if (remoteBuffer.needs_resize(sample.size())) {
-        remoteBuffer.update_size(sample.size());
+    lineBuffer.bind();
+    if (lineBuffer.needs_resize(count)) {
+        lineBuffer.update_size(count);
 
-        vao.assertBound();
-        remoteBuffer.bind();
+        lineVao.assertBound();
+        lineBuffer.bind();
 
-        program.make();
+        lineProgram.make();
     }
-    remoteBuffer.write(0, sample.size(), sample.data());
+    std::size_t first = lineBuffer.sync(lineValues.data(), count);
 
-    program.draw(begin, stride, 0, sample.size(), drawStyle);
+    lineProgram.draw(begin, stride, first, count, drawStyle);
 
-    vao.unbind();
+    lineBuffer.fence();
+    lineVao.unbind();
 #else
     (void) begin;
     (void) end;
@@ -111,6 +175,54 @@ void DataSeriesRenderer<ElementType>::updateTransform(float offset, float scale)
 }
 
 #if ENABLE_GRAPHICS
+template <typename ElementType>
+typename DataSeriesRenderer<ElementType>::Summary DataSeriesRenderer<ElementType>::summarize(std::size_t begin, std::size_t end, std::size_t stride, bool &isComplete) {
+    typedef series::SummaryPyramid<ElementType> Pyramid;
+
+    // Once a stride spans whole leaves, the pyramid has the answer without touching any chunks, provided they've all completed.
+    // Leaves go to the x they start in, so the strides split the pyramid's range without overlapping.
+    bool useLeaves = stride >= Pyramid::leafSize;
+    if (useLeaves) {
+        std::size_t beginLeaf = begin >> Pyramid::leafSizeLog2;
+        std::size_t endLeaf = end >> Pyramid::leafSizeLog2;
+        Summary res = summaries.summarize(beginLeaf, endLeaf);
+        if (res.covered == (endLeaf - beginLeaf) << Pyramid::leafSizeLog2) {
+            isComplete = true;
+            return res;
+        }
+    }
+
+    // Otherwise go chunk by chunk, getting whichever chunks the pyramid is missing.
+    // That also computes them in the first place, and any that completed before the pyramid existed get added to it here.
+    Summary res;
+    isComplete = true;
+    for (std::size_t chunkIndex = begin / CHUNK_SIZE; chunkIndex * CHUNK_SIZE < end; chunkIndex++) {
+        std::size_t chunkBegin = chunkIndex * CHUNK_SIZE;
+        std::size_t lo = std::max(begin, chunkBegin);
+        std::size_t hi = std::min(end, chunkBegin + CHUNK_SIZE);
+
+        if (useLeaves && summaries.hasChunk(chunkIndex)) {
+            res.merge(summaries.summarize(lo >> Pyramid::leafSizeLog2, hi >> Pyramid::leafSizeLog2));
+            continue;
+        }
+
+        series::ChunkPtr<ElementType> chunk = data->getChunk(chunkIndex);
+        unsigned int computedCount = chunk->getComputedCount();
+        if (computedCount == CHUNK_SIZE) {
+            summaries.addChunk(chunkIndex, chunk->getData());
+        }
+
+        std::size_t computedEnd = std::min(hi, chunkBegin + computedCount);
+        if (computedEnd < hi) {
+            isComplete = false;
+        }
+        for (std::size_t i = lo; i < computedEnd; i++) {
+            res.add(chunk->getElement(i - chunkBegin));
+        }
+    }
+    return res;
+}
+
 template <typename ElementType>
 typename DataSeriesRenderer<ElementType>::Actions DataSeriesRenderer<ElementType>::updateDrawStyle() {
     Actions actions;
@@ -5,9 +5,10 @@
 
 #include "defs/ENABLE_GRAPHICS.h"
 #if ENABLE_GRAPHICS
-#include "graphics/glbuffer.h"
+#include "graphics/streambuffer.h"
 #include "graphics/type/element.h"
 #include "render/program/linestripprogram.h"
+#include "render/program/bandprogram.h"
 #endif
 
 namespace render {
@@ -26,9 +27,11 @@ public:
         : SeriesRenderer(context, name)
         , data(data)
 #if ENABLE_GRAPHICS
+        , summaries(data->getSummaries())
         , enabled(enabled)
         , originalOffset(offset)
-        , remoteBuffer(GL_ARRAY_BUFFER, GL_STREAM_DRAW)
+        , lineBuffer(GL_ARRAY_BUFFER)
+        , bandBuffer(GL_ARRAY_BUFFER)
         , drawStyle(r, g, b, a, true)
 #endif
     {
@@ -56,6 +59,13 @@ private:
     series::DataSeries<ElementType> *data;
 
 #if ENABLE_GRAPHICS
+    typedef typename series::SummaryPyramid<ElementType>::Summary Summary;
+
+    series::SummaryPyramid<ElementType> &summaries;
+
+    // Opacity of the min/max envelope behind the line
+    static constexpr float bandAlpha = 0.3f;
+
     bool enabled;
 
     std::string tag;
@@ -66,8 +76,20 @@ private:
 
     std::size_t lastCamLimitX = 0;
 
-    graphics::GlVao vao;
-    graphics::GlBuffer<ElementType> remoteBuffer;
+    // The buckets drawn last frame, kept while the view and transform stay the same, see draw()
+    std::size_t windowBegin = 0;
+    std::size_t windowStride = 0;
+    float windowOffset = 0.0f;
+    float windowScale = 0.0f;
+    std::size_t numSettled = 0;
+    std::vector<Summary> buckets;
+    std::vector<ElementType> lineValues;
+    std::vector<ElementType> bandValues;
+
+    graphics::GlVao lineVao;
+    graphics::StreamBuffer<ElementType> lineBuffer;
+    graphics::GlVao bandVao;
+    graphics::StreamBuffer<ElementType> bandBuffer;
 
     typename LineStripProgram<ElementType>::DrawStyle drawStyle;
 
@@ -77,6 +99,8 @@ private:
     };
     Actions updateDrawStyle();
 
+    Summary summarize(std::size_t begin, std::size_t end, std::size_t stride, bool &isComplete);
+
     bool &isSelected() const;
 #endif
 };
@@ -0,0 +1,91 @@
+#include "defs/ENABLE_GRAPHICS.h"
+#if ENABLE_GRAPHICS
+
+#include "bandprogram.h"
+
+#include "log.h"
+
+#include "graphics/type/element.h"
+#include "render/shaders.h"
+#include "render/camera.h"
+
+namespace render {
+
+template <typename ElementType>
+BandProgram<ElementType>::BandProgram(app::AppContext &context)
+    : Program(context)
+{}
+
+template <typename ElementType>
+void BandProgram<ElementType>::insertDefines() {
+    Program::insertDefines();
+
+    insertElementTypeDef();
+    graphics::Element<ElementType>::insertDefines(defines);
+}
+
+template <>
+void BandProgram<float>::insertElementTypeDef() {
+    defines.set("ELEMENT_TYPE", std::string("float"));
+}
+template <>
+void BandProgram<double>::insertElementTypeDef() {
+    defines.set("ELEMENT_TYPE", std::string("double"));
+}
+
+template <typename ElementType>
+void BandProgram<ElementType>::setupProgram() {
+    Program::setupProgram();
+
+    SPDLOG_DEBUG("Compiling band vertex shader");
+    std::string vertShaderStr = std::string(Shaders::bandVert);
+    attachShader(GL_VERTEX_SHADER, std::move(vertShaderStr), defines);
+
+    SPDLOG_DEBUG("Compiling main fragment shader");
+    std::string fragShaderStr = std::string(Shaders::mainFrag);
+    attachShader(GL_FRAGMENT_SHADER, std::move(fragShaderStr), defines);
+}
+
+template <typename ElementType>
+void BandProgram<ElementType>::linkProgram() {
+    Program::linkProgram();
+
+    offsetLocation = glGetUniformLocation(getProgramId(), "offset");
+    graphics::GL::catchErrors();
+
+    scaleLocation = glGetUniformLocation(getProgramId(), "scale");
+    graphics::GL::catchErrors();
+
+    firstVertexLocation = glGetUniformLocation(getProgramId(), "firstVertex");
+    graphics::GL::catchErrors();
+
+    colorLocation = glGetUniformLocation(getProgramId(), "color");
+    graphics::GL::catchErrors();
+}
+
+template <typename ElementType>
+void BandProgram<ElementType>::draw(std::size_t begin, std::size_t stride, std::size_t offsetIndex, std::size_t count, glm::vec4 color) {
+    Program::bind();
+
+    glm::vec2 offset = context.get<render::Camera>().getOffset();
+    glm::vec2 scale = context.get<render::Camera>().getScale();
+
+    offset.x += scale.x * static_cast<float>(begin);
+    scale.x *= static_cast<float>(stride);
+
+    glUniform2f(offsetLocation, offset.x, offset.y);
+    glUniform2f(scaleLocation, scale.x, scale.y);
+    glUniform1i(firstVertexLocation, offsetIndex);
+    glUniform4f(colorLocation, color.r, color.g, color.b, color.a);
+    graphics::GL::catchErrors();
+
+    glDrawArrays(GL_TRIANGLE_STRIP, offsetIndex, count);
+    graphics::GL::catchErrors();
+}
+
+template class BandProgram<float>;
+template class BandProgram<double>;
+
+}
+
+#endif
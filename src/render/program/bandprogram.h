@@ -0,0 +1,34 @@
+#pragma once
+
+#include "graphics/glm.h"
+#include "glm/vec4.hpp"
+
+#include "app/appcontext.h"
+#include "graphics/glvao.h"
+#include "render/program/program.h"
+
+namespace render {
+
+// Fills between pairs of (low, high) values laid out like LineStripProgram's, e.g. the min/max envelope of a series
+template <typename ElementType>
+class BandProgram : public Program {
+public:
+    BandProgram(app::AppContext &context);
+
+    virtual void insertDefines();
+    virtual void setupProgram();
+    virtual void linkProgram();
+
+    // count is the number of values, twice the number of x positions
+    void draw(std::size_t begin, std::size_t stride, std::size_t offsetIndex, std::size_t count, glm::vec4 color);
+
+private:
+    GLint offsetLocation;
+    GLint scaleLocation;
+    GLint firstVertexLocation;
+    GLint colorLocation;
+
+    void insertElementTypeDef();
+};
+
+}
@@ -62,6 +62,9 @@ void LineStripProgram<ElementType>::linkProgram() {
     scaleLocation = glGetUniformLocation(getProgramId(), "scale");
     graphics::GL::catchErrors();
 
+    firstVertexLocation = glGetUniformLocation(getProgramId(), "firstVertex");
+    graphics::GL::catchErrors();
+
     colorLocation = glGetUniformLocation(getProgramId(), "color");
     graphics::GL::catchErrors();
 }
@@ -78,6 +81,7 @@ void LineStripProgram<ElementType>::draw(std::size_t begin, std::size_t stride,
 
     glUniform2f(offsetLocation, offset.x, offset.y);
     glUniform2f(scaleLocation, scale.x, scale.y);
+    glUniform1i(firstVertexLocation, offsetIndex);
     glUniform4f(colorLocation, style.color[0], style.color[1], style.color[2], style.color[3]);
     graphics::GL::catchErrors();
 
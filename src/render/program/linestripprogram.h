@@ -30,6 +30,7 @@ public:
 private:
     GLint offsetLocation;
     GLint scaleLocation;
+    GLint firstVertexLocation;
     GLint colorLocation;
 
     void insertElementTypeDef();
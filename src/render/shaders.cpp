@@ -13,6 +13,10 @@ const char Shaders::mainFrag[] = {
     #include "shaders/main.frag.glsl.h"
 };
 
+const char Shaders::bandVert[] = {
+    #include "shaders/band.vert.glsl.h"
+};
+
 const char Shaders::fillVert[] = {
     #include "shaders/fill.vert.glsl.h"
 };
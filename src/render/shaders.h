@@ -7,6 +7,8 @@ public:
     static const char mainVert[];
     static const char mainFrag[];
 
+    static const char bandVert[];
+
     static const char fillVert[];
     static const char fillFrag[];
 };
@@ -3,10 +3,6 @@
 #include "defs/ENABLE_CHUNK_MULTITHREADING.h"
 #include "defs/ENABLE_NOTIFICATION_TRACING.h"
 
-#if ENABLE_CHUNK_MULTITHREADING
-#include <mutex>
-#endif
-
 #if ENABLE_NOTIFICATION_TRACING
 #include "log.h"
 #ifdef NDEBUG
@@ -27,8 +23,8 @@ class Chunk : public ChunkBase {
 public:
     static constexpr std::size_t size = _size;
 
-    Chunk(DataSeriesBase *ds)
-        : ChunkBase(ds)
+    Chunk(DataSeriesBase *ds, std::size_t index)
+        : ChunkBase(ds, index)
     {}
 
     unsigned int getComputedCount() const {
@@ -40,15 +36,13 @@ public:
 
 #if ENABLE_CHUNK_MULTITHREADING
         unsigned int prevNotifies = notifies;
-        auto t1 = std::chrono::high_resolution_clock::now();
 #endif
+        auto t1 = std::chrono::high_resolution_clock::now();
         unsigned int prevCount = computedCount;
         unsigned int count = compute(data, prevCount);
         assert(count >= prevCount);
         assert(count <= size);
-#if ENABLE_CHUNK_MULTITHREADING
         auto t2 = std::chrono::high_resolution_clock::now();
-#endif
 
         // Set this first so the dependents we notify know what we've computed.
         computedCount = count;
@@ -57,69 +51,44 @@ public:
         SPDLOG_TRACE(getIndentation(0) + "count: {} -> {}", prevCount, count);
 #endif
 
-        if (
 #if ENABLE_CHUNK_MULTITHREADING
-                notifies.exchange(0) == prevNotifies || count == size
-#else
-                true
+        // If notifies came in while we were computing, we need to run again.
+        // Otherwise notifies is now zero, and the next notify() will relaunch exec().
+        bool relaunch = notifies.exchange(0) != prevNotifies && count != size;
 #endif
-        ) {
-            // No notifies came in while we were computing.
-            // Notifies is zero. The next notify() will relaunch exec().
 
-            if (count != prevCount) {
-                if (count == size) {
-                    // Destroy any smart_ptrs that the lambda had captured.
-                    // This allows dependency chunks to be destroyed.
+        if (count != prevCount) {
+            if (count == size) {
+                // Destroy any smart_ptrs that the lambda had captured.
+                // This allows dependency chunks to be destroyed.
 
-                    releaseComputer();
-                }
+                releaseComputer();
+
+                ds->summarizeChunk(this);
+            }
 
 #if ENABLE_NOTIFICATION_TRACING
-                SPDLOG_TRACE(getIndentation(2) + "notifying dependents: {{");
+            SPDLOG_TRACE(getIndentation(2) + "notifying dependents: {{");
 #endif
 
-#if ENABLE_CHUNK_MULTITHREADING
-                static thread_local std::vector<ChunkPtrBase> processingDeps;
-                std::size_t prevSize = processingDeps.size();
-
-                {
-                    std::lock_guard<util::SpinLock> lock(mutex);
-                    for (ChunkPtrBase &dep : dependents) {
-                        processingDeps.emplace_back(std::move(dep));
-                    }
-                }
-
-                for (const ChunkPtrBase &dep : processingDeps) {
-                    dep->notify();
-                }
-
-                {
-                    std::lock_guard<util::SpinLock> lock(mutex);
-                    for (std::size_t i = processingDeps.size() - prevSize; i-- > 0;) {
-                        dependents[i] = std::move(processingDeps.back());
-                        processingDeps.pop_back();
-                    }
-                }
-#else
-                for (ChunkBase *dep : dependents) {
-                    dep->notify();
-                }
-#endif
+            // Dependents added concurrently by the main thread either get notified here or see our new computedCount
+            forEachDependent([](ChunkBase *dep) {
+                dep->notify();
+            });
 
 #if ENABLE_NOTIFICATION_TRACING
-                SPDLOG_TRACE(getIndentation(-2) + "}} // notifying dependents");
+            SPDLOG_TRACE(getIndentation(-2) + "}} // notifying dependents");
 #endif
-            }
-        } else {
-            // One or more notifies came in while we were computing.
+        }
+
+#if ENABLE_CHUNK_MULTITHREADING
+        if (relaunch) {
             // Either this call will re-launch exec(), or something came already and exec() is already running.
             notify();
         }
+#endif
 
-#if ENABLE_CHUNK_MULTITHREADING
         ds->recordDuration(std::chrono::duration(t2 - t1) / std::max(1u, count - prevCount));
-#endif
     }
 
     bool isDone() const override {
@@ -127,6 +96,10 @@ public:
         return computedCount == size;
     }
 
+    float getGcCost() const override {
+        return ds->getAvgRunDuration().count() / sizeof(ElementType);
+    }
+
     const ElementType *getData() const {
         return data;
     }
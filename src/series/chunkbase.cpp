@@ -1,55 +1,250 @@
 #include "chunkbase.h"
 
+#include <algorithm>
+
+#include "defs/ENABLE_CHUNK_MULTITHREADING.h"
+
+#if ENABLE_CHUNK_MULTITHREADING
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <utility>
+#endif
+
 #include "app/appcontext.h"
 #include "series/dataseriesbase.h"
 #include "util/taskscheduler.h"
 #include "series/garbagecollector.h"
+#include "util/slaballocator.h"
 
-#include "defs/ENABLE_CHUNK_MULTITHREADING.h"
+#include "defs/ENABLE_CHUNK_SLAB_ALLOCATOR.h"
 #include "defs/ENABLE_NOTIFICATION_TRACING.h"
 
 #if ENABLE_NOTIFICATION_TRACING
 #include "log.h"
 #endif
 
+#if ENABLE_CHUNK_MULTITHREADING
+namespace {
+
+struct RetiredAllocation {
+    void *ptr;
+    std::size_t size;
+    void (*free)(void *ptr, std::size_t size);
+};
+
+// Retired since the GC last ran, and older batches tagged with the epoch they were retired in.
+// Only the main thread frees things, so these need no lock.
+std::vector<RetiredAllocation> pendingAllocations;
+std::deque<std::pair<std::uint64_t, std::vector<RetiredAllocation>>> retiredAllocations;
+
+}
+#endif
+
 namespace series {
 
-ChunkBase::ChunkBase(DataSeriesBase *ds)
+thread_local unsigned int ChunkBase::wavefrontDepth = 0;
+thread_local std::vector<std::vector<ChunkBase *>> ChunkBase::wavefrontLevels;
+
+ChunkBase::Wavefront::Wavefront() {
+    wavefrontDepth++;
+}
+
+ChunkBase::Wavefront::~Wavefront() {
+    assert(wavefrontDepth > 0);
+    if (wavefrontDepth > 1) {
+        wavefrontDepth--;
+        return;
+    }
+
+    // Still open while draining, so whatever these notify gets queued too.
+    // A chunk only ever queues chunks at deeper levels (or itself, to relaunch), so one pass in order is enough.
+    for (std::size_t level = 0; level < wavefrontLevels.size(); level++) {
+        // exec() might grow either vector, so index instead of iterating
+        for (std::size_t i = 0; i < wavefrontLevels[level].size(); i++) {
+            ChunkBase *chunk = wavefrontLevels[level][i];
+#if ENABLE_CHUNK_MULTITHREADING
+            chunk->exec();
+#else
+            chunk->isQueued = false;
+            if (!chunk->isDone()) {
+                chunk->exec();
+            }
+#endif
+            chunk->decRefs();
+        }
+        wavefrontLevels[level].clear();
+    }
+
+    wavefrontDepth--;
+}
+
+ChunkBase::ChunkBase(DataSeriesBase *ds, std::size_t index)
     : ds(ds)
-    , followingDuration(NAN)
+    , index(index)
+    , followingDuration(std::chrono::duration<float>(NAN))
 {
-    jw_util::Thread::assert_main_thread();
+    DataSeriesBase::GraphLock::assertHeld();
 }
 
 ChunkBase::~ChunkBase() {
+    DataSeriesBase::GraphLock::assertHeld();
+
 #if ENABLE_CHUNK_MULTITHREADING
-#ifndef NDEBUG
-    // Gotta stop threads before destructing stuff
-    assert(notifies == 0);
-#endif
+    // Workers might still notify this until its memory is freed, but they'll see it's claimed
+    assert(refs == freeingRefs);
 #endif
 
+    for (ChunkBase *dependency : dependencies) {
+        dependency->removeDependent(this);
+    }
+    forEachDependent([this](ChunkBase *dep) {
+        dep->removeDependency(this);
+    });
+
     ds->releaseChunk(this);
     ds->getContext().get<GarbageCollector<ChunkBase>>().dequeue(this);
+
+#if ENABLE_CHUNK_MULTITHREADING
+    // Left linked from the head, for workers that are still walking this list
+    for (DependentNode *node = dependents.load(); node; node = node->next.load()) {
+        retireNode(node);
+    }
+#endif
 }
 
-void ChunkBase::addDependent(ChunkBase *dep) {
-    jw_util::Thread::assert_main_thread();
-    assert(dep != this);
+#if ENABLE_CHUNK_SLAB_ALLOCATOR || ENABLE_CHUNK_MULTITHREADING
+namespace {
+
+void freeChunkAllocation(void *ptr, std::size_t size) {
+#if ENABLE_CHUNK_SLAB_ALLOCATOR
+    util::SlabAllocator::getInstance().free(ptr, size);
+#else
+    (void) size;
+    ::operator delete(ptr);
+#endif
+}
+
+}
+
+void *ChunkBase::operator new(std::size_t size) {
+#if ENABLE_CHUNK_SLAB_ALLOCATOR
+    return util::SlabAllocator::getInstance().alloc(size);
+#else
+    return ::operator new(size);
+#endif
+}
 
+void ChunkBase::operator delete(void *ptr, std::size_t size) {
 #if ENABLE_CHUNK_MULTITHREADING
-    std::lock_guard<util::SpinLock> lock(mutex);
+    retireAllocation(ptr, size, &freeChunkAllocation);
+#else
+    freeChunkAllocation(ptr, size);
 #endif
-    dependents.push_back(dep);
 }
+#endif
 
-void ChunkBase::removeDependent(const ChunkBase *dep) {
+#if ENABLE_CHUNK_MULTITHREADING
+void ChunkBase::retireAllocation(void *ptr, std::size_t size, void (*free)(void *ptr, std::size_t size)) {
     jw_util::Thread::assert_main_thread();
 
+    pendingAllocations.push_back(RetiredAllocation{ptr, size, free});
+}
+
+void ChunkBase::retireNode(DependentNode *node) {
+    retireAllocation(node, sizeof(DependentNode), [](void *ptr, std::size_t size) {
+        (void) size;
+        delete static_cast<DependentNode *>(ptr);
+    });
+}
+
+std::size_t ChunkBase::sealRetiredAllocations(util::TaskScheduler<ChunkBase> &scheduler) {
+    jw_util::Thread::assert_main_thread();
+
+    // Everything pending was unlinked before this, so a worker that pins a later epoch can't reach it
+    if (!pendingAllocations.empty()) {
+        retiredAllocations.emplace_back(scheduler.retireEpoch(), std::move(pendingAllocations));
+        pendingAllocations.clear();
+    }
+
+    std::size_t numPassed = 0;
+    while (numPassed < retiredAllocations.size() && scheduler.hasPassed(retiredAllocations[numPassed].first)) {
+        numPassed++;
+    }
+    return numPassed;
+}
+
+void ChunkBase::freeRetiredAllocations(std::size_t numBatches) {
+    jw_util::Thread::assert_main_thread();
+
+    assert(numBatches <= retiredAllocations.size());
+    for (std::size_t i = 0; i < numBatches; i++) {
+        for (const RetiredAllocation &allocation : retiredAllocations.front().second) {
+            allocation.free(allocation.ptr, allocation.size);
+        }
+        retiredAllocations.pop_front();
+    }
+}
+#endif
+
+std::size_t ChunkBase::getAllocationSize(std::size_t size) {
+#if ENABLE_CHUNK_SLAB_ALLOCATOR
+    return util::SlabAllocator::getClassSize(size);
+#else
+    return size;
+#endif
+}
+
+std::size_t ChunkBase::getUnusedAllocationSize() {
+#if ENABLE_CHUNK_SLAB_ALLOCATOR
+    return util::SlabAllocator::getInstance().getFreeSize();
+#else
+    return 0;
+#endif
+}
+
+std::size_t ChunkBase::trimUnusedAllocations(std::size_t size) {
+#if ENABLE_CHUNK_SLAB_ALLOCATOR
+    return util::SlabAllocator::getInstance().trim(size);
+#else
+    (void) size;
+    return 0;
+#endif
+}
+
+void ChunkBase::addDependent(ChunkBase *dep) {
+    DataSeriesBase::GraphLock::assertHeld();
+    assert(dep != this);
+
 #if ENABLE_CHUNK_MULTITHREADING
-    std::lock_guard<util::SpinLock> lock(mutex);
+    // The node is complete before it's published, so a worker walking the list sees all of it or none of it
+    dependents.store(new DependentNode{dep, dependents.load()});
+#else
+    dependents.push_back(dep);
 #endif
+    dep->dependencies.push_back(this);
+    dep->level = std::max(dep->level, level + 1);
+}
+
+void ChunkBase::removeDependent(const ChunkBase *dep) {
+    DataSeriesBase::GraphLock::assertHeld();
 
+#if ENABLE_CHUNK_MULTITHREADING
+    DependentNode *prev = nullptr;
+    for (DependentNode *node = dependents.load(); node; node = node->next.load()) {
+        if (node->dep == dep) {
+            // Still points onwards, for workers standing on it
+            if (prev) {
+                prev->next.store(node->next.load());
+            } else {
+                dependents.store(node->next.load());
+            }
+            retireNode(node);
+            return;
+        }
+        prev = node;
+    }
+#else
     for (std::vector<ChunkBase *>::iterator i = dependents.begin(); i != dependents.end(); i++) {
         if (*i == dep) {
             *i = dependents.back();
@@ -57,8 +252,24 @@ void ChunkBase::removeDependent(const ChunkBase *dep) {
             return;
         }
     }
+#endif
 
-    // If this triggers, the dependent doesn't exist. This might mean chunk construction isn't deterministic.
+    // If this triggers, the two lists got out of sync
+    assert(false);
+}
+
+void ChunkBase::removeDependency(const ChunkBase *dep) {
+    DataSeriesBase::GraphLock::assertHeld();
+
+    for (std::vector<ChunkBase *>::iterator i = dependencies.begin(); i != dependencies.end(); i++) {
+        if (*i == dep) {
+            *i = dependencies.back();
+            dependencies.pop_back();
+            return;
+        }
+    }
+
+    // If this triggers, the two lists got out of sync
     assert(false);
 }
 
@@ -68,19 +279,36 @@ std::chrono::duration<float> ChunkBase::getOrdering() const {
 }
 
 std::chrono::duration<float> ChunkBase::getCriticalPathDuration() const {
-    if (std::isnan(followingDuration.count())) {
-        followingDuration = std::chrono::duration<float>::zero();
-        for (const ChunkPtrBase &dep : dependents) {
-            std::chrono::duration<float> depDur = dep->getCriticalPathDuration();
-            if (depDur > followingDuration) {
-                followingDuration = depDur;
-            }
-        }
+    // Racing threads may both compute this, but they'll get about the same result
+    std::chrono::duration<float> following = followingDuration.load(std::memory_order_relaxed);
+    if (std::isnan(following.count())) {
+        following = std::chrono::duration<float>::zero();
+        forEachDependent([&following](const ChunkBase *dep) {
+            following = std::max(following, dep->getCriticalPathDuration());
+        });
+        followingDuration.store(following, std::memory_order_relaxed);
     }
-    return ds->getAvgRunDuration() + followingDuration;
+    return ds->getAvgRunDuration() + following;
 }
 #endif
 
+void ChunkBase::execInWavefront() {
+    if (wavefrontDepth > 0) {
+        if (wavefrontLevels.size() <= level) {
+            wavefrontLevels.resize(level + 1);
+        }
+        wavefrontLevels[level].push_back(this);
+#if !ENABLE_CHUNK_MULTITHREADING
+        isQueued = true;
+#endif
+        // The GC might run before the wave does, if whoever opened it allocates chunks in the meantime
+        incRefs();
+    } else {
+        Wavefront wavefront;
+        exec();
+    }
+}
+
 void ChunkBase::notify() {
 #if ENABLE_NOTIFICATION_TRACING
     SPDLOG_TRACE(getIndentation(2) + "{}.notify() {{", name);
@@ -93,19 +321,30 @@ void ChunkBase::notify() {
 #endif
 
     if (n == 0) {
+        // Checked before anything virtual, since the GC might have already destructed it
+        bool isAlive = tryIncRefs();
 #if ENABLE_NOTIFICATION_TRACING
-        SPDLOG_TRACE(getIndentation(0) + "isDone: {}", isDone());
+        SPDLOG_TRACE(getIndentation(0) + "isAlive: {}", isAlive);
 #endif
-        if (!isDone()) {
+        if (!isAlive) {
+            // Being freed, so nothing is going to read it
+            notifies = 0;
+        } else if (isDone()) {
+            // Nothing is going to exec() and reset this
+            notifies = 0;
+            decRefs();
+        } else {
             static constexpr std::chrono::duration<float> taskLengthThreshold = std::chrono::microseconds(20);
             bool runInThread = ds->getAvgRunDuration() > taskLengthThreshold;
 #if ENABLE_NOTIFICATION_TRACING
             SPDLOG_TRACE(getIndentation(0) + "runInThread: {}", runInThread);
 #endif
             if (runInThread) {
+                // The ref stays with the task until taskDone(), so the GC can't free it while it's queued
                 ds->getContext().get<util::TaskScheduler<ChunkBase>>().addTask(this);
             } else {
-                exec();
+                execInWavefront();
+                decRefs();
             }
         }
     }
@@ -113,8 +352,8 @@ void ChunkBase::notify() {
 #if ENABLE_NOTIFICATION_TRACING
     SPDLOG_TRACE(getIndentation(0) + "isDone: {}", isDone());
 #endif
-    if (!isDone()) {
-        exec();
+    if (!isDone() && !isQueued) {
+        execInWavefront();
     }
 #endif
 
@@ -123,8 +362,17 @@ void ChunkBase::notify() {
 #endif
 }
 
+#if ENABLE_CHUNK_MULTITHREADING
+void ChunkBase::taskDone() {
+    decRefs();
+}
+#endif
+
 void ChunkBase::incRefs() {
-    if (refs++ == 0 && ds->getIsTransient()) {
+#if ENABLE_CHUNK_MULTITHREADING
+    assert(refs != freeingRefs);
+#endif
+    if (refs++ == 0 && isCollectable()) {
         assert(!canFree());
         ds->getContext().get<GarbageCollector<ChunkBase>>().dequeue(this);
     }
@@ -132,8 +380,17 @@ void ChunkBase::incRefs() {
 //    SPDLOG_DEBUG("backtrace is {}", backtrace());
 }
 void ChunkBase::decRefs() {
+#if ENABLE_CHUNK_MULTITHREADING
+    // Past the last ref, this still reads the chunk and parks it for the GC.
+    // Memory the GC frees is only held back for the scheduler's workers, so any other thread keeps the GC from running meanwhile.
+    std::optional<DataSeriesBase::GraphLock> lock;
+    if (!util::TaskScheduler<ChunkBase>::isWorkerThread()) {
+        lock.emplace();
+    }
+#endif
+
     assert(refs > 0);
-    if (--refs == 0 && ds->getIsTransient()) {
+    if (--refs == 0 && isCollectable()) {
         assert(canFree());
         ds->getContext().get<GarbageCollector<ChunkBase>>().enqueue(this);
     }
@@ -141,8 +398,60 @@ void ChunkBase::decRefs() {
 //    SPDLOG_DEBUG("backtrace is {}", backtrace());
 }
 
+#if ENABLE_CHUNK_MULTITHREADING
+bool ChunkBase::tryIncRefs() {
+    unsigned int prev = refs.load();
+    do {
+        if (prev == freeingRefs) {
+            return false;
+        }
+    } while (!refs.compare_exchange_weak(prev, prev + 1));
+
+    if (prev == 0 && isCollectable()) {
+        ds->getContext().get<GarbageCollector<ChunkBase>>().dequeue(this);
+    }
+    return true;
+}
+
+bool ChunkBase::isClaimedForFree() const {
+    return refs == freeingRefs;
+}
+
+bool ChunkBase::claimForFree() {
+    jw_util::Thread::assert_main_thread();
+
+    unsigned int expected = 0;
+    return refs.compare_exchange_strong(expected, freeingRefs);
+}
+#endif
+
 bool ChunkBase::canFree() const {
-    return refs == 0 && ds->getIsTransient();
+#if ENABLE_CHUNK_MULTITHREADING
+    unsigned int r = refs.load();
+    return (r == 0 || r == freeingRefs) && isCollectable();
+#else
+    return refs == 0 && isCollectable();
+#endif
+}
+
+void ChunkBase::retire() {
+    if (isCollectable()) {
+        return;
+    }
+
+    // Set this before checking refs, so a worker dropping the last ref either sees it or leaves the enqueue to us
+    retired = true;
+    if (refs == 0) {
+        ds->getContext().get<GarbageCollector<ChunkBase>>().enqueue(this);
+    }
+}
+
+bool ChunkBase::isCollectable() const {
+    return ds->getIsTransient() || retired;
+}
+
+void ChunkBase::spill() const {
+    ds->spillChunk(this);
 }
 
 void ChunkBase::updateMemoryUsage(std::make_signed<std::size_t>::type inc) {
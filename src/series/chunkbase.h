@@ -13,29 +13,69 @@
 
 #include "defs/ENABLE_CHUNK_DEBUG.h"
 #include "defs/ENABLE_CHUNK_MULTITHREADING.h"
-
-#if ENABLE_CHUNK_MULTITHREADING
-#include "util/spinlock.h"
-#endif
+#include "defs/ENABLE_CHUNK_SLAB_ALLOCATOR.h"
 
 #if ENABLE_CHUNK_DEBUG
 #include <string>
 #endif
 
 namespace series { class DataSeriesBase; }
+#if ENABLE_CHUNK_MULTITHREADING
+namespace util { template <typename TaskType> class TaskScheduler; }
+#endif
 
 namespace series {
 
 class ChunkBase {
 public:
-    ChunkBase(DataSeriesBase *ds);
+    ChunkBase(DataSeriesBase *ds, std::size_t index);
     virtual ~ChunkBase();
 
     ChunkBase(ChunkBase const&) = delete;
     ChunkBase& operator=(ChunkBase const&) = delete;
 
+    // While one of these is open on a thread, chunks notified on that thread are queued instead of running exec() right away.
+    // When the outermost one closes, the queue runs a level at a time, so each chunk runs once after everything upstream of it in the same wave,
+    // and the stack never gets deeper than a single exec() no matter how deep the graph is.
+    class Wavefront {
+    public:
+        Wavefront();
+        ~Wavefront();
+
+        Wavefront(Wavefront const&) = delete;
+        Wavefront& operator=(Wavefront const&) = delete;
+    };
+
+#if ENABLE_CHUNK_SLAB_ALLOCATOR || ENABLE_CHUNK_MULTITHREADING
+    // The GC frees and recreates chunks constantly, so recycle their memory instead of going through malloc.
+    // The destructor is virtual, so delete passes the size of the most derived ChunkImpl.
+    // With multithreading, a worker might still be walking into a chunk the GC just freed, so its memory is retired instead, see sealRetiredAllocations().
+    static void *operator new(std::size_t size);
+    static void operator delete(void *ptr, std::size_t size);
+#endif
+
+#if ENABLE_CHUNK_MULTITHREADING
+    // Starts a new batch of what the GC retired, and returns how many of the oldest batches every worker has moved on to another task since.
+    // Those can then go to freeRetiredAllocations(), once the GC has dealt with anything the workers parked for it on the way.
+    // Main thread only, like deleting chunks.
+    static std::size_t sealRetiredAllocations(util::TaskScheduler<ChunkBase> &scheduler);
+    static void freeRetiredAllocations(std::size_t numBatches);
+#endif
+
+    // How much memory a chunk object of this size really takes up
+    static std::size_t getAllocationSize(std::size_t size);
+    // How much memory freed chunk objects still take up
+    static std::size_t getUnusedAllocationSize();
+    // Hands at least size bytes of that back to the OS if it can, and returns how much went
+    static std::size_t trimUnusedAllocations(std::size_t size);
+
+    // Where this chunk is in its series
+    std::size_t getIndex() const {
+        return index;
+    }
+
+    // Links both ways, so whichever of the two is freed first can unlink itself from the other without recomputing anything
     void addDependent(ChunkBase *dep);
-    void removeDependent(const ChunkBase *dep);
 
 #if ENABLE_CHUNK_MULTITHREADING
     std::chrono::duration<float> getOrdering() const;
@@ -45,12 +85,34 @@ public:
     void notify();
     virtual void exec() = 0;
 
+#if ENABLE_CHUNK_MULTITHREADING
+    // Called by the TaskScheduler once exec() ran, to drop the ref notify() took for it
+    void taskDone();
+#endif
+
     virtual bool isDone() const = 0;
 
+    // Seconds it would take to recompute this chunk, per byte that freeing it would free
+    virtual float getGcCost() const = 0;
+
     void incRefs();
     void decRefs();
     bool canFree() const;
 
+#if ENABLE_CHUNK_MULTITHREADING
+    // Called by the GC right before it frees a chunk, and fails if a worker took a ref to it since it was enqueued.
+    // After this, workers that still find the chunk in a dependents list leave it alone.
+    bool claimForFree();
+    // A worker can still park a claimed chunk with the GC, right after dropping its last ref, so the GC checks this before looking at it again
+    bool isClaimedForFree() const;
+#endif
+
+    // Lets the GC free this chunk even though its series isn't transient, because no consumer will read it again
+    void retire();
+
+    // Gives the series a chance to write this chunk to its spill file before it's freed
+    void spill() const;
+
     GarbageCollector<ChunkBase>::Registration &getGcRegistration() {
         return gcReg;
     }
@@ -60,6 +122,7 @@ public:
 
 protected:
     DataSeriesBase *ds;
+    std::size_t index;
 
     GarbageCollector<ChunkBase>::Registration gcReg;
 
@@ -68,17 +131,79 @@ protected:
     // DataSeries.destroyChunk manages freeing chunks.
 #if ENABLE_CHUNK_MULTITHREADING
     std::atomic<unsigned int> refs = 0;
+
+    // What refs is set to by claimForFree()
+    static constexpr unsigned int freeingRefs = static_cast<unsigned int>(-1);
+
+    // For worker threads that only have a raw pointer to this, from a dependents list
+    bool tryIncRefs();
 #else
     unsigned int refs = 0;
 #endif
 
 #if ENABLE_CHUNK_MULTITHREADING
-    std::atomic<unsigned int> notifies = 0;
-    util::SpinLock mutex;
+    std::atomic<bool> retired = false;
+#else
+    bool retired = false;
 #endif
+
+    bool isCollectable() const;
+
+#if ENABLE_CHUNK_MULTITHREADING
+    std::atomic<unsigned int> notifies = 0;
+
+    // Dependents are added and removed under the DataSeriesBase::GraphLock, but worker threads walk the list while notifying.
+    // Nodes are prepended with a single atomic store and unlinked with another, so walking it never needs a lock.
+    // Unlinked nodes are retired rather than deleted, since a worker might still be standing on one.
+    struct DependentNode {
+        ChunkBase *dep;
+        std::atomic<DependentNode *> next;
+    };
+    std::atomic<DependentNode *> dependents = nullptr;
+
+    mutable std::atomic<std::chrono::duration<float>> followingDuration;
+#else
     std::vector<ChunkBase *> dependents;
 
     mutable std::chrono::duration<float> followingDuration;
+#endif
+
+    // The chunks this one was computed from, the reverse of their dependents lists. Only touched under the DataSeriesBase::GraphLock.
+    std::vector<ChunkBase *> dependencies;
+
+    // One more than the deepest of the dependencies, so dependents always come later in a Wavefront
+    unsigned int level = 0;
+
+#if !ENABLE_CHUNK_MULTITHREADING
+    // With multithreading, notifies already makes sure a chunk is only queued once
+    bool isQueued = false;
+#endif
+
+    static thread_local unsigned int wavefrontDepth;
+    static thread_local std::vector<std::vector<ChunkBase *>> wavefrontLevels;
+
+    void execInWavefront();
+
+    void removeDependent(const ChunkBase *dep);
+    void removeDependency(const ChunkBase *dep);
+
+#if ENABLE_CHUNK_MULTITHREADING
+    static void retireAllocation(void *ptr, std::size_t size, void (*free)(void *ptr, std::size_t size));
+    static void retireNode(DependentNode *node);
+#endif
+
+    template <typename FuncType>
+    void forEachDependent(FuncType func) const {
+#if ENABLE_CHUNK_MULTITHREADING
+        for (DependentNode *node = dependents.load(); node; node = node->next.load()) {
+            func(node->dep);
+        }
+#else
+        for (ChunkBase *dep : dependents) {
+            func(dep);
+        }
+#endif
+    }
 
 #if ENABLE_CHUNK_DEBUG
     static std::string getIndentation(signed int inc) {
@@ -0,0 +1,225 @@
+#include "chunkcache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <link.h>
+#include <elf.h>
+#endif
+
+#include "log.h"
+#include "version.h"
+#include "app/options.h"
+
+#include "defs/CHUNK_SIZE_LOG2.h"
+#include "defs/INPUT_SERIES_ELEMENT_TYPE.h"
+#include "defs/ENABLE_APPROX_SIMD_MATH.h"
+#include "defs/CONV_CACHE_KERNEL_FFT_GTE_SIZE_LOG2.h"
+#include "defs/CONV_CACHE_TS_FFT_GTE_SIZE_LOG2.h"
+#include "defs/CONV_USE_FFT_GTE_SIZE_LOG2.h"
+#include "defs/CONV_VARIANT.h"
+
+#define STRINGIFY2(x) #x
+#define STRINGIFY(x) STRINGIFY2(x)
+
+namespace series {
+
+bool ChunkCache::isEnabled() {
+    return !app::Options::getInstance().chunkCacheDir.empty();
+}
+
+void ChunkCache::setInputPath(const std::string &path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) == -1 || !S_ISREG(st.st_mode)) {
+        SPDLOG_WARN("Data path {} isn't a regular file, so chunks derived from the input can't be cached", path);
+        inputIdentity = 0;
+        return;
+    }
+
+    std::uint64_t res = hash(getBaseKey(), path.data(), path.size());
+    std::int64_t size = st.st_size;
+    std::int64_t mtimeSec = st.st_mtim.tv_sec;
+    std::int64_t mtimeNsec = st.st_mtim.tv_nsec;
+    res = hash(res, &size, sizeof(size));
+    res = hash(res, &mtimeSec, sizeof(mtimeSec));
+    res = hash(res, &mtimeNsec, sizeof(mtimeNsec));
+    inputIdentity = res ? res : 1;
+}
+
+std::uint64_t ChunkCache::hash(std::uint64_t seed, const void *data, std::size_t size) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (std::size_t i = 0; i < size; i++) {
+        seed ^= bytes[i];
+        seed *= 0x100000001b3ull;
+    }
+    return seed;
+}
+
+#ifdef __linux__
+static int findBuildId(struct dl_phdr_info *info, std::size_t size, void *data) {
+    (void) size;
+
+    // The first object is the executable itself
+    std::string &dst = *static_cast<std::string *>(data);
+    for (ElfW(Half) i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr) &phdr = info->dlpi_phdr[i];
+        if (phdr.p_type != PT_NOTE) {
+            continue;
+        }
+
+        const char *pos = reinterpret_cast<const char *>(info->dlpi_addr + phdr.p_vaddr);
+        const char *end = pos + phdr.p_memsz;
+        while (pos + sizeof(ElfW(Nhdr)) <= end) {
+            const ElfW(Nhdr) &note = *reinterpret_cast<const ElfW(Nhdr) *>(pos);
+            const char *name = pos + sizeof(ElfW(Nhdr));
+            const char *desc = name + ((note.n_namesz + 3) & ~3u);
+            if (note.n_type == NT_GNU_BUILD_ID && note.n_namesz == 4 && std::memcmp(name, "GNU", 4) == 0) {
+                dst.assign(desc, note.n_descsz);
+                return 1;
+            }
+            pos = desc + ((note.n_descsz + 3) & ~3u);
+        }
+    }
+    return 1;
+}
+#endif
+
+std::string ChunkCache::getBuildId() {
+    std::string res;
+#ifdef __linux__
+    dl_iterate_phdr(findBuildId, &res);
+#endif
+    return res;
+}
+
+std::uint64_t ChunkCache::getBaseKey() {
+    static const std::uint64_t baseKey = [] {
+        std::uint64_t res = 0xcbf29ce484222325ull;
+
+        // The linker's build-id changes with any change to the code or the defines, so chunks from other builds never match
+        std::string buildId = getBuildId();
+        if (buildId.empty()) {
+            SPDLOG_WARN("This build has no build-id, so --chunk-cache-dir can only tell builds apart by their version and defines. Clear it after changing the code.");
+        }
+        res = hash(res, buildId.data(), buildId.size());
+
+        // Also spelled out in case there's no build-id
+        res = hash(res, tsVizVersion, std::strlen(tsVizVersion));
+        static constexpr char defines[] =
+            "CHUNK_SIZE_LOG2=" STRINGIFY(CHUNK_SIZE_LOG2)
+            " INPUT_SERIES_ELEMENT_TYPE=" STRINGIFY(INPUT_SERIES_ELEMENT_TYPE)
+            " ENABLE_APPROX_SIMD_MATH=" STRINGIFY(ENABLE_APPROX_SIMD_MATH)
+            " CONV_CACHE_KERNEL_FFT_GTE_SIZE_LOG2=" STRINGIFY(CONV_CACHE_KERNEL_FFT_GTE_SIZE_LOG2)
+            " CONV_CACHE_TS_FFT_GTE_SIZE_LOG2=" STRINGIFY(CONV_CACHE_TS_FFT_GTE_SIZE_LOG2)
+            " CONV_USE_FFT_GTE_SIZE_LOG2=" STRINGIFY(CONV_USE_FFT_GTE_SIZE_LOG2)
+            " CONV_VARIANT=" STRINGIFY(CONV_VARIANT);
+        res = hash(res, defines, sizeof(defines) - 1);
+
+        return res;
+    }();
+    return baseKey;
+}
+
+void ChunkCache::loadIndex() {
+    if (isIndexLoaded) {
+        return;
+    }
+    isIndexLoaded = true;
+
+    const std::string &dir = app::Options::getInstance().chunkCacheDir;
+    DIR *dirHandle = opendir(dir.c_str());
+    if (!dirHandle) {
+        SPDLOG_WARN("Couldn't list --chunk-cache-dir {}: {}", dir, std::strerror(errno));
+        return;
+    }
+
+    while (struct dirent *entry = readdir(dirHandle)) {
+        // Skips leftover temporary files too, since they don't end after the index
+        unsigned long long key;
+        std::size_t chunkIndex;
+        int nameSize = -1;
+        if (std::sscanf(entry->d_name, "%16llx.%zu%n", &key, &chunkIndex, &nameSize) == 2 && entry->d_name[nameSize] == '\0') {
+            index.emplace(key, chunkIndex);
+        }
+    }
+
+    closedir(dirHandle);
+}
+
+bool ChunkCache::contains(std::uint64_t key, std::size_t chunkIndex) {
+    std::lock_guard<std::mutex> lock(indexMutex);
+    loadIndex();
+    return index.contains(std::make_pair(key, chunkIndex));
+}
+
+void ChunkCache::read(std::uint64_t key, std::size_t chunkIndex, void *dst, std::size_t size) {
+    std::string path = getPath(key, chunkIndex);
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw std::runtime_error("Couldn't open cached chunk " + path + ": " + std::strerror(errno));
+    }
+
+    std::size_t done = 0;
+    while (done < size) {
+        ssize_t res = ::read(fd, static_cast<char *>(dst) + done, size - done);
+        if (res <= 0) {
+            close(fd);
+            throw std::runtime_error("Cached chunk " + path + " is truncated or unreadable");
+        }
+        done += res;
+    }
+
+    close(fd);
+}
+
+void ChunkCache::write(std::uint64_t key, std::size_t chunkIndex, const void *src, std::size_t size) {
+    std::string path = getPath(key, chunkIndex);
+
+    // Write to a temporary file and rename it into place, so a crash never leaves a partial chunk behind
+    std::string tmpPathStr = path + ".tmp-XXXXXX";
+    std::vector<char> tmpPath(tmpPathStr.cbegin(), tmpPathStr.cend());
+    tmpPath.push_back('\0');
+
+    int fd = mkstemp(tmpPath.data());
+    if (fd == -1) {
+        SPDLOG_WARN("Couldn't create cached chunk {}: {}", tmpPathStr, std::strerror(errno));
+        return;
+    }
+
+    std::size_t done = 0;
+    while (done < size) {
+        ssize_t res = ::write(fd, static_cast<const char *>(src) + done, size - done);
+        if (res <= 0) {
+            SPDLOG_WARN("Couldn't write cached chunk {}: {}", path, std::strerror(errno));
+            close(fd);
+            unlink(tmpPath.data());
+            return;
+        }
+        done += res;
+    }
+
+    close(fd);
+    if (rename(tmpPath.data(), path.c_str()) == -1) {
+        SPDLOG_WARN("Couldn't move cached chunk into place at {}: {}", path, std::strerror(errno));
+        unlink(tmpPath.data());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(indexMutex);
+    loadIndex();
+    index.emplace(key, chunkIndex);
+}
+
+std::string ChunkCache::getPath(std::uint64_t key, std::size_t chunkIndex) {
+    char name[48];
+    std::snprintf(name, sizeof(name), "/%016llx.%zu", static_cast<unsigned long long>(key), chunkIndex);
+    return app::Options::getInstance().chunkCacheDir + name;
+}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <set>
+#include <mutex>
+
+namespace series {
+
+// Complete chunks persisted in --chunk-cache-dir so they survive restarts.
+// Each chunk is its own file, named by the cache key of its series and the chunk index.
+// A series' cache key is a stable hash of the call that built it, the keys of its operands, and the identity of the data file, see Resolver::call().
+// Every key starts from getBaseKey(), which covers the executable's build-id and the defines that change results,
+// so rebuilding with any change leaves the old files unused rather than read back. Nothing deletes them; clear the directory to reclaim the space.
+// The directory is listed once, on first use, so files added to it by other processes while running aren't seen.
+class ChunkCache {
+public:
+    static bool isEnabled();
+
+    // Identifies the data the input series are fed from, by path, size and modification time.
+    // Stays 0 for pipes and other streams, since there's no telling if they'll produce the same data next time.
+    static void setInputPath(const std::string &path);
+    static std::uint64_t getInputIdentity() {
+        return inputIdentity;
+    }
+
+    // FNV-1a, because the keys have to come out the same in every run and on every build
+    static std::uint64_t hash(std::uint64_t seed, const void *data, std::size_t size);
+    static std::uint64_t getBaseKey();
+
+    // Doesn't touch the disk after the first call
+    static bool contains(std::uint64_t key, std::size_t chunkIndex);
+    static void read(std::uint64_t key, std::size_t chunkIndex, void *dst, std::size_t size);
+    // Safe to call from the worker threads. Failures only get logged, since the cache is just an optimization.
+    static void write(std::uint64_t key, std::size_t chunkIndex, const void *src, std::size_t size);
+
+private:
+    static inline std::uint64_t inputIdentity = 0;
+
+    static inline std::mutex indexMutex;
+    static inline bool isIndexLoaded = false;
+    static inline std::set<std::pair<std::uint64_t, std::size_t>> index;
+
+    // Returns the GNU build-id note of the executable, or an empty string if it was linked without one
+    static std::string getBuildId();
+    // Requires indexMutex
+    static void loadIndex();
+
+    static std::string getPath(std::uint64_t key, std::size_t chunkIndex);
+};
+
+}
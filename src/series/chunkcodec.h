@@ -0,0 +1,166 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <bit>
+#include <type_traits>
+
+namespace series {
+
+// Gorilla-style XOR coding of float and double chunks, for keeping evicted chunks in memory, see CompressedChunks.
+// Each value is XORed with the one before it. An unchanged value takes one bit, so constant runs and step functions shrink by ~64x,
+// and a change only stores the bits between the leading and trailing zeros of the XOR, reusing the previous window when they fit.
+template <typename ElementType>
+class ChunkCodec {
+    static_assert(std::is_floating_point_v<ElementType>, "Can only encode real chunks");
+
+    typedef typename std::conditional<sizeof(ElementType) == 4, std::uint32_t, std::uint64_t>::type Bits;
+    static constexpr unsigned int numBits = sizeof(Bits) * 8;
+    // Enough to store a count of leading zeros or a window length - 1
+    static constexpr unsigned int countBits = std::bit_width(numBits - 1);
+
+public:
+    typedef std::vector<std::uint64_t> Encoded;
+
+    // Returns false without finishing if the result would take more than maxWords
+    static bool encode(const ElementType *src, std::size_t count, std::size_t maxWords, Encoded &dst) {
+        Writer writer(dst, maxWords);
+
+        Bits prev = 0;
+        unsigned int windowLeading = numBits;
+        unsigned int windowLength = 0;
+        for (std::size_t i = 0; i < count; i++) {
+            Bits value = toBits(src[i]);
+            Bits diff = value ^ prev;
+            prev = value;
+
+            if (diff == 0) {
+                writer.write(0, 1);
+            } else {
+                unsigned int leading = std::countl_zero(diff);
+                unsigned int trailing = std::countr_zero(diff);
+                if (windowLength && leading >= windowLeading && trailing >= numBits - windowLeading - windowLength) {
+                    writer.write(0b01, 2);
+                } else {
+                    windowLeading = leading;
+                    windowLength = numBits - leading - trailing;
+                    writer.write(0b11, 2);
+                    writer.write(windowLeading, countBits);
+                    writer.write(windowLength - 1, countBits);
+                }
+                writer.write(diff >> (numBits - windowLeading - windowLength), windowLength);
+            }
+
+            if (writer.isFull()) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    static void decode(const Encoded &src, ElementType *dst, std::size_t count) {
+        auto t1 = std::chrono::high_resolution_clock::now();
+
+        Reader reader(src);
+        Bits prev = 0;
+        unsigned int windowLeading = 0;
+        unsigned int windowLength = 0;
+        for (std::size_t i = 0; i < count; i++) {
+            if (reader.read(1)) {
+                if (reader.read(1)) {
+                    windowLeading = reader.read(countBits);
+                    windowLength = reader.read(countBits) + 1;
+                }
+                prev ^= static_cast<Bits>(reader.read(windowLength)) << (numBits - windowLeading - windowLength);
+            }
+            dst[i] = fromBits(prev);
+        }
+
+        auto t2 = std::chrono::high_resolution_clock::now();
+
+        static constexpr float durationSampleResponse = 0.1f;
+        float sample = std::chrono::duration<float>(t2 - t1).count() / count;
+        float prevSample = decodeSecondsPerElement.load(std::memory_order_relaxed);
+        decodeSecondsPerElement.store(prevSample * (1.0f - durationSampleResponse) + sample * durationSampleResponse, std::memory_order_relaxed);
+    }
+
+    // Measured from previous decodes, like SpillFile::estimateReadDuration()
+    static std::chrono::duration<float> estimateDecodeDuration(std::size_t count) {
+        return std::chrono::duration<float>(decodeSecondsPerElement.load(std::memory_order_relaxed) * count);
+    }
+
+private:
+    static inline std::atomic<float> decodeSecondsPerElement = 3e-9f;
+
+    static Bits toBits(ElementType value) {
+        Bits res;
+        std::memcpy(&res, &value, sizeof(res));
+        return res;
+    }
+    static ElementType fromBits(Bits bits) {
+        ElementType res;
+        std::memcpy(&res, &bits, sizeof(res));
+        return res;
+    }
+
+    class Writer {
+    public:
+        Writer(Encoded &words, std::size_t maxWords)
+            : words(words)
+            , maxWords(maxWords)
+        {
+            words.clear();
+        }
+
+        // Writes the low numBits of value, for numBits in [1, 64]
+        void write(std::uint64_t value, unsigned int numBits) {
+            unsigned int offset = bitPos % 64;
+            if (offset == 0) {
+                words.push_back(0);
+            }
+            words.back() |= value << offset;
+            if (offset + numBits > 64) {
+                words.push_back(value >> (64 - offset));
+            }
+            bitPos += numBits;
+        }
+
+        bool isFull() const {
+            return words.size() > maxWords;
+        }
+
+    private:
+        Encoded &words;
+        std::size_t maxWords;
+        std::size_t bitPos = 0;
+    };
+
+    class Reader {
+    public:
+        Reader(const Encoded &words)
+            : words(words)
+        {}
+
+        // Reads numBits in [1, 64]
+        std::uint64_t read(unsigned int numBits) {
+            std::size_t index = bitPos / 64;
+            unsigned int offset = bitPos % 64;
+            std::uint64_t res = words[index] >> offset;
+            if (offset + numBits > 64) {
+                res |= words[index + 1] << (64 - offset);
+            }
+            bitPos += numBits;
+            return numBits == 64 ? res : res & ((static_cast<std::uint64_t>(1) << numBits) - 1);
+        }
+
+    private:
+        const Encoded &words;
+        std::size_t bitPos = 0;
+    };
+};
+
+}
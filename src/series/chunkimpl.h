@@ -8,13 +8,13 @@ namespace series {
 template <typename ElementType, std::size_t size, typename ComputerType>
 class ChunkImpl final /* final because we want sizeof(this) to be correct */ : public Chunk<ElementType, size> {
 public:
-    ChunkImpl(DataSeriesBase *ds, ComputerType &&computer)
-        : Chunk<ElementType, size>(ds)
+    ChunkImpl(DataSeriesBase *ds, std::size_t index, ComputerType &&computer)
+        : Chunk<ElementType, size>(ds, index)
         , computer(std::move(computer))
     {
         SPDLOG_DEBUG("Creating chunk {} with size {}", static_cast<void *>(this), sizeof(*this));
 
-        this->updateMemoryUsage(sizeof(*this));
+        this->updateMemoryUsage(ChunkBase::getAllocationSize(sizeof(*this)));
     }
 
     ~ChunkImpl() {
@@ -30,7 +30,7 @@ public:
         assert(!hasValue);
 #endif
 
-        this->updateMemoryUsage(-sizeof(*this));
+        this->updateMemoryUsage(-ChunkBase::getAllocationSize(sizeof(*this)));
 
         SPDLOG_DEBUG("Destroying chunk {} with size {}", static_cast<void *>(this), sizeof(*this));
     }
@@ -0,0 +1,100 @@
+#include "compressedchunks.h"
+
+#include "jw_util/thread.h"
+
+#include "app/appcontext.h"
+#include "app/options.h"
+#include "series/dataseriesbase.h"
+#include "series/chunkbase.h"
+#include "series/garbagecollector.h"
+#include "series/chunkcodec.h"
+#include "util/testrunner.h"
+
+#include <cmath>
+#include <random>
+
+namespace series {
+
+CompressedChunks::CompressedChunks(app::AppContext &context)
+    : context(context)
+{}
+
+bool CompressedChunks::isEnabled() {
+    return app::Options::getInstance().compressEvicted;
+}
+
+std::size_t CompressedChunks::getCapacity() {
+    return app::Options::getInstance().gcMemoryLimit / 2;
+}
+
+CompressedChunks::Handle CompressedChunks::add(DataSeriesBase *series, std::size_t chunkIndex, std::size_t bytes) {
+    DataSeriesBase::GraphLock::assertHeld();
+    assert(bytes <= getCapacity());
+
+    while (totalBytes + bytes > getCapacity()) {
+        const Entry &oldest = entries.front();
+        oldest.series->dropCompressedChunk(oldest.chunkIndex);
+    }
+
+    totalBytes += bytes;
+    context.get<GarbageCollector<ChunkBase>>().updateMemoryUsage(bytes);
+    return entries.insert(entries.end(), Entry{series, chunkIndex, bytes});
+}
+
+void CompressedChunks::remove(Handle handle) {
+    DataSeriesBase::GraphLock::assertHeld();
+
+    totalBytes -= handle->bytes;
+    context.get<GarbageCollector<ChunkBase>>().updateMemoryUsage(-static_cast<std::make_signed<std::size_t>::type>(handle->bytes));
+    entries.erase(handle);
+}
+
+}
+
+template <typename ElementType>
+static void testCodec() {
+    static constexpr std::size_t count = 1000;
+    static constexpr std::size_t rawWords = count * sizeof(ElementType) / sizeof(std::uint64_t);
+
+    std::vector<ElementType> src(count);
+    std::vector<ElementType> dst(count);
+    std::vector<std::uint64_t> encoded;
+
+    // Steps, a slow ramp, and some NaNs and infinities, which all have to come back bit for bit
+    for (std::size_t i = 0; i < count; i++) {
+        src[i] = static_cast<ElementType>(i / 100) * static_cast<ElementType>(0.1);
+    }
+    for (std::size_t i = 300; i < 400; i++) {
+        src[i] = static_cast<ElementType>(i) * static_cast<ElementType>(0.5);
+    }
+    src[500] = NAN;
+    src[501] = -INFINITY;
+    src[502] = static_cast<ElementType>(-0.0);
+
+    bool fits = series::ChunkCodec<ElementType>::encode(src.data(), count, rawWords / 2, encoded);
+    assert(fits);
+    (void) fits;
+    series::ChunkCodec<ElementType>::decode(encoded, dst.data(), count);
+    assert(std::memcmp(src.data(), dst.data(), sizeof(ElementType) * count) == 0);
+
+    // Noise doesn't compress, and the encoder should give up instead of going over
+    std::mt19937 rng(1234);
+    std::normal_distribution<ElementType> dist;
+    for (ElementType &value : src) {
+        value = dist(rng);
+    }
+    assert(!series::ChunkCodec<ElementType>::encode(src.data(), count, rawWords / 2, encoded));
+
+    // Given the room, it still round trips
+    fits = series::ChunkCodec<ElementType>::encode(src.data(), count, rawWords * 2, encoded);
+    assert(fits);
+    series::ChunkCodec<ElementType>::decode(encoded, dst.data(), count);
+    assert(std::memcmp(src.data(), dst.data(), sizeof(ElementType) * count) == 0);
+}
+
+static int _ = util::TestRunner::getInstance().registerTest([](app::AppContext &context) {
+    (void) context;
+
+    testCodec<float>();
+    testCodec<double>();
+});
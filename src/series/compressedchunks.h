@@ -0,0 +1,42 @@
+#pragma once
+
+#include <list>
+#include <cstddef>
+
+namespace app { class AppContext; }
+namespace series { class DataSeriesBase; }
+
+namespace series {
+
+// Complete chunks the garbage collector freed but that were kept in memory encoded with ChunkCodec, with --compress-evicted.
+// They count towards --gc-memory-limit like chunks do, but only up to half of it, and past that the oldest ones get dropped.
+// Everything here happens on the main thread.
+class CompressedChunks {
+    struct Entry {
+        DataSeriesBase *series;
+        std::size_t chunkIndex;
+        std::size_t bytes;
+    };
+
+public:
+    typedef std::list<Entry>::iterator Handle;
+
+    CompressedChunks(app::AppContext &context);
+
+    static bool isEnabled();
+
+    // The most a single chunk can take, so callers can give up on encoding early
+    static std::size_t getCapacity();
+
+    // Makes room by calling DataSeriesBase::dropCompressedChunk() on the oldest entries
+    Handle add(DataSeriesBase *series, std::size_t chunkIndex, std::size_t bytes);
+    void remove(Handle handle);
+
+private:
+    app::AppContext &context;
+
+    std::list<Entry> entries;
+    std::size_t totalBytes = 0;
+};
+
+}
@@ -0,0 +1,137 @@
+#include "convbenchmark.h"
+
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "series/fftwx.h"
+#include "util/simd.h"
+#include "log.h"
+
+namespace {
+
+template <typename ElementType>
+class ConvBenchmark {
+    typedef series::fftwx_impl<ElementType> fftwx;
+    typedef series::FftwPlanner<ElementType> Planner;
+    typedef typename fftwx::Complex Complex;
+
+public:
+    ConvBenchmark(unsigned int numPairs)
+        : numPairs(numPairs)
+    {
+        std::default_random_engine generator(numPairs);
+        std::normal_distribution<ElementType> distribution;
+
+        for (unsigned int i = 0; i < numPairs * 2; i++) {
+            Complex *spectrum = fftwx::alloc_complex(CHUNK_SIZE + 1);
+            for (unsigned int j = 0; j < CHUNK_SIZE + 1; j++) {
+                spectrum[j] = Complex(distribution(generator), distribution(generator));
+            }
+            (i < numPairs ? kernelSpectra : tsSpectra).push_back(spectrum);
+        }
+    }
+
+    ~ConvBenchmark() {
+        for (Complex *spectrum : kernelSpectra) {
+            fftwx::free(spectrum);
+        }
+        for (Complex *spectrum : tsSpectra) {
+            fftwx::free(spectrum);
+        }
+    }
+
+    // How ConvSeries used to do it
+    void runPerPair(ElementType *dst) const {
+        const typename Planner::IO planIO = Planner::request();
+
+        for (unsigned int i = 0; i < numPairs; i++) {
+            for (unsigned int j = 0; j < CHUNK_SIZE + 1; j++) {
+                planIO.complex[j] = kernelSpectra[i][j] * tsSpectra[i][j];
+            }
+
+            fftwx::execute_dft_c2r(Planner::template getPlanBwd<CHUNK_SIZE * 2>(), planIO.complex, planIO.real);
+
+            for (unsigned int j = 0; j < CHUNK_SIZE; j++) {
+                dst[j] = i == 0 ? planIO.real[CHUNK_SIZE + j] : dst[j] + planIO.real[CHUNK_SIZE + j];
+            }
+        }
+
+        Planner::release(planIO);
+    }
+
+    // How ConvSeries does it now
+    void runAccumulated(ElementType *dst) const {
+        const typename Planner::IO planIO = Planner::request();
+
+        util::simdComplexMultiply<false>(planIO.complex, kernelSpectra[0], tsSpectra[0], CHUNK_SIZE + 1);
+        for (unsigned int i = 1; i < numPairs; i++) {
+            util::simdComplexMultiply<true>(planIO.complex, kernelSpectra[i], tsSpectra[i], CHUNK_SIZE + 1);
+        }
+
+        fftwx::execute_dft_c2r(Planner::template getPlanBwd<CHUNK_SIZE * 2>(), planIO.complex, planIO.real);
+
+        std::copy_n(planIO.real + CHUNK_SIZE, CHUNK_SIZE, dst);
+
+        Planner::release(planIO);
+    }
+
+private:
+    unsigned int numPairs;
+    std::vector<Complex *> kernelSpectra;
+    std::vector<Complex *> tsSpectra;
+};
+
+template <typename FuncType>
+std::chrono::duration<double> timeBest(FuncType func) {
+    static constexpr unsigned int reps = 5;
+
+    std::chrono::duration<double> best = std::chrono::duration<double>::max();
+    for (unsigned int i = 0; i < reps; i++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        func();
+        best = std::min<std::chrono::duration<double>>(best, std::chrono::steady_clock::now() - start);
+    }
+    return best;
+}
+
+template <typename ElementType>
+void runForType() {
+    series::FftwPlanner<ElementType>::init();
+
+    std::vector<ElementType> perPairRes(CHUNK_SIZE);
+    std::vector<ElementType> accumulatedRes(CHUNK_SIZE);
+
+    for (unsigned int kernelSizeLog2 = 16; kernelSizeLog2 <= 22; kernelSizeLog2++) {
+        unsigned int numPairs = std::max<unsigned int>(1, (1u << kernelSizeLog2) / CHUNK_SIZE);
+        ConvBenchmark<ElementType> benchmark(numPairs);
+
+        std::chrono::duration<double> perPair = timeBest([&]() {benchmark.runPerPair(perPairRes.data());});
+        std::chrono::duration<double> accumulated = timeBest([&]() {benchmark.runAccumulated(accumulatedRes.data());});
+
+        ElementType maxDiff = 0.0;
+        ElementType maxAbs = 0.0;
+        for (unsigned int i = 0; i < CHUNK_SIZE; i++) {
+            maxDiff = std::max(maxDiff, std::abs(perPairRes[i] - accumulatedRes[i]));
+            maxAbs = std::max(maxAbs, std::abs(perPairRes[i]));
+        }
+
+        SPDLOG_INFO("Conv benchmark: type={} kernelSize=2^{} pairs={} perPair={:.3f}ms accumulated={:.3f}ms speedup={:.2f} relDiff={:.2e}",
+            jw_util::TypeName::get<ElementType>(), kernelSizeLog2, numPairs, perPair.count() * 1e3, accumulated.count() * 1e3, perPair / accumulated, maxDiff / maxAbs);
+    }
+}
+
+}
+
+namespace series {
+
+void runConvBenchmark(app::AppContext &context) {
+    (void) context;
+
+    runForType<float>();
+    runForType<double>();
+}
+
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+namespace app { class AppContext; }
+
+namespace series {
+
+// Times the prior-chunk step of ConvSeries both ways, for kernel sizes 2^16 through 2^22:
+// an inverse FFT per kernel/ts chunk pair, against summing the spectral products and running a single inverse FFT
+void runConvBenchmark(app::AppContext &context);
+
+}
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <vector>
+#include <deque>
 #include <iomanip>
+#include <memory>
+#include <type_traits>
 
 #include "jw_util/thread.h"
 
@@ -11,6 +14,18 @@
 #include "series/chunk.h"
 #include "series/chunkimpl.h"
 #include "series/garbagecollector.h"
+#include "series/spillfile.h"
+#include "series/chunkcache.h"
+#include "series/chunkcodec.h"
+#include "series/compressedchunks.h"
+#include "series/summarypyramid.h"
+
+#include "defs/ENABLE_BOUNDED_RETENTION.h"
+#include "defs/ENABLE_CHUNK_MULTITHREADING.h"
+
+#if ENABLE_CHUNK_MULTITHREADING
+#include <atomic>
+#endif
 
 namespace series {
 
@@ -28,66 +43,149 @@ public:
         // This is being destructed when an exception is thrown from the constructor.
         // TODO: Figure out how to catch bad destructions.
         // assert(false);
+
+        GraphLock lock;
+        for (Slot &slot : slots) {
+            if (slot.compressed.data) {
+                context.get<CompressedChunks>().remove(slot.compressed.handle);
+            }
+        }
+
+        delete summaries;
     }
 
     template <std::size_t desiredSize = CHUNK_SIZE>
     ChunkPtr<ElementType, size> getChunk(std::size_t chunkIndex) {
         static_assert(size == desiredSize, "DataSeries chunk size doesn't match desired size");
 
-        jw_util::Thread::assert_main_thread();
-
-        if (dryConstruct) {
-            if (chunks[chunkIndex]) {
-                getDependencyStack().push_back(chunks[chunkIndex]);
+        GraphLock lock;
+
+        const Slot &slot = getSlot(chunkIndex);
+        Chunk<ElementType, size> *chunk = slot.chunk;
+        if (!chunk) {
+            if (slot.compressed.data) {
+                chunk = restoreCompressed(chunkIndex);
+            } else if (slot.spill.isSpilled) {
+                chunk = restoreChunk(chunkIndex, [spillFile = spillFile.get(), spillSlot = slot.spill.slot](ElementType *dst) {
+                    spillFile->read(spillSlot, dst);
+                });
+            } else if (getPersistentCacheKey() && ChunkCache::contains(getPersistentCacheKey(), chunkIndex)) {
+                chunk = restoreChunk(chunkIndex, [key = getPersistentCacheKey(), chunkIndex](ElementType *dst) {
+                    ChunkCache::read(key, chunkIndex, dst, sizeof(ElementType) * size);
+                });
+            } else {
+                std::size_t depStackSize = getDependencyStack().size();
+                // makeChunk() might recursively get earlier chunks of this same series
+                std::size_t prevConstructIndex = constructIndex;
+                constructIndex = chunkIndex;
+                chunk = makeChunk(chunkIndex);
+                constructIndex = prevConstructIndex;
+
+                assert(getDependencyStack().size() >= depStackSize);
+                while (getDependencyStack().size() > depStackSize) {
+                    getDependencyStack().back()->addDependent(chunk);
+                    getDependencyStack().pop_back();
+                }
             }
-            return ChunkPtr<ElementType, size>::null();
-        }
-
-        while (chunks.size() <= chunkIndex) {
-            chunks.emplace_back(nullptr);
-        }
-        if (!chunks[chunkIndex]) {
-            std::size_t depStackSize = getDependencyStack().size();
-            chunks[chunkIndex] = makeChunk(chunkIndex);
-
-            assert(getDependencyStack().size() >= depStackSize);
-            while (getDependencyStack().size() > depStackSize) {
-                getDependencyStack().back()->addDependent(chunks[chunkIndex]);
-                getDependencyStack().pop_back();
+            assert(chunk->getIndex() == chunkIndex);
+            // makeChunk() might have grown the slots in either direction, so look it up again
+            getSlot(chunkIndex).chunk = chunk;
+
+#if ENABLE_BOUNDED_RETENTION
+            if (isRetired(chunkIndex)) {
+                chunk->retire();
+            } else if (hasCarry()) {
+                pinChunk(chunkIndex);
             }
-            chunks[chunkIndex]->notify();
+#endif
+
+            chunk->notify();
         }
 
-        getDependencyStack().push_back(chunks[chunkIndex]);
+        getDependencyStack().push_back(chunk);
 
-        return ChunkPtr<ElementType, size>::construct(chunks[chunkIndex]);
+        return ChunkPtr<ElementType, size>::construct(chunk);
     }
 
     void releaseChunk(const ChunkBase *chunk) {
-        std::size_t chunkIndex = locateChunk(chunk);
+        Slot *slot = findSlot(chunk->getIndex());
+        assert(slot && slot->chunk == chunk);
         assert(chunk->canFree());
 
-        jw_util::Thread::assert_main_thread();
+        GraphLock::assertHeld();
+
+        SPDLOG_DEBUG("Nullify {}", static_cast<void *>(slot->chunk));
+        slot->chunk = nullptr;
+
+        trimSlots();
+    }
+
+    void spillChunk(const ChunkBase *chunk) override {
+        GraphLock::assertHeld();
+
+        if (!chunk->isDone()) {
+            return;
+        }
+
+        if (getSlot(chunk->getIndex()).spill.isSpilled) {
+            // Still on disk from the last time
+            return;
+        }
+        if (getPersistentCacheKey()) {
+            // Already in the chunk cache, which getChunk() checks anyways
+            return;
+        }
+
+        // Chunks that exist nowhere else come first for the compressed budget
+        if (compressChunk(static_cast<const Chunk<ElementType, size> *>(chunk))) {
+            return;
+        }
+
+        if (!SpillFile::isEnabled()) {
+            return;
+        }
+
+        // Only worth it if reading it back beats recomputing it
+        if (canRecompute() && getAvgRunDuration() * size <= SpillFile::estimateReadDuration(sizeof(ElementType) * size)) {
+            return;
+        }
+
+        if (!spillFile) {
+            spillFile = std::make_unique<SpillFile>(sizeof(ElementType) * size);
+        }
+        SpillEntry &spillEntry = getSlot(chunk->getIndex()).spill;
+        spillEntry.slot = spillFile->write(static_cast<const Chunk<ElementType, size> *>(chunk)->getData());
+        spillEntry.isSpilled = true;
+    }
 
-        std::size_t depStackSize = getDependencyStack().size();
+    void dropCompressedChunk(std::size_t chunkIndex) override {
+        Slot *slot = findSlot(chunkIndex);
+        assert(slot && slot->compressed.data);
 
-        assert(dryConstruct == false);
-        dryConstruct = true;
+        slot->compressed.data.reset();
+        context.get<CompressedChunks>().remove(slot->compressed.handle);
 
-        Chunk<ElementType, size> *dryChunk = makeChunk(chunkIndex);
-        assert(dryChunk == nullptr);
+        trimSlots();
+    }
 
-        assert(dryConstruct == true);
-        dryConstruct = false;
+    // Only kept once something asks for it, since summarizing costs a pass over every chunk that completes.
+    // Chunks that completed before that aren't in it, so callers add those themselves as they come across them.
+    SummaryPyramid<ElementType> &getSummaries() {
+        static_assert(std::is_floating_point_v<ElementType> && size == CHUNK_SIZE, "Can only summarize real series of regular chunks");
+        jw_util::Thread::assert_main_thread();
 
-        assert(getDependencyStack().size() >= depStackSize);
-        while (getDependencyStack().size() > depStackSize) {
-            getDependencyStack().back()->removeDependent(chunk);
-            getDependencyStack().pop_back();
+        if (!summaries) {
+            summaries = new SummaryPyramid<ElementType>();
         }
+        return *summaries;
+    }
 
-        SPDLOG_DEBUG("Nullify {}", static_cast<void *>(chunks[chunkIndex]));
-        chunks[chunkIndex] = nullptr;
+    void summarizeChunk(const ChunkBase *chunk) override {
+        if constexpr (std::is_floating_point_v<ElementType> && size == CHUNK_SIZE) {
+            if (SummaryPyramid<ElementType> *dst = summaries) {
+                dst->addChunk(chunk->getIndex(), static_cast<const Chunk<ElementType, size> *>(chunk)->getData());
+            }
+        }
     }
 
 #if ENABLE_CHUNK_DEBUG
@@ -103,9 +201,10 @@ public:
             }
             dst << meta.name << " from " << meta.trace;
         }
-        dst << std::endl << "  ";
+        dst << std::endl << "  " << slotsBegin << ' ';
 
-        for (const Chunk<ElementType, size> *chunk : chunks) {
+        for (const Slot &slot : slots) {
+            const Chunk<ElementType, size> *chunk = slot.chunk;
             if (!chunk) {
                 dst << '.';
             } else if (chunk->getGcRegistration().isEnqueued()) {
@@ -121,35 +220,192 @@ public:
 
     virtual Chunk<ElementType, size> *makeChunk(std::size_t chunkIndex) = 0;
 
-    const std::vector<Chunk<ElementType, size> *> &getChunks() const {
-        return chunks;
-    }
-
 protected:
     template <typename ComputerType>
     Chunk<ElementType, size> *constructChunk(ComputerType &&computer) {
-        if (dryConstruct) {
-            return nullptr;
+        if (std::uint64_t key = getPersistentCacheKey()) {
+            // Write the chunk to the cache as soon as it's complete, from whichever thread completes it
+            auto persistingComputer = [computer = std::move(computer), key, chunkIndex = constructIndex](ElementType *dst, unsigned int computedCount) mutable -> unsigned int {
+                unsigned int count = computer(dst, computedCount);
+                if (count == size) {
+                    ChunkCache::write(key, chunkIndex, dst, sizeof(ElementType) * size);
+                }
+                return count;
+            };
+            return new ChunkImpl<ElementType, size, decltype(persistingComputer)>(this, constructIndex, std::move(persistingComputer));
         } else {
-            return new ChunkImpl<ElementType, size, ComputerType>(this, std::move(computer));
+            return new ChunkImpl<ElementType, size, ComputerType>(this, constructIndex, std::move(computer));
+        }
+    }
+
+    // Input series get their data pushed in, so they can't be served from the cache
+    virtual bool isCacheable() const {
+        return true;
+    }
+
+    // Input series can't recompute a chunk once it's freed, so it always goes to the spill file if there is one
+    virtual bool canRecompute() const {
+        return true;
+    }
+
+    // Chunks behind every consumer's horizon, see DataSeriesBase::getHorizon()
+    virtual bool isRetired(std::size_t chunkIndex) const {
+        (void) chunkIndex;
+        return false;
+    }
+
+    void retireChunk(std::size_t chunkIndex) {
+        assert(isRetired(chunkIndex));
+        if (Slot *slot = findSlot(chunkIndex); slot && slot->chunk) {
+            slot->chunk->retire();
         }
     }
 
 private:
-//    std::uint64_t offset = 0;
-    std::vector<Chunk<ElementType, size> *> chunks;
-
-    std::size_t locateChunk(const ChunkBase *chunk) {
-        // Search backwards because it's more likely that we're searching for a recent chunk.
-        std::size_t idx = chunks.size();
-        while (true) {
-            idx--;
-            if (chunks[idx] == chunk) {
-                return idx;
+    struct SpillEntry {
+        bool isSpilled = false;
+        std::size_t slot;
+    };
+
+    struct CompressedEntry {
+        std::shared_ptr<const std::vector<std::uint64_t>> data;
+        CompressedChunks::Handle handle;
+    };
+
+    struct Slot {
+        Chunk<ElementType, size> *chunk = nullptr;
+        SpillEntry spill;
+        CompressedEntry compressed;
+    };
+
+    // Slot i is for chunk slotsBegin + i.
+    // Empty slots at the front get trimmed, so a stream that runs forever only keeps the window it still has chunks in.
+    std::deque<Slot> slots;
+    std::size_t slotsBegin = 0;
+
+    std::unique_ptr<SpillFile> spillFile;
+
+#if ENABLE_CHUNK_MULTITHREADING
+    std::atomic<SummaryPyramid<ElementType> *> summaries = nullptr;
+#else
+    SummaryPyramid<ElementType> *summaries = nullptr;
+#endif
+
+    // The chunk makeChunk() is currently building, for constructChunk()
+    std::size_t constructIndex = 0;
+
+#if ENABLE_BOUNDED_RETENTION
+    // The newest chunks of a series with carry, back to its horizon
+    std::deque<std::pair<std::size_t, ChunkPtr<ElementType, size>>> pinnedChunks;
+
+    void pinChunk(std::size_t chunkIndex) {
+        std::size_t horizon = getHorizon();
+        if (horizon == unboundedLookback) {
+            // Whoever reads that far back keeps chunks alive through the GC's usual rules
+            pinnedChunks.clear();
+            return;
+        }
+        if (!pinnedChunks.empty() && chunkIndex <= pinnedChunks.back().first) {
+            return;
+        }
+
+        pinnedChunks.emplace_back(chunkIndex, ChunkPtr<ElementType, size>::construct(findSlot(chunkIndex)->chunk));
+
+        std::size_t numPinned = horizon / size + 2;
+        while (pinnedChunks.front().first + numPinned <= chunkIndex) {
+            pinnedChunks.pop_front();
+        }
+    }
+#endif
+
+    std::uint64_t getPersistentCacheKey() const {
+        return ChunkCache::isEnabled() && isCacheable() ? getCacheKey() : 0;
+    }
+
+    template <typename ReaderType>
+    Chunk<ElementType, size> *restoreChunk(std::size_t chunkIndex, ReaderType &&reader) {
+        // Skips constructChunk(), since there's no point writing it back to the cache
+        auto computer = [reader = std::move(reader)](ElementType *dst, unsigned int computedCount) -> unsigned int {
+            reader(dst);
+            return size;
+        };
+        return new ChunkImpl<ElementType, size, decltype(computer)>(this, chunkIndex, std::move(computer));
+    }
+
+    // Keeps the chunk encoded in memory if it's small enough that way, and decoding it beats recomputing it
+    bool compressChunk(const Chunk<ElementType, size> *chunk) {
+        if constexpr (std::is_floating_point_v<ElementType>) {
+            std::size_t chunkIndex = chunk->getIndex();
+            if (!CompressedChunks::isEnabled() || isRetired(chunkIndex)) {
+                return false;
+            }
+            if (canRecompute() && getAvgRunDuration() * size <= ChunkCodec<ElementType>::estimateDecodeDuration(size)) {
+                return false;
             }
 
-            // If this fails, the chunk doesn't exist here
-            assert(idx > 0);
+            // Anything that doesn't at least halve is better off on disk or recomputed
+            std::size_t maxBytes = std::min(sizeof(ElementType) * size / 2, CompressedChunks::getCapacity());
+            std::vector<std::uint64_t> data;
+            if (!ChunkCodec<ElementType>::encode(chunk->getData(), size, maxBytes / sizeof(std::uint64_t), data)) {
+                return false;
+            }
+            data.shrink_to_fit();
+
+            // Adding might drop older chunks of this series and trim the slots, so look up the slot after
+            CompressedChunks::Handle handle = context.get<CompressedChunks>().add(this, chunkIndex, data.size() * sizeof(std::uint64_t));
+            CompressedEntry &entry = getSlot(chunkIndex).compressed;
+            assert(!entry.data);
+            entry.data = std::make_shared<const std::vector<std::uint64_t>>(std::move(data));
+            entry.handle = handle;
+            return true;
+        } else {
+            (void) chunk;
+            return false;
+        }
+    }
+
+    // The chunk is about to be live again, so the encoded copy only lives on in its computer until that runs
+    Chunk<ElementType, size> *restoreCompressed(std::size_t chunkIndex) {
+        CompressedEntry &entry = getSlot(chunkIndex).compressed;
+        std::shared_ptr<const std::vector<std::uint64_t>> data = std::move(entry.data);
+        entry.data.reset();
+        context.get<CompressedChunks>().remove(entry.handle);
+
+        if constexpr (std::is_floating_point_v<ElementType>) {
+            return restoreChunk(chunkIndex, [data = std::move(data)](ElementType *dst) {
+                ChunkCodec<ElementType>::decode(*data, dst, size);
+            });
+        } else {
+            assert(false);
+            return nullptr;
+        }
+    }
+
+    Slot &getSlot(std::size_t chunkIndex) {
+        if (slots.empty()) {
+            slotsBegin = chunkIndex;
+        }
+        while (chunkIndex < slotsBegin) {
+            slots.emplace_front();
+            slotsBegin--;
+        }
+        while (slots.size() <= chunkIndex - slotsBegin) {
+            slots.emplace_back();
+        }
+        return slots[chunkIndex - slotsBegin];
+    }
+
+    Slot *findSlot(std::size_t chunkIndex) {
+        if (chunkIndex < slotsBegin || chunkIndex - slotsBegin >= slots.size()) {
+            return nullptr;
+        }
+        return &slots[chunkIndex - slotsBegin];
+    }
+
+    void trimSlots() {
+        while (!slots.empty() && !slots.front().chunk && !slots.front().spill.isSpilled && !slots.front().compressed.data) {
+            slots.pop_front();
+            slotsBegin++;
         }
     }
 };
@@ -1,12 +1,18 @@
 #include "dataseriesbase.h"
 
 #include <atomic>
+#include <algorithm>
 
 #include "jw_util/thread.h"
 
 #include "app/tickercontext.h"
 #include "program/programmanager.h"
 
+#if ENABLE_CHUNK_MULTITHREADING
+#include "util/taskscheduler.h"
+#include "series/chunkbase.h"
+#endif
+
 namespace {
 
 template <typename ValueType, typename OpType>
@@ -20,15 +26,44 @@ static ValueType atomicApply(std::atomic<ValueType> &atom, OpType op) {
 
 namespace series {
 
-thread_local std::vector<ChunkBase *> DataSeriesBase::dependencyStack;
+#if ENABLE_CHUNK_MULTITHREADING
+std::recursive_mutex DataSeriesBase::GraphLock::mutex;
+thread_local unsigned int DataSeriesBase::GraphLock::depth = 0;
+#endif
 
-thread_local bool DataSeriesBase::dryConstruct = false;
+DataSeriesBase::GraphLock::GraphLock() {
+#if ENABLE_CHUNK_MULTITHREADING
+    mutex.lock();
+    depth++;
+#else
+    jw_util::Thread::assert_main_thread();
+#endif
+}
+
+DataSeriesBase::GraphLock::~GraphLock() {
+#if ENABLE_CHUNK_MULTITHREADING
+    if (--depth == 0) {
+        // What's left is from top level getChunk() calls, which nothing is being made from.
+        // The DepStackResetter only clears the main thread's, so other threads' would pile up.
+        dependencyStack.clear();
+    }
+    mutex.unlock();
+#endif
+}
+
+void DataSeriesBase::GraphLock::assertHeld() {
+#if ENABLE_CHUNK_MULTITHREADING
+    assert(depth > 0);
+#else
+    jw_util::Thread::assert_main_thread();
+#endif
+}
+
+thread_local std::vector<ChunkBase *> DataSeriesBase::dependencyStack;
 
 DataSeriesBase::DataSeriesBase(app::AppContext &context, bool isTransient)
     : context(context)
-#if ENABLE_CHUNK_MULTITHREADING
     , avgRunDuration(std::chrono::duration<float>::zero())
-#endif
     , isTransient(isTransient || !context.get<program::ProgramManager>().isRunning())
 {
     class DepStackResetter : public app::TickerContext::TickableBase<DepStackResetter> {
@@ -40,11 +75,19 @@ DataSeriesBase::DataSeriesBase(app::AppContext &context, bool isTransient)
         void tick(app::TickerContext &tickerContext) {
             (void) tickerContext;
 
+            GraphLock lock;
             getDependencyStack().clear();
         }
     };
 
     context.get<DepStackResetter>();
+
+#if ENABLE_CHUNK_MULTITHREADING
+    // Make sure the workers outlive anything that might emit or free chunks during shutdown
+    context.get<util::TaskScheduler<ChunkBase>>();
+    // The GC takes the thread it's made on as the main thread, so it can't wait for the first chunk, which could be made on a worker
+    context.get<GarbageCollector<ChunkBase>>();
+#endif
     context.get<Registry>().registry.push_back(this);
 }
 
@@ -55,20 +98,75 @@ DataSeriesBase::~DataSeriesBase() {
     registry.erase(it);
 }
 
-#if ENABLE_CHUNK_MULTITHREADING
 void DataSeriesBase::recordDuration(std::chrono::duration<float> duration) {
+    static constexpr float durationSampleResponse = 0.1f;
+#if ENABLE_CHUNK_MULTITHREADING
     atomicApply(avgRunDuration, [duration](std::chrono::duration<float> ard) {
-        static constexpr float durationSampleResponse = 0.1f;
         ard *= 1.0f - durationSampleResponse;
         ard += duration * durationSampleResponse;
         return ard;
     });
+#else
+    avgRunDuration *= 1.0f - durationSampleResponse;
+    avgRunDuration += duration * durationSampleResponse;
+#endif
 }
 
 std::chrono::duration<float> DataSeriesBase::getAvgRunDuration() const {
+#if ENABLE_CHUNK_MULTITHREADING
     return avgRunDuration.load();
-}
+#else
+    return avgRunDuration;
 #endif
+}
+
+void DataSeriesBase::addReader(DataSeriesBase *reader) {
+    jw_util::Thread::assert_main_thread();
+    // Worker threads making chunks read the lookback graph through getHorizon()
+    GraphLock lock;
+
+    if (std::find(readers.cbegin(), readers.cend(), reader) == readers.cend()) {
+        readers.push_back(reader);
+        graphVersion++;
+    }
+}
+
+void DataSeriesBase::addSink(std::size_t lookback) {
+    jw_util::Thread::assert_main_thread();
+    GraphLock lock;
+
+    if (!hasSink || lookback > sinkLookback) {
+        hasSink = true;
+        sinkLookback = lookback;
+        graphVersion++;
+    }
+}
+
+std::size_t DataSeriesBase::getHorizon() {
+    GraphLock::assertHeld();
+
+    if (horizonVersion == graphVersion) {
+        return horizon;
+    }
+
+    auto addLookbacks = [](std::size_t a, std::size_t b) {
+        return a > unboundedLookback - b ? unboundedLookback : a + b;
+    };
+
+    std::size_t res = hasSink ? sinkLookback : 0;
+    for (DataSeriesBase *reader : readers) {
+        std::size_t readerHorizon = reader->getHorizon();
+        if (reader->hasCarry() && readerHorizon != unboundedLookback) {
+            // The reader pins its own chunks back to its horizon, so it only ever reads us to compute new chunks
+            readerHorizon = 0;
+        }
+        res = std::max(res, addLookbacks(reader->getLookback(*this), readerHorizon));
+    }
+
+    horizon = res;
+    horizonVersion = graphVersion;
+    return horizon;
+}
 
 #if ENABLE_CHUNK_DEBUG
 void DataSeriesBase::addMeta(const std::string &name, const std::string &trace) {
@@ -83,7 +181,7 @@ void DataSeriesBase::addMeta(const std::string &name, const std::string &trace)
 #endif
 
 std::vector<ChunkBase *> &DataSeriesBase::getDependencyStack() {
-    jw_util::Thread::assert_main_thread();
+    GraphLock::assertHeld();
 
     return dependencyStack;
 }
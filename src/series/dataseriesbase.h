@@ -4,9 +4,11 @@
 #include "defs/ENABLE_CHUNK_DEBUG.h"
 
 #include <vector>
-#if ENABLE_CHUNK_MULTITHREADING
 #include <chrono>
+#include <cstdint>
+#if ENABLE_CHUNK_MULTITHREADING
 #include <atomic>
+#include <mutex>
 #endif
 #if ENABLE_CHUNK_DEBUG
 #include <string>
@@ -26,6 +28,27 @@ public:
         std::vector<DataSeriesBase *> registry;
     };
 
+    // Held while the chunk graph changes: chunks being made in getChunk(), linked to their dependencies, or freed by the GC.
+    // That lets worker threads call getChunk() too. Running and notifying chunks that are already linked never takes it.
+    // It's recursive, since making a chunk gets the chunks it reads and might run the GC.
+    // Threads outside the TaskScheduler also take it to drop chunk refs, see ChunkBase::decRefs().
+    class GraphLock {
+    public:
+        GraphLock();
+        ~GraphLock();
+
+        GraphLock(GraphLock const&) = delete;
+        GraphLock& operator=(GraphLock const&) = delete;
+
+        static void assertHeld();
+
+    private:
+#if ENABLE_CHUNK_MULTITHREADING
+        static std::recursive_mutex mutex;
+        static thread_local unsigned int depth;
+#endif
+    };
+
     DataSeriesBase(app::AppContext &context, bool isTransient);
     virtual ~DataSeriesBase();
 
@@ -36,10 +59,9 @@ public:
         return context;
     }
 
-#if ENABLE_CHUNK_MULTITHREADING
+    // Average compute time per element
     void recordDuration(std::chrono::duration<float> duration);
     std::chrono::duration<float> getAvgRunDuration() const;
-#endif
 
 #if ENABLE_CHUNK_DEBUG
     struct Meta {
@@ -58,10 +80,64 @@ public:
 
     virtual void releaseChunk(const ChunkBase *chunk) = 0;
 
+    // Called by the GC right before it frees a chunk
+    virtual void spillChunk(const ChunkBase *chunk) = 0;
+
+    // Called by CompressedChunks when it needs room for newer chunks
+    virtual void dropCompressedChunk(std::size_t chunkIndex) = 0;
+
+    // Called once a chunk is complete, from whichever thread completed it
+    virtual void summarizeChunk(const ChunkBase *chunk) = 0;
+
     bool getIsTransient() const {
         return isTransient;
     }
 
+    // Number of distinct program calls that read this series
+    void addConsumer() {
+        numConsumers++;
+    }
+    std::size_t getNumConsumers() const {
+        return numConsumers;
+    }
+
+    static constexpr std::size_t unboundedLookback = static_cast<std::size_t>(-1);
+
+    // How many elements before an index this series reads from the given operand to compute it.
+    // unboundedLookback if it reads fixed positions instead, like a conv kernel.
+    virtual std::size_t getLookback(const DataSeriesBase &operand) const {
+        (void) operand;
+        return 0;
+    }
+
+    // Whether each chunk continues from the previous one, like a scan.
+    // Recomputing an old chunk of such a series would go all the way back to the start, so the chunks within its horizon are pinned instead.
+    virtual bool hasCarry() const {
+        return false;
+    }
+
+    // The lookback graph, recorded by the Resolver. Readers are series computed from this one, sinks are emitters, renderers and the like.
+    void addReader(DataSeriesBase *reader);
+    void addSink(std::size_t lookback);
+
+    // How far behind the newest element any consumer might still read this series, see addReader().
+    // Chunks older than that can be retired once they're complete.
+    std::size_t getHorizon();
+
+    // Elements before this were dropped for good and read as NaN, like old input that was retired without a spill file.
+    // Nonzero only once something has actually asked for them.
+    virtual std::size_t getLostEnd() const {
+        return 0;
+    }
+
+    // Stable across runs, see ChunkCache. 0 means chunks of this series can't be cached.
+    void setCacheKey(std::uint64_t key) {
+        cacheKey = key;
+    }
+    std::uint64_t getCacheKey() const {
+        return cacheKey;
+    }
+
 protected:
     app::AppContext &context;
 
@@ -71,14 +147,25 @@ protected:
     std::vector<Meta> metas;
 #endif
 
-    static thread_local bool dryConstruct;
-
 private:
 #if ENABLE_CHUNK_MULTITHREADING
     std::atomic<std::chrono::duration<float>> avgRunDuration;
+#else
+    std::chrono::duration<float> avgRunDuration;
 #endif
 
     bool isTransient;
+    std::size_t numConsumers = 0;
+    std::uint64_t cacheKey = 0;
+
+    std::vector<DataSeriesBase *> readers;
+    std::size_t sinkLookback = 0;
+    bool hasSink = false;
+
+    // Horizons are cached until the graph changes
+    static inline std::size_t graphVersion = 1;
+    std::size_t horizonVersion = 0;
+    std::size_t horizon = 0;
 
     static thread_local std::vector<ChunkBase *> dependencyStack;
 };
@@ -17,6 +17,7 @@
 
 #include "series/chunksize.h"
 
+#include "defs/CONV_BANK_BATCH_SIZE.h"
 #include "defs/FFTWX_PLANNING_LEVEL.h"
 
 namespace {
@@ -48,6 +49,7 @@ template<> struct fftwx_impl<float> {
 
     static Plan plan_dft_r2c_1d(std::size_t size, float *in, Complex *out, unsigned flags) { return fftwf_plan_dft_r2c_1d(size, in, reinterpret_cast<fftwf_complex *>(out), flags); }
     static Plan plan_dft_c2r_1d(std::size_t size, Complex *in, float *out, unsigned flags) { return fftwf_plan_dft_c2r_1d(size, reinterpret_cast<fftwf_complex *>(in), out, flags); }
+    static Plan plan_many_dft_c2r(int size, int howmany, Complex *in, int idist, float *out, int odist, unsigned flags) { return fftwf_plan_many_dft_c2r(1, &size, howmany, reinterpret_cast<fftwf_complex *>(in), nullptr, 1, idist, out, nullptr, 1, odist, flags); }
 
     static void execute(Plan plan) { fftwf_execute(plan); }
     static void execute_dft_r2c(Plan plan, float *in, Complex *out) { fftwf_execute_dft_r2c(plan, in, reinterpret_cast<fftwf_complex *>(out)); }
@@ -71,6 +73,7 @@ template<> struct fftwx_impl<double> {
 
     static Plan plan_dft_r2c_1d(std::size_t size, double *in, Complex *out, unsigned flags) { return fftw_plan_dft_r2c_1d(size, in, reinterpret_cast<fftw_complex *>(out), flags); }
     static Plan plan_dft_c2r_1d(std::size_t size, Complex *in, double *out, unsigned flags) { return fftw_plan_dft_c2r_1d(size, reinterpret_cast<fftw_complex *>(in), out, flags); }
+    static Plan plan_many_dft_c2r(int size, int howmany, Complex *in, int idist, double *out, int odist, unsigned flags) { return fftw_plan_many_dft_c2r(1, &size, howmany, reinterpret_cast<fftw_complex *>(in), nullptr, 1, idist, out, nullptr, 1, odist, flags); }
 
     static void execute(Plan plan) { fftw_execute(plan); }
     static void execute_dft_r2c(Plan plan, double *in, Complex *out) { fftw_execute_dft_r2c(plan, in, reinterpret_cast<fftw_complex *>(out)); }
@@ -137,6 +140,16 @@ public:
         return planBwds[planIndex];
     }
 
+    // Spectra in a batch are this far apart, so each one keeps the alignment the plans were made with
+    static constexpr std::size_t batchSpectrumStride = CHUNK_SIZE + 8;
+
+    // Runs CONV_BANK_BATCH_SIZE backward ffts of size CHUNK_SIZE * 2 at once, reading spectra batchSpectrumStride apart and writing outputs CHUNK_SIZE * 2 apart.
+    // Null if batching is disabled, or if the plan isn't in the wisdom and we weren't allowed to generate it.
+    static typename fftwx::Plan getPlanBwdBatch() {
+        assert(isInit);
+        return planBwdBatch;
+    }
+
 #ifndef NDEBUG
     static bool &doesThreadHaveOutstandingRequest() {
         static thread_local bool has = false;
@@ -231,13 +244,15 @@ public:
 
         IO io = request();
 
-        auto tryCreatePlan = [](unsigned int sizeLog2, auto creatorFunc, const std::string &name) -> typename fftwx::Plan {
+        auto tryCreatePlan = [](unsigned int sizeLog2, auto creatorFunc, const std::string &name, bool required = true) -> typename fftwx::Plan {
             static constexpr unsigned int baseFlags = FFTWX_PLANNING_LEVEL | FFTW_DESTROY_INPUT;
 
             typename fftwx::Plan res = creatorFunc(1u << sizeLog2, baseFlags | FFTW_WISDOM_ONLY);
 
             if (res) {
                 SPDLOG_INFO("{}::init() - Loaded {}", tn, name);
+            } else if (!required && app::Options::getInstance().requireExistingWisdom) {
+                SPDLOG_WARN("{}::init() - Wisdom file at {} does not include plan for {}; going without it", tn, filename, name);
             } else {
                 if (app::Options::getInstance().requireExistingWisdom) {
                     throw FftwMissingWisdomException("Wisdom file at " + filename + " does not include plan for " + name);
@@ -275,6 +290,15 @@ public:
             planBwds[i] = tryCreatePlan(i, bwdCreator, "backward fft of size 2^" + std::to_string(i));
         }
 
+#if CONV_BANK_BATCH_SIZE > 1
+        ElementType *batchReal = fftwx::alloc_real(CHUNK_SIZE * 2 * CONV_BANK_BATCH_SIZE);
+        typename fftwx::Complex *batchComplex = fftwx::alloc_complex(batchSpectrumStride * CONV_BANK_BATCH_SIZE);
+        auto bwdBatchCreator = [batchReal, batchComplex](unsigned int size, unsigned int flags) { return fftwx::plan_many_dft_c2r(size, CONV_BANK_BATCH_SIZE, batchComplex, batchSpectrumStride, batchReal, size, flags); };
+        planBwdBatch = tryCreatePlan(CHUNK_SIZE_LOG2 + 1, bwdBatchCreator, std::to_string(CONV_BANK_BATCH_SIZE) + " batched backward ffts of size 2^" + std::to_string(CHUNK_SIZE_LOG2 + 1), false);
+        fftwx::free(batchReal);
+        fftwx::free(batchComplex);
+#endif
+
         release(io);
     }
 
@@ -292,6 +316,10 @@ public:
         for (typename fftwx::Plan plan : planBwds) {
             fftwx::destroy_plan(plan);
         }
+        if (planBwdBatch) {
+            fftwx::destroy_plan(planBwdBatch);
+            planBwdBatch = nullptr;
+        }
 
         /*
         for (IO io : IOs) {
@@ -310,6 +338,7 @@ private:
 //    inline static unsigned int createdIOs = 0;
     inline static std::array<typename fftwx::Plan, CHUNK_SIZE_LOG2 + 2> planFwds;
     inline static std::array<typename fftwx::Plan, CHUNK_SIZE_LOG2 + 2> planBwds;
+    inline static typename fftwx::Plan planBwdBatch = nullptr;
 };
 
 }
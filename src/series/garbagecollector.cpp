@@ -3,12 +3,23 @@
 #include "util/testrunner.h"
 #include "log.h"
 
+#include "defs/ENABLE_CHUNK_MULTITHREADING.h"
+
+#if ENABLE_CHUNK_MULTITHREADING
+#include <functional>
+#include <thread>
+#include "series/dataseries.h"
+#include "series/type/compseries.h"
+#include "util/taskscheduler.h"
+#endif
+
 class Obj {
 public:
-    Obj(app::AppContext &context, unsigned int &extantMask, unsigned int myMask)
+    Obj(app::AppContext &context, unsigned int &extantMask, unsigned int myMask, float cost = 0.0f)
         : context(context)
         , extantMask(extantMask)
         , myMask(myMask)
+        , cost(cost)
     {
         assert((extantMask & myMask) == 0);
         extantMask |= myMask;
@@ -28,6 +39,14 @@ public:
         return gcReg;
     }
 
+    bool canFree() const {
+        return true;
+    }
+
+    float getGcCost() const {
+        return cost;
+    }
+
 private:
     app::AppContext &context;
 
@@ -35,10 +54,11 @@ private:
 
     unsigned int &extantMask;
     unsigned int myMask;
+    float cost;
 };
 
 static int _ = util::TestRunner::getInstance().registerTest([](app::AppContext &context) {
-    if constexpr (GARBAGE_COLLECTOR_LEVELS == 1) {
+    {
         std::size_t origGcMemoryLimit = app::Options::getMutableInstance().gcMemoryLimit;
         app::Options::getMutableInstance().gcMemoryLimit = 10;
 
@@ -139,7 +159,105 @@ static int _ = util::TestRunner::getInstance().registerTest([](app::AppContext &
         context.get<series::GarbageCollector<Obj>>().assertSequence(0, {});
 
         app::Options::getMutableInstance().gcMemoryLimit = origGcMemoryLimit;
-    } else {
-        SPDLOG_WARN("Skipping GarbageCollector test because GARBAGE_COLLECTOR_LEVELS is not 1, making things non-deterministic");
     }
+
+    if constexpr (GARBAGE_COLLECTOR_LEVELS > 1) {
+        std::size_t origGcMemoryLimit = app::Options::getMutableInstance().gcMemoryLimit;
+        app::Options::getMutableInstance().gcMemoryLimit = 10;
+
+        unsigned int extantMask = 0;
+        Obj *obj0 = new Obj(context, extantMask, 1 << 0, 1e-6f);
+        Obj *obj1 = new Obj(context, extantMask, 1 << 1, 1e-6f);
+        Obj *obj2 = new Obj(context, extantMask, 1 << 2);
+
+        SPDLOG_DEBUG("Check cheap objects go first, even if they're more recent");
+        context.get<series::GarbageCollector<Obj>>().enqueue(obj0);
+        context.get<series::GarbageCollector<Obj>>().enqueue(obj1);
+        context.get<series::GarbageCollector<Obj>>().enqueue(obj2);
+        app::Options::getMutableInstance().gcMemoryLimit = 2;
+        context.get<series::GarbageCollector<Obj>>().runGc();
+        assert(extantMask == 0b011);
+
+        SPDLOG_DEBUG("Check objects of the same cost go in LRU order");
+        context.get<series::GarbageCollector<Obj>>().enqueue(obj0);
+        app::Options::getMutableInstance().gcMemoryLimit = 1;
+        context.get<series::GarbageCollector<Obj>>().runGc();
+        assert(extantMask == 0b001);
+
+        app::Options::getMutableInstance().gcMemoryLimit = 0;
+        context.get<series::GarbageCollector<Obj>>().runGc();
+        assert(extantMask == 0b000);
+
+        app::Options::getMutableInstance().gcMemoryLimit = origGcMemoryLimit;
+    }
+});
+
+#if ENABLE_CHUNK_MULTITHREADING
+namespace {
+
+// Reads another series, so making its chunks links dependents too
+class OffsetSeries : public series::DataSeries<double> {
+public:
+    OffsetSeries(app::AppContext &context, series::DataSeries<double> &arg)
+        : series::DataSeries<double>(context)
+        , arg(arg)
+    {}
+
+    series::Chunk<double> *makeChunk(std::size_t chunkIndex) override {
+        series::ChunkPtr<double> chunk = arg.getChunk(chunkIndex);
+        return this->constructChunk([chunk = std::move(chunk)](double *dst, unsigned int computedCount) -> unsigned int {
+            unsigned int count = chunk->getComputedCount();
+            for (unsigned int i = computedCount; i < count; i++) {
+                dst[i] = chunk->getElement(i) + 1.0;
+            }
+            return count;
+        });
+    }
+
+private:
+    series::DataSeries<double> &arg;
+};
+
+void readChunks(OffsetSeries &series, std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; i++) {
+        series::ChunkPtr<double> chunk = series.getChunk(i);
+        while (chunk->getComputedCount() < CHUNK_SIZE) {
+            // Slow enough chunks go to the workers
+            std::this_thread::yield();
+        }
+        assert(chunk->getElement(CHUNK_SIZE - 1) == static_cast<double>((i + 1) * CHUNK_SIZE));
+    }
+}
+
+}
+
+// Another thread makes chunks while the main thread makes its own and the GC frees everything it can
+static int _graph = util::TestRunner::getInstance().registerTest([](app::AppContext &context) {
+    std::size_t origGcMemoryLimit = app::Options::getMutableInstance().gcMemoryLimit;
+    bool origCompressEvicted = app::Options::getMutableInstance().compressEvicted;
+    app::Options::getMutableInstance().gcMemoryLimit = 0;
+    // So evicting really frees everything
+    app::Options::getMutableInstance().compressEvicted = false;
+
+    auto index = [](std::uint64_t i) {
+        return static_cast<double>(i);
+    };
+    series::CompSeries<double, decltype(index)> source(context, index);
+    OffsetSeries offset(context, source);
+
+    std::thread other(readChunks, std::ref(offset), 0, 256);
+    for (std::size_t i = 0; i < 256; i += 16) {
+        readChunks(offset, 256 + i, 256 + i + 16);
+        context.get<series::GarbageCollector<series::ChunkBase>>().runGc();
+    }
+    other.join();
+
+    // Nothing can outlive the series
+    context.get<util::TaskScheduler<series::ChunkBase>>().waitIdle();
+    context.get<series::GarbageCollector<series::ChunkBase>>().runGc();
+    assert(context.get<series::GarbageCollector<series::ChunkBase>>().getMemoryUsage() == 0);
+
+    app::Options::getMutableInstance().gcMemoryLimit = origGcMemoryLimit;
+    app::Options::getMutableInstance().compressEvicted = origCompressEvicted;
 });
+#endif
@@ -4,8 +4,27 @@
 #include "app/tickercontext.h"
 #include "app/options.h"
 #include "jw_util/thread.h"
+#include "series/dataseriesbase.h"
 
 #include "defs/GARBAGE_COLLECTOR_LEVELS.h"
+#include "defs/ENABLE_CHUNK_MULTITHREADING.h"
+
+#include <type_traits>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <ostream>
+
+#if ENABLE_CHUNK_MULTITHREADING
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include "util/spinlock.h"
+#include "util/taskscheduler.h"
+#endif
+
+namespace series { class ChunkBase; }
 
 namespace series {
 
@@ -26,10 +45,22 @@ public:
     private:
         ObjectType *freeAfter = nullptr;
         ObjectType *freeBefore = nullptr;
+
+        // Snapshotted when enqueued, since the cost estimate keeps moving and dequeue() has to find the same level
+        float cost;
+        std::uint64_t enqueuedAt;
+        unsigned int level;
     };
 
+    // Objects are sorted into levels by how expensive they are to recompute, and each level is LRU ordered.
+    // The GC then only has to compare the oldest object of each level to find the one least worth keeping.
     struct Level {
         ObjectType *freeNext = nullptr;
+
+        std::size_t numEnqueued = 0;
+        std::size_t numEvicted = 0;
+        std::size_t evictedBytes = 0;
+        float evictedCost = 0.0f;
     };
 
     GarbageCollector(app::AppContext &context)
@@ -41,6 +72,14 @@ public:
     }
 
     void updateMemoryUsage(std::make_signed<std::size_t>::type inc) {
+#if ENABLE_CHUNK_MULTITHREADING
+        if (std::this_thread::get_id() != mainThreadId) {
+            // From worker threads making chunks, or finishing ones that let go of memory, like a MultiChannelSeries block.
+            // It's counted the next time the GC runs, which only ever happens on the main thread.
+            deferredMemoryUsage.fetch_add(inc, std::memory_order_relaxed);
+            return;
+        }
+#endif
         jw_util::Thread::assert_main_thread();
 
         memoryUsage += inc;
@@ -55,48 +94,125 @@ public:
         return memoryUsage;
     }
 
+    // Also counts what the allocator holds on to for freed objects, see util::SlabAllocator::getFreeSize()
+    std::size_t getTotalMemoryUsage() const {
+        if constexpr (std::is_same<ObjectType, ChunkBase>::value) {
+            return memoryUsage + ObjectType::getUnusedAllocationSize();
+        } else {
+            return memoryUsage;
+        }
+    }
+
     void runGc() {
         jw_util::Thread::assert_main_thread();
 
+        if (isRunning) {
+            // Freeing a chunk can charge memory for what it leaves behind, see CompressedChunks, and the loop below already covers that
+            return;
+        }
+
+        // Worker threads can't be making chunks while this frees them.
+        // They can still be running them and walking dependents lists, which is what claimForFree() and the retired allocations are for.
+        DataSeriesBase::GraphLock lock;
+
         std::size_t memoryLimit = app::Options::getInstance().gcMemoryLimit;
-        SPDLOG_DEBUG("Running GC; memory usage is {} / {}", memoryUsage, memoryLimit);
-        while (memoryUsage > memoryLimit) {
-            unsigned int i = 0;
-            while (true) {
-                ObjectType *next = levels[i].freeNext;
-                if (next) {
-                    delete next;
-                    assert(levels[i].freeNext != next);
-                    break;
+        SPDLOG_DEBUG("Running GC; memory usage is {} ({} with freed memory) / {}", memoryUsage, getTotalMemoryUsage(), memoryLimit);
+
+#if ENABLE_CHUNK_MULTITHREADING
+        memoryUsage += deferredMemoryUsage.exchange(0, std::memory_order_relaxed);
+        applyDeferred();
+#endif
+
+        isRunning = true;
+        std::size_t prevTotalMemoryUsage = static_cast<std::size_t>(-1);
+        while (true) {
+            // Freed memory the allocator kept around goes back first, so eviction only makes up the rest
+            std::size_t totalMemoryUsage = trimUnused(memoryLimit);
+            if (totalMemoryUsage <= memoryLimit || totalMemoryUsage >= prevTotalMemoryUsage) {
+                // Blocks too small to hand pages back stay until their whole slab is free, so evicting more of those wouldn't get anywhere
+                break;
+            }
+            prevTotalMemoryUsage = totalMemoryUsage;
+
+            // Recompute cost per byte, discounted by how long ago it was last used
+            Level *victimLevel = nullptr;
+            float victimValue = INFINITY;
+            for (Level &level : levels) {
+                if (level.freeNext) {
+                    const Registration &reg = level.freeNext->getGcRegistration();
+                    float value = reg.cost / static_cast<float>(enqueueClock - reg.enqueuedAt);
+                    if (!victimLevel || value < victimValue) {
+                        victimLevel = &level;
+                        victimValue = value;
+                    }
                 }
+            }
+            if (!victimLevel) {
+                break;
+            }
 
-                if (++i == GARBAGE_COLLECTOR_LEVELS) {
-                    return;
+            ObjectType *next = victimLevel->freeNext;
+#if ENABLE_CHUNK_MULTITHREADING
+            if constexpr (std::is_same<ObjectType, ChunkBase>::value) {
+                if (!next->claimForFree()) {
+                    // A worker thread took a ref since it was enqueued, and parked a dequeue that would do the same.
+                    // Nothing was freed, so don't let the check above stop the loop.
+                    unlink(next);
+                    prevTotalMemoryUsage = static_cast<std::size_t>(-1);
+                    continue;
                 }
             }
+#endif
+
+            float cost = next->getGcRegistration().cost;
+            std::size_t prevMemoryUsage = memoryUsage;
+
+            if constexpr (std::is_same<ObjectType, ChunkBase>::value) {
+                next->spill();
+            }
+            delete next;
+            assert(victimLevel->freeNext != next);
+
+            std::size_t freed = prevMemoryUsage - memoryUsage;
+            victimLevel->numEvicted++;
+            victimLevel->evictedBytes += freed;
+            victimLevel->evictedCost += cost * freed;
+        }
+        isRunning = false;
+
+#if ENABLE_CHUNK_MULTITHREADING
+        // Retired memory already counts as freed, though it only goes back once every worker is past the task it was on when it was retired.
+        // That's usually by the next run, so it doesn't pile up.
+        if constexpr (std::is_same<ObjectType, ChunkBase>::value) {
+            std::size_t numBatches = ObjectType::sealRetiredAllocations(this->context.template get<util::TaskScheduler<ChunkBase>>());
+            if (numBatches) {
+                // The workers are past these now, but might have parked some of them on the way
+                applyDeferred();
+                ObjectType::freeRetiredAllocations(numBatches);
+            }
         }
+#endif
     }
 
     void enqueue(ObjectType *obj) {
+#if ENABLE_CHUNK_MULTITHREADING
+        if (defer(obj)) {
+            return;
+        }
+#endif
         jw_util::Thread::assert_main_thread();
 
-        Level &level = getLevel(obj);
         Registration &reg = obj->getGcRegistration();
-
         if (reg.isEnqueued()) {
-            if (level.freeNext == obj) {
-                if (obj->getGcRegistration().freeBefore == obj) {
-                    return;
-                } else {
-                    level.freeNext = obj->getGcRegistration().freeBefore;
-                }
-            }
-
-            // Remove from linked list
-            reg.freeAfter->getGcRegistration().freeBefore = reg.freeBefore;
-            reg.freeBefore->getGcRegistration().freeAfter = reg.freeAfter;
+            unlink(obj);
         }
 
+        reg.cost = obj->getGcCost();
+        reg.enqueuedAt = enqueueClock++;
+        reg.level = calcLevel(reg.cost);
+
+        Level &level = levels[reg.level];
+        level.numEnqueued++;
         if (level.freeNext) {
             ObjectType *head = level.freeNext;
             ObjectType *tail = head->getGcRegistration().freeAfter;
@@ -112,26 +228,26 @@ public:
     }
 
     void dequeue(ObjectType *obj) {
+#if ENABLE_CHUNK_MULTITHREADING
+        if (defer(obj)) {
+            return;
+        }
+#endif
         jw_util::Thread::assert_main_thread();
 
-        Level &level = getLevel(obj);
-        Registration &reg = obj->getGcRegistration();
-
-        if (reg.isEnqueued()) {
-            if (level.freeNext == obj) {
-                if (obj->getGcRegistration().freeBefore == obj) {
-                    level.freeNext = nullptr;
-                } else {
-                    level.freeNext = obj->getGcRegistration().freeBefore;
-                }
-            }
-
-            // Remove from linked list
-            reg.freeAfter->getGcRegistration().freeBefore = reg.freeBefore;
-            reg.freeBefore->getGcRegistration().freeAfter = reg.freeAfter;
+        if (obj->getGcRegistration().isEnqueued()) {
+            unlink(obj);
+        }
+    }
 
-            reg.freeAfter = nullptr;
-            reg.freeBefore = nullptr;
+    void writeStats(std::ostream &dst) const {
+        for (unsigned int i = 0; i < GARBAGE_COLLECTOR_LEVELS; i++) {
+            const Level &level = levels[i];
+            dst << "GC level " << i << " (from " << calcLevelCost(i) << "s/b): "
+                << level.numEnqueued << " enqueued, "
+                << level.numEvicted << " evicted, "
+                << level.evictedBytes << "b freed, "
+                << level.evictedCost << "s to recompute" << std::endl;
         }
     }
 
@@ -153,17 +269,106 @@ public:
 
 private:
     std::size_t memoryUsage = 0;
+    bool isRunning = false;
+
+    // Returns the total memory usage after handing back what it can of the part over the limit
+    std::size_t trimUnused(std::size_t memoryLimit) {
+        std::size_t totalMemoryUsage = getTotalMemoryUsage();
+        if constexpr (std::is_same<ObjectType, ChunkBase>::value) {
+            if (totalMemoryUsage > memoryLimit) {
+                ObjectType::trimUnusedAllocations(totalMemoryUsage - memoryLimit);
+                totalMemoryUsage = getTotalMemoryUsage();
+            }
+        }
+        return totalMemoryUsage;
+    }
+
+#if ENABLE_CHUNK_MULTITHREADING
+    // Worker threads drop refs when chunks finish and release their computers.
+    // The linked lists belong to the main thread, so those objects are parked here and re-checked there.
+    util::SpinLock deferredLock;
+    std::vector<ObjectType *> deferred;
+    std::atomic<std::make_signed<std::size_t>::type> deferredMemoryUsage = 0;
+
+    bool defer(ObjectType *obj) {
+        if (std::this_thread::get_id() == mainThreadId) {
+            applyDeferred();
+            return false;
+        } else {
+            std::lock_guard<util::SpinLock> lock(deferredLock);
+            deferred.push_back(obj);
+            return true;
+        }
+    }
+
+    void applyDeferred() {
+        std::vector<ObjectType *> objs;
+        {
+            std::lock_guard<util::SpinLock> lock(deferredLock);
+            objs.swap(deferred);
+        }
+
+        // The refcount may have changed since the object was parked, so go by its current state.
+        // This recurses into applyDeferred(), which is fine since we've taken the whole batch.
+        for (ObjectType *obj : objs) {
+            if constexpr (std::is_same<ObjectType, ChunkBase>::value) {
+                if (obj->isClaimedForFree()) {
+                    // Dropped by a worker after the GC claimed it, and already gone or about to be
+                    continue;
+                }
+            }
+
+            if (obj->canFree()) {
+                enqueue(obj);
+            } else {
+                dequeue(obj);
+            }
+        }
+    }
+
+    std::thread::id mainThreadId = std::this_thread::get_id();
+#endif
 
     Level levels[GARBAGE_COLLECTOR_LEVELS];
 
-    Level &getLevel(const ObjectType *obj) {
-        if constexpr (GARBAGE_COLLECTOR_LEVELS == 1) {
-            return levels[0];
-        } else {
-            std::uintptr_t x = reinterpret_cast<std::uintptr_t>(obj);
-            x = (13 * x) ^ (x >> 15);
-            return levels[x % GARBAGE_COLLECTOR_LEVELS];
+    // Counts enqueues, so it starts at one to keep every object's age nonzero
+    std::uint64_t enqueueClock = 1;
+
+    // Roughly what an elementwise op costs; each level up is 4x more expensive than the last
+    static constexpr float baseLevelCost = 1e-10f;
+
+    static unsigned int calcLevel(float cost) {
+        if (!(cost > baseLevelCost)) {
+            return 0;
         }
+        int level = std::ilogb(cost / baseLevelCost) / 2;
+        return std::min(level, GARBAGE_COLLECTOR_LEVELS - 1);
+    }
+
+    static float calcLevelCost(unsigned int level) {
+        return level ? std::ldexp(baseLevelCost, 2 * level) : 0.0f;
+    }
+
+    void unlink(ObjectType *obj) {
+        Registration &reg = obj->getGcRegistration();
+        Level &level = levels[reg.level];
+
+        if (level.freeNext == obj) {
+            if (reg.freeBefore == obj) {
+                level.freeNext = nullptr;
+            } else {
+                level.freeNext = reg.freeBefore;
+            }
+        }
+
+        // Remove from linked list
+        reg.freeAfter->getGcRegistration().freeBefore = reg.freeBefore;
+        reg.freeBefore->getGcRegistration().freeAfter = reg.freeAfter;
+
+        reg.freeAfter = nullptr;
+        reg.freeBefore = nullptr;
+
+        level.numEnqueued--;
     }
 };
 
@@ -0,0 +1,83 @@
+#include "spillfile.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "log.h"
+#include "app/options.h"
+
+namespace series {
+
+SpillFile::SpillFile(std::size_t dataSize)
+    : dataSize(dataSize)
+{
+    // mmap offsets have to be page aligned
+    std::size_t pageSize = sysconf(_SC_PAGESIZE);
+    slotSize = (dataSize + pageSize - 1) / pageSize * pageSize;
+
+    std::string pathStr = app::Options::getInstance().spillDir + "/ts-viz-spill-XXXXXX";
+    std::vector<char> path(pathStr.cbegin(), pathStr.cend());
+    path.push_back('\0');
+
+    fd = mkstemp(path.data());
+    if (fd == -1) {
+        throw std::runtime_error("Couldn't create spill file " + pathStr + ": " + std::strerror(errno));
+    }
+
+    // Nobody else needs to see it, and this way it's cleaned up even if we crash
+    unlink(path.data());
+}
+
+SpillFile::~SpillFile() {
+    close(fd);
+}
+
+bool SpillFile::isEnabled() {
+    return !app::Options::getInstance().spillDir.empty();
+}
+
+std::size_t SpillFile::write(const void *src) {
+    std::size_t slot = numSlots;
+    if (ftruncate(fd, (slot + 1) * slotSize) == -1) {
+        throw std::runtime_error(std::string("Couldn't grow spill file: ") + std::strerror(errno));
+    }
+
+    void *map = mmap(nullptr, slotSize, PROT_WRITE, MAP_SHARED, fd, slot * slotSize);
+    if (map == MAP_FAILED) {
+        throw std::runtime_error(std::string("Couldn't map spill file: ") + std::strerror(errno));
+    }
+    std::memcpy(map, src, dataSize);
+    munmap(map, slotSize);
+
+    numSlots++;
+    return slot;
+}
+
+void SpillFile::read(std::size_t slot, void *dst) const {
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    void *map = mmap(nullptr, slotSize, PROT_READ, MAP_SHARED, fd, slot * slotSize);
+    if (map == MAP_FAILED) {
+        throw std::runtime_error(std::string("Couldn't map spill file: ") + std::strerror(errno));
+    }
+    std::memcpy(dst, map, dataSize);
+    munmap(map, slotSize);
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    static constexpr float durationSampleResponse = 0.1f;
+    float sample = std::chrono::duration<float>(t2 - t1).count() / dataSize;
+    float prev = readSecondsPerByte.load(std::memory_order_relaxed);
+    readSecondsPerByte.store(prev * (1.0f - durationSampleResponse) + sample * durationSampleResponse, std::memory_order_relaxed);
+}
+
+std::chrono::duration<float> SpillFile::estimateReadDuration(std::size_t size) {
+    return std::chrono::duration<float>(readSecondsPerByte.load(std::memory_order_relaxed) * size);
+}
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+
+namespace series {
+
+// An unlinked temporary file in --spill-dir holding evicted chunks of one series, one fixed-size slot per chunk.
+// Slots are written on the main thread and can be read back from any thread.
+class SpillFile {
+public:
+    SpillFile(std::size_t dataSize);
+    ~SpillFile();
+
+    SpillFile(SpillFile const&) = delete;
+    SpillFile& operator=(SpillFile const&) = delete;
+
+    static bool isEnabled();
+
+    std::size_t write(const void *src);
+    void read(std::size_t slot, void *dst) const;
+
+    // Measured from previous reads, so the spill-vs-drop decision tracks how fast the disk actually is
+    static std::chrono::duration<float> estimateReadDuration(std::size_t size);
+
+private:
+    std::size_t dataSize;
+    std::size_t slotSize;
+    int fd;
+    std::size_t numSlots = 0;
+
+    static inline std::atomic<float> readSecondsPerByte = 1e-9f;
+};
+
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <limits>
+#include <cmath>
+#include <cassert>
+
+#include "series/chunksize.h"
+
+#include "defs/SUMMARY_LEAF_SIZE_LOG2.h"
+
+namespace series {
+
+// Min, max and mean of a series over power-of-two blocks of elements, so a plot can be drawn zoomed out without touching the chunks.
+// Level 0 has a node per leaf of leafSize elements, and every level above merges pairs of nodes from the one below.
+// Chunks are only added once they're complete, after which their data never changes, so nodes get filled in but never updated.
+// Chunks can complete on worker threads, hence the mutex.
+template <typename ElementType>
+class SummaryPyramid {
+public:
+    static constexpr std::size_t leafSizeLog2 = SUMMARY_LEAF_SIZE_LOG2;
+    static constexpr std::size_t leafSize = static_cast<std::size_t>(1) << leafSizeLog2;
+    static_assert(leafSize <= CHUNK_SIZE, "Leaves can't straddle chunks");
+    static constexpr std::size_t leavesPerChunk = CHUNK_SIZE / leafSize;
+
+    struct Summary {
+        ElementType min = std::numeric_limits<ElementType>::infinity();
+        ElementType max = -std::numeric_limits<ElementType>::infinity();
+        double sum = 0.0;
+
+        // Elements that aren't NaN
+        std::size_t count = 0;
+        // Elements that have been summarized, NaN or not
+        std::size_t covered = 0;
+
+        void add(ElementType value) {
+            covered++;
+            if (!std::isnan(value)) {
+                if (value < min) { min = value; }
+                if (value > max) { max = value; }
+                sum += value;
+                count++;
+            }
+        }
+
+        void merge(const Summary &other) {
+            if (other.min < min) { min = other.min; }
+            if (other.max > max) { max = other.max; }
+            sum += other.sum;
+            count += other.count;
+            covered += other.covered;
+        }
+
+        ElementType getMean() const {
+            return count ? static_cast<ElementType>(sum / count) : NAN;
+        }
+    };
+
+    bool hasChunk(std::size_t chunkIndex) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return chunkIndex < chunksAdded.size() && chunksAdded[chunkIndex];
+    }
+
+    void addChunk(std::size_t chunkIndex, const ElementType *data) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (chunksAdded.size() <= chunkIndex) {
+            chunksAdded.resize(chunkIndex + 1);
+        }
+        if (chunksAdded[chunkIndex]) {
+            // A chunk can be computed again after it's freed, but it'd have the same data.
+            // Retired input chunks even come back as NaNs, which we don't want to overwrite the real summary with.
+            return;
+        }
+        chunksAdded[chunkIndex] = true;
+
+        std::size_t begin = chunkIndex * leavesPerChunk;
+        std::size_t end = begin + leavesPerChunk;
+
+        if (levels.empty()) {
+            levels.emplace_back();
+        }
+        if (levels[0].size() < end) {
+            levels[0].resize(end);
+        }
+        for (std::size_t i = begin; i < end; i++) {
+            Summary &leaf = levels[0][i];
+            const ElementType *leafData = data + (i - begin) * leafSize;
+            for (std::size_t j = 0; j < leafSize; j++) {
+                leaf.add(leafData[j]);
+            }
+        }
+
+        // Redo the parents of what changed, all the way up to a single root
+        for (std::size_t level = 1; levels[level - 1].size() > 1; level++) {
+            if (levels.size() == level) {
+                // Every node of a new level needs filling in
+                levels.emplace_back();
+                begin = 0;
+            } else {
+                begin >>= 1;
+            }
+            end = (end + 1) >> 1;
+
+            const std::vector<Summary> &children = levels[level - 1];
+            std::vector<Summary> &nodes = levels[level];
+            nodes.resize((children.size() + 1) >> 1);
+            for (std::size_t i = begin; i < end; i++) {
+                Summary node = children[i * 2];
+                if (i * 2 + 1 < children.size()) {
+                    node.merge(children[i * 2 + 1]);
+                }
+                nodes[i] = node;
+            }
+        }
+    }
+
+    // Merges leaves [beginLeaf, endLeaf), visiting O(log) nodes.
+    // Compare the result's covered count against the number of elements asked for to tell whether any of them are missing.
+    Summary summarize(std::size_t beginLeaf, std::size_t endLeaf) const {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        Summary res;
+        if (levels.empty()) {
+            return res;
+        }
+
+        // Past the end of the last level is nothing but uncovered nodes
+        std::size_t lo = beginLeaf;
+        std::size_t hi = std::min(endLeaf, levels[0].size());
+        for (std::size_t level = 0; lo < hi; level++) {
+            assert(level < levels.size());
+            const std::vector<Summary> &nodes = levels[level];
+            assert(hi <= nodes.size());
+
+            if (lo & 1) {
+                res.merge(nodes[lo]);
+                lo++;
+            }
+            if (hi & 1) {
+                hi--;
+                res.merge(nodes[hi]);
+            }
+            lo >>= 1;
+            hi >>= 1;
+        }
+
+        return res;
+    }
+
+private:
+    mutable std::mutex mutex;
+
+    std::vector<std::vector<Summary>> levels;
+    std::vector<bool> chunksAdded;
+};
+
+}
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <optional>
+
 #include "series/dataseries.h"
 #include "series/fftwx.h"
 #include "series/type/fftseries.h"
+#include "series/type/helper/convbank.h"
 #include "series/invalidparameterexception.h"
 #include "util/uniquetuple.h"
 
@@ -82,22 +85,37 @@ public:
         // 17 -> 2
         unsigned int numKernelChunks = (kernelSize + CHUNK_SIZE * 2 - 1) / CHUNK_SIZE;
         assert(numKernelChunks * CHUNK_SIZE >= kernelSize);
-        std::vector<std::pair<ChunkPtr<ElementType>, ChunkPtr<typename fftwx::Complex, CHUNK_SIZE * 2>>> kernelChunks;
+        std::vector<std::pair<ChunkPtr<ElementType>, ChunkPtr<typename fftwx::Complex, CHUNK_SIZE + 1>>> kernelChunks;
         kernelChunks.reserve(numKernelChunks);
         for (unsigned int i = 0; i < numKernelChunks; i++) {
             signed int ki = i;
-            kernelChunks.emplace_back(kernel.getChunk(ki), kernelFft.template getChunk<CHUNK_SIZE * 2>(ki));
+            kernelChunks.emplace_back(kernel.getChunk(ki), kernelFft.template getChunk<CHUNK_SIZE + 1>(ki));
         }
 
         // 1 -> 1
         // 2 -> 2
         unsigned int numTsChunks = std::min<unsigned int>((kernelSize + CHUNK_SIZE - 2) / CHUNK_SIZE, chunkIndex) + 1;
-        std::vector<std::pair<ChunkPtr<ElementType>, ChunkPtr<typename fftwx::Complex, CHUNK_SIZE * 2>>> tsChunks;
+        std::vector<std::pair<ChunkPtr<ElementType>, ChunkPtr<typename fftwx::Complex, CHUNK_SIZE + 1>>> tsChunks;
         tsChunks.reserve(numTsChunks);
         for (unsigned int i = 0; i < numTsChunks; i++) {
             signed int ti = chunkIndex + 1 - numTsChunks + i;
             assert(ti >= 0);
-            tsChunks.emplace_back(ts.getChunk(ti), tsFft.template getChunk<CHUNK_SIZE * 2>(ti));
+            tsChunks.emplace_back(ts.getChunk(ti), tsFft.template getChunk<CHUNK_SIZE + 1>(ti));
+        }
+
+        // Convolutions of the same ts share the work of the prior chunks, see ConvBank
+        std::optional<typename PriorBank::Ticket> priorTicket;
+        unsigned int priorLen = std::min(kernelChunks.size(), tsChunks.size()) - 1;
+        if (priorLen > 0) {
+            std::vector<typename PriorBank::SpectrumPtr> kernelSpectra;
+            std::vector<typename PriorBank::SpectrumPtr> tsSpectra;
+            kernelSpectra.reserve(priorLen);
+            tsSpectra.reserve(priorLen);
+            for (unsigned int d = 1; d <= priorLen; d++) {
+                kernelSpectra.push_back(kernelChunks[d].second.clone());
+                tsSpectra.push_back(tsChunks[tsChunks.size() - 1 - d].second.clone());
+            }
+            priorTicket.emplace(PriorBank::get(ts).join(chunkIndex, std::move(kernelSpectra), std::move(tsSpectra)));
         }
 
         unsigned int nanEnd = !backfillZeros && kernelSize - 1 > offset ? kernelSize - 1 - offset : 0;
@@ -111,6 +129,8 @@ public:
             tsChunks = std::move(tsChunks),
             kernelPartitionFfts = std::move(kernelPartitionFfts),
             tsPartitionFfts = std::move(tsPartitionFfts),
+            priorTicket = std::move(priorTicket),
+            priorLen,
             nanEnd,
             checkProgress
         ](ElementType *dst, unsigned int computedCount) mutable -> unsigned int {
@@ -127,7 +147,7 @@ public:
                         assert(computedCount == 0);
                         return 0;
                     } else {
-                        assert(tsChunks[i].second->getComputedCount() == CHUNK_SIZE * 2);
+                        assert(tsChunks[i].second->getComputedCount() == CHUNK_SIZE + 1);
                     }
                 }
 
@@ -135,12 +155,12 @@ public:
                 // Fall-through intentional
 
             case 1:
-                for (const std::pair<ChunkPtr<ElementType>, ChunkPtr<typename fftwx::Complex, CHUNK_SIZE * 2>> &kc : kernelChunks) {
+                for (const std::pair<ChunkPtr<ElementType>, ChunkPtr<typename fftwx::Complex, CHUNK_SIZE + 1>> &kc : kernelChunks) {
                     if (kc.first->getComputedCount() != CHUNK_SIZE) {
                         assert(computedCount == 0);
                         return 0;
                     } else {
-                        assert(kc.second->getComputedCount() == CHUNK_SIZE * 2);
+                        assert(kc.second->getComputedCount() == CHUNK_SIZE + 1);
                     }
                 }
 
@@ -166,59 +186,22 @@ public:
                 }
                 foundNan:
 
-                unsigned int len = std::min(kernelChunks.size(), tsChunks.size()) - 1;
-                if (len > 0) {
-                    const typename FftwPlanner<ElementType>::IO planIO = FftwPlanner<ElementType>::request();
-
-                    for (unsigned int i = 0; i < len; i++) {
-                        util::DispatchToLambda<bool, 2>::call<void>(i == 0, [dst, planIO, &kernelChunks, &tsChunks, len, i](auto isFirstTag) {
-                            ConvVariant::PriorChunkStepSpec stepSpec;
-                            static_assert(stepSpec.fftSizeLog2 == CHUNK_SIZE_LOG2 + 1, "Incorrect fftSizeLog2");
-                            static_assert(stepSpec.kernelSize == CHUNK_SIZE * 2, "We need the ConvVariant::PriorChunkStepSpec::kernelSize to be twice the chunk size, because we have an extra tsChunk we need to \"consume\".");
-
-                            unsigned int ki = len - i;
-                            unsigned int ti = tsChunks.size() - 1 - len + i;
-
-                            assert(ki < kernelChunks.size());
-                            const ChunkPtr<typename fftwx::Complex, CHUNK_SIZE * 2> &kc = kernelChunks[ki].second;
-                            assert(kc->getComputedCount() == CHUNK_SIZE * 2);
-                            const typename fftwx::Complex *kernelFft = kc->getData();
-
-                            assert(ti < tsChunks.size());
-                            const ChunkPtr<typename fftwx::Complex, CHUNK_SIZE * 2> &tc = tsChunks[ti].second;
-                            assert(tc->getComputedCount() == CHUNK_SIZE * 2);
-                            const typename fftwx::Complex *tsFft = tc->getData();
-
-                            // Elementwise multiply
-                            for (unsigned int i = 0; i < CHUNK_SIZE * 2; i++) {
-                                planIO.complex[i] = kernelFft[i] * tsFft[i];
-                            }
-
-                            typename fftwx_impl<ElementType>::Plan planBwd = FftwPlanner<ElementType>::template getPlanBwd<CHUNK_SIZE * 2>();
-                            fftwx_impl<ElementType>::execute_dft_c2r(planBwd, planIO.complex, planIO.real);
-
-                            static_assert(stepSpec.resultSize == CHUNK_SIZE, "Unexpected ssw.resultSize");
-                            static_assert(stepSpec.dstSize == CHUNK_SIZE, "Unexpected ssw.dstSize");
-                            for (unsigned int i = 0; i < CHUNK_SIZE; i++) {
-                                unsigned int srcIndex = stepSpec.resultBegin + i;
-                                assert(srcIndex < CHUNK_SIZE * 2);
-
-                                unsigned int dstIndex = stepSpec.dstOffsetFromCc + i;
-                                assert(dstIndex < CHUNK_SIZE);
-
-                                if constexpr (isFirstTag.value) {
-                                    dst[dstIndex] = planIO.real[srcIndex];
-                                } else {
-                                    dst[dstIndex] += planIO.real[srcIndex];
-                                }
-                            }
-                        });
-                    }
-
-                    FftwPlanner<ElementType>::release(planIO);
-                } else {
+                if (priorTicket) {
+                    ConvVariant::PriorChunkStepSpec stepSpec;
+                    static_assert(stepSpec.fftSizeLog2 == CHUNK_SIZE_LOG2 + 1, "Incorrect fftSizeLog2");
+                    static_assert(stepSpec.kernelSize == CHUNK_SIZE * 2, "We need the ConvVariant::PriorChunkStepSpec::kernelSize to be twice the chunk size, because we have an extra tsChunk we need to \"consume\".");
+                    static_assert(stepSpec.resultSize == CHUNK_SIZE, "Unexpected ssw.resultSize");
+                    static_assert(stepSpec.dstSize == CHUNK_SIZE, "Unexpected ssw.dstSize");
+                    static_assert(stepSpec.dstOffsetFromCc == 0, "Unexpected ssw.dstOffsetFromCc");
+
+                    // Every pair lands on the same output window, and the inverse FFT is linear,
+                    // so the spectral products are summed and only transformed back once.
+                    priorTicket->compute(dst);
+                    priorTicket.reset();
+                } else if (priorLen == 0) {
                     std::fill_n(dst, CHUNK_SIZE, ElementType(0.0));
                 }
+                // Otherwise an earlier call already wrote the sum into dst, and got no further
 
                 // The chunk initialization could have taken awhile, so go ahead and make sure we're processing the maximum number of samples possible
                 unsigned int newEndCount = getEndCount(tsChunks);
@@ -254,11 +237,11 @@ public:
                             static_assert(kernelIndex < 2, "KernelIndex is too big! We'd need to prepare more chunks for this.");
                             // If std::get fails to compile because of duplicate types, this probably means there are distinct kernel FftSeries that generate the same ChunkPtr type.
                             // This isn't necessarily unworkable, but it probably means more stuff will be computed than need be.
-                            const ChunkPtr<typename fftwx::Complex, stepSpec.fftSize> &kc = std::get<std::array<ChunkPtr<typename fftwx::Complex, stepSpec.fftSize>, 2>>(kernelPartitionFfts)[kernelIndex];
+                            const ChunkPtr<typename fftwx::Complex, stepSpec.spectrumSize> &kc = std::get<std::array<ChunkPtr<typename fftwx::Complex, stepSpec.spectrumSize>, 2>>(kernelPartitionFfts)[kernelIndex];
                             if (kc->getComputedCount() == 0) {
                                 return false;
                             }
-                            assert(kc->getComputedCount() == stepSpec.fftSize);
+                            assert(kc->getComputedCount() == stepSpec.spectrumSize);
                         }
 
                         unsigned int tsOffset = computedCount + stepSpec.tsIndexOffsetFromCc;
@@ -268,11 +251,11 @@ public:
                             assert(tsIndex < CHUNK_SIZE / stepSpec.strideSize);
                             // If std::get fails to compile because of duplicate types, this probably means there are distinct TS FftSeries that generate the same ChunkPtr type.
                             // This isn't necessarily unworkable, but it probably means more stuff will be computed than need be.
-                            const ChunkPtr<typename fftwx::Complex, stepSpec.fftSize> &tc = std::get<std::array<ChunkPtr<typename fftwx::Complex, stepSpec.fftSize>, CHUNK_SIZE / stepSpec.strideSize>>(tsPartitionFfts)[tsIndex];
+                            const ChunkPtr<typename fftwx::Complex, stepSpec.spectrumSize> &tc = std::get<std::array<ChunkPtr<typename fftwx::Complex, stepSpec.spectrumSize>, CHUNK_SIZE / stepSpec.strideSize>>(tsPartitionFfts)[tsIndex];
                             if (tc->getComputedCount() == 0) {
                                 return false;
                             }
-                            assert(tc->getComputedCount() == stepSpec.fftSize);
+                            assert(tc->getComputedCount() == stepSpec.spectrumSize);
                         }
 
                         return true;
@@ -294,8 +277,8 @@ public:
                             static_assert(kernelIndex < 2, "KernelIndex is too big! We'd need to prepare more chunks for this.");
                             // If std::get fails to compile because of duplicate types, this probably means there are distinct kernel FftSeries that generate the same ChunkPtr type.
                             // This isn't necessarily unworkable, but it probably means more stuff will be computed than need be.
-                            const ChunkPtr<typename fftwx::Complex, stepSpec.fftSize> &kc = std::get<std::array<ChunkPtr<typename fftwx::Complex, stepSpec.fftSize>, 2>>(kernelPartitionFfts)[kernelIndex];
-                            assert(kc->getComputedCount() == stepSpec.fftSize);
+                            const ChunkPtr<typename fftwx::Complex, stepSpec.spectrumSize> &kc = std::get<std::array<ChunkPtr<typename fftwx::Complex, stepSpec.spectrumSize>, 2>>(kernelPartitionFfts)[kernelIndex];
+                            assert(kc->getComputedCount() == stepSpec.spectrumSize);
                             kernelFft = kc->getData();
                         } else {
                             static_assert(stepSpec.strideSize < CHUNK_SIZE, "CONV_CACHE_KERNEL_FFT_GTE_SIZE_LOG2 is too big");
@@ -320,8 +303,8 @@ public:
                             assert(tsIndex < CHUNK_SIZE / stepSpec.strideSize);
                             // If std::get fails to compile because of duplicate types, this probably means there are distinct TS FftSeries that generate the same ChunkPtr type.
                             // This isn't necessarily unworkable, but it probably means more stuff will be computed than need be.
-                            const ChunkPtr<typename fftwx::Complex, stepSpec.fftSize> &tc = std::get<std::array<ChunkPtr<typename fftwx::Complex, stepSpec.fftSize>, CHUNK_SIZE / stepSpec.strideSize>>(tsPartitionFfts)[tsIndex];
-                            assert(tc->getComputedCount() == stepSpec.fftSize);
+                            const ChunkPtr<typename fftwx::Complex, stepSpec.spectrumSize> &tc = std::get<std::array<ChunkPtr<typename fftwx::Complex, stepSpec.spectrumSize>, CHUNK_SIZE / stepSpec.strideSize>>(tsPartitionFfts)[tsIndex];
+                            assert(tc->getComputedCount() == stepSpec.spectrumSize);
                             tsFft = tc->getData();
                         } else {
                             static_assert(stepSpec.strideSize < CHUNK_SIZE, "CONV_CACHE_TS_FFT_GTE_SIZE_LOG2 is too big");
@@ -345,7 +328,7 @@ public:
                         }
 
                         // Elementwise multiply
-                        for (unsigned int i = 0; i < stepSpec.fftSize; i++) {
+                        for (unsigned int i = 0; i < stepSpec.spectrumSize; i++) {
                             planIO.complex[i] = kernelFft[i] * tsFft[i];
                         }
 
@@ -418,14 +401,20 @@ public:
         });
     }
 
+    std::size_t getLookback(const DataSeriesBase &operand) const override {
+        return &operand == &kernel ? DataSeriesBase::unboundedLookback : kernelSize - 1;
+    }
+
 private:
+    typedef ConvBank<ElementType, ConvVariant::PriorChunkStepSpec::resultBegin> PriorBank;
+
     DataSeries<ElementType> &kernel;
     DataSeries<ElementType> &ts;
 
     unsigned int kernelSize;
     bool backfillZeros;
 
-    static unsigned int getEndCount(const std::vector<std::pair<ChunkPtr<ElementType>, ChunkPtr<typename fftwx::Complex, CHUNK_SIZE * 2>>> &tsChunks) {
+    static unsigned int getEndCount(const std::vector<std::pair<ChunkPtr<ElementType>, ChunkPtr<typename fftwx::Complex, CHUNK_SIZE + 1>>> &tsChunks) {
         unsigned int endCount = tsChunks.back().first->getComputedCount();
 #if ENABLE_CONV_MIN_COMPUTE_FLAG
         unsigned int minComputeLog2 = app::Options::getInstance().convMinComputeLog2;
@@ -496,7 +485,7 @@ template <typename ElementType, std::size_t partitionSize, signed int srcOffset,
 static auto getFftArr(FftSeries<ElementType, partitionSize, srcOffset, copySize, dstOffset, scale> &fft, std::uint64_t offset, std::index_sequence<is...>) {
     assert(offset % partitionSize == 0);
 
-    typedef ChunkPtr<typename fftwx_impl<ElementType>::Complex, partitionSize * 2> FftChunkPtr;
+    typedef ChunkPtr<typename fftwx_impl<ElementType>::Complex, partitionSize + 1> FftChunkPtr;
 
 #if ENABLE_CONV_MIN_COMPUTE_FLAG
     unsigned int minComputeLog2 = app::Options::getInstance().convMinComputeLog2;
@@ -506,7 +495,7 @@ static auto getFftArr(FftSeries<ElementType, partitionSize, srcOffset, copySize,
 #endif
     if (partitionSize >= 1u << minComputeLog2) {
         return std::array<FftChunkPtr, sizeof...(is)>{
-            fft.template getChunk<partitionSize * 2>(offset / partitionSize + is)...
+            fft.template getChunk<partitionSize + 1>(offset / partitionSize + is)...
         };
     } else {
         return std::array<FftChunkPtr, sizeof...(is)>{
@@ -58,6 +58,11 @@ public:
         });
     }
 
+    std::size_t getLookback(const DataSeriesBase &operand) const override {
+        (void) operand;
+        return delay;
+    }
+
 private:
     DataSeries<ElementType> &arg;
 
@@ -48,6 +48,11 @@ public:
         });
     }
 
+    std::size_t getLookback(const DataSeriesBase &operand) const override {
+        (void) operand;
+        return 1;
+    }
+
 private:
     OperatorType op;
 
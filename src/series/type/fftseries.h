@@ -91,7 +91,7 @@ namespace series {
 //   2. Transient - calculated when needed, and thrown away.
 
 template <typename ElementType, std::size_t partitionSize, signed int srcOffset, unsigned int copySize, unsigned int dstOffset, typename scale = std::ratio<1>>
-class FftSeries : public DataSeries<typename fftwx_impl<ElementType>::Complex, partitionSize * 2> {
+class FftSeries : public DataSeries<typename fftwx_impl<ElementType>::Complex, partitionSize + 1> {
     typedef FftSeries<ElementType, partitionSize, srcOffset, copySize, dstOffset, scale> SelfType;
 
 private:
@@ -104,6 +104,13 @@ private:
     static constexpr std::size_t fftSize = partitionSize * 2;
     static_assert(dstOffset + copySize <= fftSize, "The copied elements would exceed the size of the FFT");
 
+public:
+    // The input is real, so the upper half of the spectrum is the conjugate of the lower half and fftw doesn't write it.
+    // Only the partitionSize + 1 unique bins are stored, and that's all execute_dft_c2r reads back.
+    static constexpr std::size_t spectrumSize = fftSize / 2 + 1;
+
+private:
+
     static constexpr ElementType factor = static_cast<ElementType>(scale::num) / static_cast<ElementType>(scale::den);
 
     typedef fftwx_impl<ElementType> fftwx;
@@ -123,7 +130,7 @@ public:
 
 private:
     FftSeries(app::AppContext &context, DataSeries<ElementType> &arg)
-        : DataSeries<typename fftwx_impl<ElementType>::Complex, partitionSize * 2>(context)
+        : DataSeries<typename fftwx_impl<ElementType>::Complex, partitionSize + 1>(context)
         , arg(arg)
     {
         FftwPlanner<ElementType>::init();
@@ -145,7 +152,7 @@ public:
 
     typedef std::make_signed<std::size_t>::type signed_size_t;
 
-    Chunk<ComplexType, fftSize> *makeChunk(std::size_t chunkIndex) override {
+    Chunk<ComplexType, spectrumSize> *makeChunk(std::size_t chunkIndex) override {
         signed_size_t centerOffset = chunkIndex * partitionSize + splitOffset;
 
         ChunkPtr<ElementType> leftChunk = centerOffset >= static_cast<signed_size_t>(partitionSize)
@@ -172,7 +179,7 @@ public:
             doFft(dst, leftChunk, rightChunk, centerOffset, planIO.real);
             FftwPlanner<ElementType>::release(planIO);
 
-            return fftSize;
+            return spectrumSize;
         });
     }
 
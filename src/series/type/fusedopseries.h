@@ -0,0 +1,356 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <cstdint>
+
+#include "series/dataseries.h"
+#include "util/simd.h"
+
+namespace series {
+
+// One elementwise op of a FusedOpSeries, applied to a block of its operands
+template <typename ElementType>
+class FusedOp {
+public:
+    virtual ~FusedOp() {}
+
+    virtual void apply(ElementType *dst, const ElementType *const *srcs, unsigned int count) const = 0;
+};
+
+template <typename ElementType, typename OperatorType, std::size_t numArgs>
+class FusedOpImpl : public FusedOp<ElementType> {
+public:
+    FusedOpImpl(OperatorType op)
+        : op(op)
+    {}
+
+    void apply(ElementType *dst, const ElementType *const *srcs, unsigned int count) const override {
+        applySeq(dst, srcs, count, std::make_index_sequence<numArgs>());
+    }
+
+private:
+    OperatorType op;
+
+    template <std::size_t, typename Type>
+    using Repeat = Type;
+
+    template <std::size_t... Indices>
+    void applySeq(ElementType *dst, const ElementType *const *srcs, unsigned int count, std::index_sequence<Indices...>) const {
+        typedef util::Simd<ElementType> S;
+
+        unsigned int i = 0;
+        if constexpr (std::is_invocable_r<typename S::Vec, const OperatorType &, Repeat<Indices, typename S::Vec>...>::value) {
+            for (; i + S::width <= count; i += S::width) {
+                S::store(dst + i, op(S::load(srcs[Indices] + i)...));
+            }
+            // The vector and scalar versions can round differently, like with ENABLE_APPROX_SIMD_MATH,
+            // so the tail goes through the vector one too, and an element doesn't depend on how many were computed with it
+            if (i < count) {
+                S::storePartial(dst + i, op(S::loadPartial(srcs[Indices] + i, count - i)...), count - i);
+            }
+        } else {
+            for (; i < count; i++) {
+                dst[i] = op(srcs[Indices][i]...);
+            }
+        }
+    }
+};
+
+// Operators whose results are always 0 or 1 declare this, see FusedOpSeries::setIsPredicate()
+template <typename OperatorType>
+concept PredicateOperator = OperatorType::isPredicate;
+
+// An elementwise op over series of the same type.
+// Operands that are themselves FusedOpSeries with no other consumer get inlined,
+// so a chain like sqrt(add(square(sub(a, b)), c)) computes in one pass without chunks for the intermediates.
+// Predicates with several consumers are read as a bitmask instead of through their own chunks, see MaskSeries.
+template <typename ElementType>
+class FusedOpSeries : public DataSeries<ElementType> {
+public:
+    template <typename OperatorType, typename... ArgTypes>
+    FusedOpSeries(app::AppContext &context, OperatorType op, ArgTypes &... args)
+        : DataSeries<ElementType>(context)
+        , op(std::make_unique<FusedOpImpl<ElementType, OperatorType, sizeof...(ArgTypes)>>(op))
+        , operands{&args...}
+    {
+        static_assert((std::is_convertible<ArgTypes *, DataSeries<ElementType> *>::value && ...), "FusedOpSeries operands must all be DataSeries<ElementType>");
+    }
+
+    // Promises that every element is 0 or 1, so consumers can share it as one bit per element
+    void setIsPredicate() {
+        isPredicate = true;
+    }
+
+    Chunk<ElementType> *makeChunk(std::size_t chunkIndex) override {
+        std::vector<Source> sources = getSources(chunkIndex);
+        Workspace workspace = makeWorkspace(sources);
+
+        return this->constructChunk([this, sources = std::move(sources), workspace = std::move(workspace)](ElementType *dst, unsigned int computedCount) mutable -> unsigned int {
+            unsigned int endCount = getComputedCount(sources);
+            if (endCount > computedCount) {
+                evaluate(sources, workspace, dst + computedCount, computedCount, endCount);
+            }
+            return endCount;
+        });
+    }
+
+private:
+    // Small enough that the temporaries of a long chain stay in L1
+    static constexpr unsigned int blockSize = 256;
+
+    // Chunks can be smaller than a word in test builds
+    static constexpr std::size_t wordBits = std::min<std::size_t>(64, CHUNK_SIZE);
+    static_assert(CHUNK_SIZE % wordBits == 0 && blockSize % wordBits == 0, "Mask words can't straddle chunks or blocks");
+    static constexpr std::size_t maskSize = CHUNK_SIZE / wordBits;
+
+    typedef ChunkPtr<std::uint64_t, maskSize> MaskPtr;
+
+    // MaskSeries inherits an ElementType of its own
+    typedef ElementType ValueType;
+
+    // The elements of a predicate packed into words, which takes 1/64th the memory of a double chunk.
+    // A chunk only counts whole words as computed, so it can lag up to 63 elements behind the predicate's operands,
+    // and consumers compute those from the operands themselves, see Source.
+    class MaskSeries : public DataSeries<std::uint64_t, maskSize> {
+    public:
+        MaskSeries(app::AppContext &context, FusedOpSeries &owner)
+            : DataSeries<std::uint64_t, maskSize>(context)
+            , owner(owner)
+        {}
+
+        Chunk<std::uint64_t, maskSize> *makeChunk(std::size_t chunkIndex) override {
+            std::vector<Source> sources = owner.getSources(chunkIndex);
+            Workspace workspace = owner.makeWorkspace(sources);
+
+            return this->constructChunk([this, sources = std::move(sources), workspace = std::move(workspace)](std::uint64_t *dst, unsigned int computedCount) mutable -> unsigned int {
+                unsigned int endCount = FusedOpSeries::getComputedCount(sources) / wordBits;
+
+                ValueType values[blockSize];
+                for (unsigned int word = computedCount; word < endCount; word += blockSize / wordBits) {
+                    unsigned int numWords = std::min<unsigned int>(blockSize / wordBits, endCount - word);
+                    owner.evaluate(sources, workspace, values, word * wordBits, (word + numWords) * wordBits);
+
+                    for (unsigned int i = 0; i < numWords; i++) {
+                        std::uint64_t bits = 0;
+                        for (unsigned int j = 0; j < wordBits; j++) {
+                            bits |= static_cast<std::uint64_t>(values[i * wordBits + j] != static_cast<ValueType>(0)) << j;
+                        }
+                        dst[word + i] = bits;
+                    }
+                }
+
+                return std::max(computedCount, endCount);
+            });
+        }
+
+    private:
+        FusedOpSeries &owner;
+    };
+
+    // Buffers for evaluate(), made once per chunk so the hot path doesn't allocate
+    struct Workspace {
+        std::vector<ElementType> temps;
+        std::vector<ElementType> scratch;
+        std::vector<const ElementType *> leafData;
+        std::vector<const ElementType *> srcs;
+
+        // One per source, for the predicates that compute what their mask hasn't got to yet
+        std::vector<Workspace> predicates;
+    };
+
+    // The chunk of a leaf for one chunk index. Leaves that are predicates get read through their mask,
+    // plus the predicate's own sources to compute what the mask hasn't got to yet.
+    struct Source {
+        ChunkPtr<ElementType> chunk = ChunkPtr<ElementType>::null();
+
+        const FusedOpSeries *predicate = nullptr;
+        MaskPtr mask = MaskPtr::null();
+        std::vector<Source> predicateSources;
+
+        unsigned int getComputedCount() const {
+            return predicate ? FusedOpSeries::getComputedCount(predicateSources) : chunk->getComputedCount();
+        }
+
+        // Returns elements [begin, end), using scratch if they aren't stored anywhere as is
+        const ElementType *read(unsigned int begin, unsigned int end, ElementType *scratch, Workspace &predicateWorkspace) const {
+            if (!predicate) {
+                return chunk->getData() + begin;
+            }
+
+            const std::uint64_t *words = mask->getData();
+            unsigned int maskEnd = std::clamp<unsigned int>(mask->getComputedCount() * wordBits, begin, end);
+            for (unsigned int i = begin; i < maskEnd; i++) {
+                scratch[i - begin] = static_cast<ElementType>((words[i / wordBits] >> (i % wordBits)) & 1);
+            }
+            if (maskEnd < end) {
+                predicate->evaluate(predicateSources, predicateWorkspace, scratch + (maskEnd - begin), maskEnd, end);
+            }
+            return scratch;
+        }
+    };
+
+    struct Slot {
+        // For a step's destination, isLeaf means the output chunk
+        bool isLeaf;
+        unsigned int index;
+    };
+
+    struct Step {
+        const FusedOp<ElementType> *op;
+        std::vector<Slot> args;
+        Slot dst;
+    };
+
+    struct Leaf {
+        DataSeries<ElementType> *series;
+        // Only set for predicates read through their mask
+        FusedOpSeries *predicate;
+
+        bool operator==(const Leaf &other) const = default;
+    };
+
+    std::unique_ptr<FusedOp<ElementType>> op;
+    std::vector<DataSeries<ElementType> *> operands;
+    bool isPredicate = false;
+    std::unique_ptr<MaskSeries> mask;
+
+    bool compiled = false;
+    std::vector<Leaf> leaves;
+    std::vector<Step> steps;
+    unsigned int numTemps = 0;
+    std::vector<unsigned int> freeTemps;
+    std::size_t maxNumArgs = 0;
+
+    std::vector<Source> getSources(std::size_t chunkIndex) {
+        if (!compiled) {
+            // Consumers are counted as the program resolves, so wait until something needs a chunk to decide what to inline.
+            compile(this);
+            compiled = true;
+        }
+
+        std::vector<Source> sources(leaves.size());
+        for (std::size_t i = 0; i < leaves.size(); i++) {
+            if (FusedOpSeries *predicate = leaves[i].predicate) {
+                if (!predicate->mask) {
+                    predicate->mask = std::make_unique<MaskSeries>(this->context, *predicate);
+                }
+                sources[i].predicate = predicate;
+                sources[i].mask = predicate->mask->template getChunk<maskSize>(chunkIndex);
+                sources[i].predicateSources = predicate->getSources(chunkIndex);
+            } else {
+                sources[i].chunk = leaves[i].series->getChunk(chunkIndex);
+            }
+        }
+        return sources;
+    }
+
+    static unsigned int getComputedCount(const std::vector<Source> &sources) {
+        unsigned int endCount = CHUNK_SIZE;
+        for (const Source &source : sources) {
+            endCount = std::min(endCount, source.getComputedCount());
+        }
+        return endCount;
+    }
+
+    Workspace makeWorkspace(const std::vector<Source> &sources) const {
+        bool hasMasks = std::any_of(sources.cbegin(), sources.cend(), [](const Source &source) {return source.predicate;});
+
+        Workspace res;
+        res.temps.resize(numTemps * blockSize);
+        res.scratch.resize(hasMasks ? sources.size() * blockSize : 0);
+        res.leafData.resize(sources.size());
+        res.srcs.resize(maxNumArgs);
+        if (hasMasks) {
+            res.predicates.reserve(sources.size());
+            for (const Source &source : sources) {
+                res.predicates.push_back(source.predicate ? source.predicate->makeWorkspace(source.predicateSources) : Workspace());
+            }
+        }
+        return res;
+    }
+
+    // Writes elements [begin, end) to dst[0, end - begin)
+    void evaluate(const std::vector<Source> &sources, Workspace &workspace, ElementType *dst, unsigned int begin, unsigned int end) const {
+        bool hasMasks = !workspace.predicates.empty();
+
+        for (unsigned int i = begin; i < end; i += blockSize) {
+            unsigned int count = std::min(blockSize, end - i);
+            for (std::size_t j = 0; j < sources.size(); j++) {
+                if (hasMasks) {
+                    workspace.leafData[j] = sources[j].read(i, i + count, workspace.scratch.data() + j * blockSize, workspace.predicates[j]);
+                } else {
+                    workspace.leafData[j] = sources[j].chunk->getData() + i;
+                }
+            }
+
+            for (const Step &step : steps) {
+                for (std::size_t j = 0; j < step.args.size(); j++) {
+                    const Slot &arg = step.args[j];
+                    workspace.srcs[j] = arg.isLeaf ? workspace.leafData[arg.index] : workspace.temps.data() + arg.index * blockSize;
+                }
+                ElementType *out = step.dst.isLeaf ? dst + (i - begin) : workspace.temps.data() + step.dst.index * blockSize;
+                step.op->apply(out, workspace.srcs.data(), count);
+            }
+        }
+    }
+
+    // Appends the steps computing node in postorder, and returns where its result ends up
+    Slot compile(FusedOpSeries *node) {
+        Step step;
+        step.op = node->op.get();
+        for (DataSeries<ElementType> *operand : node->operands) {
+            FusedOpSeries *fused = dynamic_cast<FusedOpSeries *>(operand);
+            if (fused && fused->getNumConsumers() == 1) {
+                step.args.push_back(compile(fused));
+            } else if (fused && fused->isPredicate) {
+                step.args.push_back(Slot{true, addLeaf(Leaf{operand, fused})});
+            } else {
+                step.args.push_back(Slot{true, addLeaf(Leaf{operand, nullptr})});
+            }
+        }
+
+        // Elementwise ops can write over their own operands, so release those first
+        for (const Slot &arg : step.args) {
+            if (!arg.isLeaf) {
+                freeTemps.push_back(arg.index);
+            }
+        }
+
+        if (node == this) {
+            step.dst = Slot{true, 0};
+        } else if (!freeTemps.empty()) {
+            step.dst = Slot{false, freeTemps.back()};
+            freeTemps.pop_back();
+        } else {
+            step.dst = Slot{false, numTemps++};
+        }
+
+        maxNumArgs = std::max(maxNumArgs, step.args.size());
+        steps.push_back(std::move(step));
+        return steps.back().dst;
+    }
+
+    unsigned int addLeaf(Leaf leaf) {
+        typename std::vector<Leaf>::const_iterator found = std::find(leaves.cbegin(), leaves.cend(), leaf);
+        if (found != leaves.cend()) {
+            return found - leaves.cbegin();
+        }
+        leaves.push_back(leaf);
+        return leaves.size() - 1;
+    }
+};
+
+// Constructs a FusedOpSeries that's marked as a predicate if the operator it was built from is one
+template <typename DeclOperatorType, typename ElementType, typename OperatorType, typename... ArgTypes>
+FusedOpSeries<ElementType> *makeFusedOpSeries(app::AppContext &context, OperatorType op, ArgTypes &... args) {
+    FusedOpSeries<ElementType> *res = new FusedOpSeries<ElementType>(context, op, args...);
+    if constexpr (PredicateOperator<DeclOperatorType>) {
+        res->setIsPredicate();
+    }
+    return res;
+}
+
+}
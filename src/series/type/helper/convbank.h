@@ -0,0 +1,266 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <iterator>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+
+#include "series/dataseries.h"
+#include "series/fftwx.h"
+#include "util/simd.h"
+
+#include "defs/CONV_BANK_BATCH_SIZE.h"
+
+namespace series {
+
+// Programs tend to convolve the same series with a whole bank of windows.
+// Every ConvSeries over the same ts joins the same ConvBank, and the prior-chunk part of a chunk
+// (the sum of kernel spectrum * ts spectrum products over all earlier chunks) is computed for all of them at once:
+// each ts spectrum is streamed through once per bin block while the products of every kernel are accumulated,
+// and the inverse FFTs run CONV_BANK_BATCH_SIZE at a time.
+// Whichever member's chunk gets there first computes the results of every member whose spectra are ready, and the rest just copy theirs.
+// Only members that have joined by then are grouped. When the ts is already there (backfills, replays), that means their chunks have to be
+// created in the same Wavefront, which EmitManager::emit() takes care of for everything that gets emitted.
+template <typename ElementType, unsigned int resultBegin>
+class ConvBank {
+    typedef fftwx_impl<ElementType> fftwx;
+    typedef typename fftwx::Complex ComplexType;
+    typedef FftwPlanner<ElementType> Planner;
+
+public:
+    typedef ChunkPtr<ComplexType, CHUNK_SIZE + 1> SpectrumPtr;
+
+private:
+    struct Member {
+        enum class State {Pending, Claimed, Computed};
+        State state = State::Pending;
+        bool hasLeft = false;
+
+        // Index d - 1 holds the spectrum of kernel chunk d, and the spectrum of the ts chunk d before the one being computed
+        std::vector<SpectrumPtr> kernelSpectra;
+        std::vector<SpectrumPtr> tsSpectra;
+
+        std::vector<ElementType> result;
+
+        bool isReady() const {
+            for (const SpectrumPtr &spectrum : kernelSpectra) {
+                if (spectrum->getComputedCount() != CHUNK_SIZE + 1) {
+                    return false;
+                }
+            }
+            for (const SpectrumPtr &spectrum : tsSpectra) {
+                if (spectrum->getComputedCount() != CHUNK_SIZE + 1) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void releaseSpectra(std::vector<SpectrumPtr> &graveyard) {
+            std::move(kernelSpectra.begin(), kernelSpectra.end(), std::back_inserter(graveyard));
+            std::move(tsSpectra.begin(), tsSpectra.end(), std::back_inserter(graveyard));
+            kernelSpectra.clear();
+            tsSpectra.clear();
+        }
+    };
+
+    struct Entry {
+        std::mutex mutex;
+        std::condition_variable computed;
+        // A deque so members can join while others are being computed without moving them
+        std::deque<Member> members;
+    };
+
+public:
+    class Ticket {
+    public:
+        Ticket(std::shared_ptr<Entry> entry, std::size_t index)
+            : entry(std::move(entry))
+            , index(index)
+        {}
+
+        Ticket(Ticket &&other) = default;
+        Ticket &operator=(Ticket &&other) = delete;
+
+        ~Ticket() {
+            if (!entry) {
+                return;
+            }
+
+            std::vector<SpectrumPtr> graveyard;
+            std::vector<ElementType> result;
+
+            std::lock_guard<std::mutex> lock(entry->mutex);
+            Member &member = entry->members[index];
+            member.hasLeft = true;
+            if (member.state != Member::State::Claimed) {
+                member.releaseSpectra(graveyard);
+                std::swap(result, member.result);
+            }
+        }
+
+        // Writes the prior-chunk sum of this member into dst[0, CHUNK_SIZE). Must only be called once all of its spectra are computed.
+        void compute(ElementType *dst) {
+            assert(entry);
+
+            std::unique_lock<std::mutex> lock(entry->mutex);
+            Member &self = entry->members[index];
+            assert(!self.hasLeft);
+
+            if (self.state == Member::State::Pending) {
+                assert(self.isReady());
+
+                std::vector<Member *> claimed;
+                std::vector<ElementType *> dsts;
+                for (Member &member : entry->members) {
+                    if (member.state == Member::State::Pending && !member.hasLeft && (&member == &self || member.isReady())) {
+                        member.state = Member::State::Claimed;
+                        if (&member == &self) {
+                            dsts.push_back(dst);
+                        } else {
+                            member.result.resize(CHUNK_SIZE);
+                            dsts.push_back(member.result.data());
+                        }
+                        claimed.push_back(&member);
+                    }
+                }
+
+                // Nobody else touches claimed members, so their spectra can be read without holding the lock
+                lock.unlock();
+                computeGroup(claimed, dsts);
+                lock.lock();
+
+                std::vector<SpectrumPtr> graveyard;
+                for (Member *member : claimed) {
+                    member->state = Member::State::Computed;
+                    member->releaseSpectra(graveyard);
+                    if (member->hasLeft) {
+                        std::vector<ElementType>().swap(member->result);
+                    }
+                }
+                lock.unlock();
+                entry->computed.notify_all();
+            } else {
+                entry->computed.wait(lock, [&self]() {
+                    return self.state == Member::State::Computed;
+                });
+                std::copy_n(self.result.cbegin(), CHUNK_SIZE, dst);
+                std::vector<ElementType>().swap(self.result);
+            }
+
+            entry.reset();
+        }
+
+    private:
+        std::shared_ptr<Entry> entry;
+        std::size_t index;
+    };
+
+    static ConvBank &get(DataSeries<ElementType> &ts) {
+        jw_util::Thread::assert_main_thread();
+
+        static thread_local std::unordered_map<DataSeries<ElementType> *, ConvBank *> cache;
+        auto foundValue = cache.emplace(&ts, static_cast<ConvBank *>(0));
+        if (foundValue.second) {
+            foundValue.first->second = new ConvBank();
+        }
+        return *foundValue.first->second;
+    }
+
+    // Joins the computation of the given chunk. Both vectors run backwards from the chunk, see Member.
+    Ticket join(std::size_t chunkIndex, std::vector<SpectrumPtr> &&kernelSpectra, std::vector<SpectrumPtr> &&tsSpectra) {
+        DataSeriesBase::GraphLock::assertHeld();
+        assert(!kernelSpectra.empty());
+        assert(kernelSpectra.size() == tsSpectra.size());
+
+        std::shared_ptr<Entry> entry = entries[chunkIndex].lock();
+        if (!entry) {
+            entry = std::make_shared<Entry>();
+            entries[chunkIndex] = entry;
+
+            if (entries.size() >= sweepSize) {
+                std::erase_if(entries, [](const auto &pair) {
+                    return pair.second.expired();
+                });
+                sweepSize = std::max<std::size_t>(16, entries.size() * 2);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(entry->mutex);
+        std::size_t index = entry->members.size();
+        Member &member = entry->members.emplace_back();
+        member.kernelSpectra = std::move(kernelSpectra);
+        member.tsSpectra = std::move(tsSpectra);
+        return Ticket(std::move(entry), index);
+    }
+
+private:
+    ConvBank() {}
+
+    // Entries live as long as the chunks that joined them
+    std::unordered_map<std::size_t, std::weak_ptr<Entry>> entries;
+    std::size_t sweepSize = 16;
+
+    static void computeGroup(const std::vector<Member *> &members, const std::vector<ElementType *> &dsts) {
+        static constexpr std::size_t stride = Planner::batchSpectrumStride;
+        static constexpr std::size_t blockSize = 1024;
+
+        std::size_t numMembers = members.size();
+        std::size_t maxLen = 0;
+        for (const Member *member : members) {
+            maxLen = std::max(maxLen, member->kernelSpectra.size());
+        }
+
+        ComplexType *sums = fftwx::alloc_complex(stride * numMembers);
+        ElementType *outputs = fftwx::alloc_real(CHUNK_SIZE * 2 * numMembers);
+
+        // Block over the bins so each ts block stays in cache while every member's products are added in
+        for (std::size_t begin = 0; begin < CHUNK_SIZE + 1; begin += blockSize) {
+            std::size_t size = std::min(blockSize, CHUNK_SIZE + 1 - begin);
+            for (std::size_t d = 0; d < maxLen; d++) {
+                for (std::size_t i = 0; i < numMembers; i++) {
+                    const Member &member = *members[i];
+                    if (d >= member.kernelSpectra.size()) {
+                        continue;
+                    }
+
+                    const ComplexType *kernel = member.kernelSpectra[d]->getData() + begin;
+                    const ComplexType *ts = member.tsSpectra[d]->getData() + begin;
+                    if (d == 0) {
+                        util::simdComplexMultiply<false>(sums + i * stride + begin, kernel, ts, size);
+                    } else {
+                        util::simdComplexMultiply<true>(sums + i * stride + begin, kernel, ts, size);
+                    }
+                }
+            }
+        }
+
+        std::size_t i = 0;
+#if CONV_BANK_BATCH_SIZE > 1
+        typename fftwx::Plan planBatch = Planner::getPlanBwdBatch();
+        if (planBatch) {
+            for (; i + CONV_BANK_BATCH_SIZE <= numMembers; i += CONV_BANK_BATCH_SIZE) {
+                fftwx::execute_dft_c2r(planBatch, sums + i * stride, outputs + i * CHUNK_SIZE * 2);
+            }
+        }
+#endif
+        typename fftwx::Plan planBwd = Planner::template getPlanBwd<CHUNK_SIZE * 2>();
+        for (; i < numMembers; i++) {
+            fftwx::execute_dft_c2r(planBwd, sums + i * stride, outputs + i * CHUNK_SIZE * 2);
+        }
+
+        static_assert(resultBegin + CHUNK_SIZE <= CHUNK_SIZE * 2, "The result window doesn't fit in the inverse FFT");
+        for (i = 0; i < numMembers; i++) {
+            std::copy_n(outputs + i * CHUNK_SIZE * 2 + resultBegin, CHUNK_SIZE, dsts[i]);
+        }
+
+        fftwx::free(sums);
+        fftwx::free(outputs);
+    }
+};
+
+}
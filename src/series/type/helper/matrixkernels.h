@@ -0,0 +1,316 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+
+#include "series/invalidparameterexception.h"
+
+namespace series {
+
+// Kernels for MultiChannelSeries that do the small dense linear algebra of ts/mat.ts one row at a time,
+// instead of as a graph of scalar series per matrix entry.
+
+// An exponentially decayed covariance, the same as decaying_sum(mul(x_i, x_j), rate) for every pair like mCov() builds.
+// Non-finite products count as zero like they do there.
+template <typename ElementType>
+class DecayedCovariance {
+public:
+    DecayedCovariance(std::size_t size, ElementType rate)
+        : size(size)
+        , mul1(static_cast<ElementType>(1) - rate)
+        , mul2(rate)
+    {
+        if (size == 0) {
+            throw InvalidParameterException("DecayedCovariance: needs at least one series");
+        }
+    }
+
+    std::size_t getSize() const {
+        return size;
+    }
+
+    // How many rows it takes for the ones before them to fade to about 1e-12 of their weight, see MultiChannelSeries
+    std::size_t getSettleLength() const {
+        double decay = std::fabs(static_cast<double>(mul1));
+        if (decay >= 1.0) {
+            // Nothing fades, so it has to go back to the start
+            return static_cast<std::size_t>(-1);
+        } else if (decay == 0.0) {
+            return 1;
+        }
+        return static_cast<std::size_t>(std::ceil(std::log(1e-12) / std::log(decay)));
+    }
+
+    // Row-major, and symmetric
+    std::vector<ElementType> getInitial() const {
+        return std::vector<ElementType>(size * size, static_cast<ElementType>(0));
+    }
+
+    void update(std::vector<ElementType> &cov, const ElementType *x) const {
+        for (std::size_t i = 0; i < size; i++) {
+            for (std::size_t j = 0; j <= i; j++) {
+                ElementType product = x[i] * x[j];
+                if (!std::isfinite(product)) {
+                    product = static_cast<ElementType>(0);
+                }
+                ElementType value = cov[i * size + j] * mul1 + product * mul2;
+                cov[i * size + j] = value;
+                cov[j * size + i] = value;
+            }
+        }
+    }
+
+private:
+    std::size_t size;
+    ElementType mul1;
+    ElementType mul2;
+};
+
+// Solves the n by n system in the first n columns of aug for the last one, by Gauss-Jordan elimination without pivoting like mSolve().
+// aug is n by n + 1 and row-major, and the solution ends up in its last column.
+template <typename ElementType>
+void solveAugmented(ElementType *aug, std::size_t n) {
+    std::size_t width = n + 1;
+    for (std::size_t i = 0; i < n; i++) {
+        const ElementType *pivot = aug + i * width;
+        for (std::size_t j = 0; j < n; j++) {
+            if (j == i) {
+                continue;
+            }
+            ElementType *row = aug + j * width;
+            ElementType factor = row[i] / pivot[i];
+            for (std::size_t k = i; k < width; k++) {
+                row[k] -= pivot[k] * factor;
+            }
+        }
+
+        ElementType *row = aug + i * width;
+        ElementType div = row[i];
+        for (std::size_t k = i; k < width; k++) {
+            row[k] /= div;
+        }
+    }
+}
+
+// Channel i * n + j is entry (i, j) of the decayed covariance of the n inputs, like mCov()
+template <typename ElementType>
+class DecayedCovarianceKernel {
+public:
+    static constexpr bool hasCarry = true;
+    typedef std::vector<ElementType> State;
+
+    DecayedCovarianceKernel(std::size_t size, ElementType rate)
+        : cov(size, rate)
+    {}
+
+    std::size_t getNumInputs() const {
+        return cov.getSize();
+    }
+    std::size_t getNumChannels() const {
+        return cov.getSize() * cov.getSize();
+    }
+
+    State getInitialState() const {
+        return cov.getInitial();
+    }
+    std::size_t getSettleLength() const {
+        return cov.getSettleLength();
+    }
+
+    void step(State &state, const ElementType *inputs, ElementType *outputs, std::size_t outputStride) const {
+        cov.update(state, inputs);
+        for (std::size_t i = 0; i < state.size(); i++) {
+            outputs[i * outputStride] = state[i];
+        }
+    }
+
+private:
+    DecayedCovariance<ElementType> cov;
+};
+
+// The principal component of the decayed covariance of the n inputs, by iterating v = cov * v / |v| from a fixed start like mPca()
+template <typename ElementType>
+class DecayedPcaKernel {
+public:
+    static constexpr bool hasCarry = true;
+
+    struct State {
+        std::vector<ElementType> cov;
+        std::vector<ElementType> vec;
+        std::vector<ElementType> next;
+    };
+
+    DecayedPcaKernel(std::size_t size, ElementType rate, std::vector<ElementType> initialVec, std::int64_t iters)
+        : cov(size, rate)
+        , initialVec(std::move(initialVec))
+        , iters(iters)
+    {
+        if (this->initialVec.size() != size) {
+            throw InvalidParameterException("DecayedPcaKernel: the initial vector needs one entry per series, got " + std::to_string(this->initialVec.size()) + " for " + std::to_string(size));
+        }
+        if (iters < 0) {
+            throw InvalidParameterException("DecayedPcaKernel: iters can't be negative");
+        }
+    }
+
+    std::size_t getNumInputs() const {
+        return cov.getSize();
+    }
+    std::size_t getNumChannels() const {
+        return cov.getSize();
+    }
+
+    State getInitialState() const {
+        return State{cov.getInitial(), initialVec, initialVec};
+    }
+    std::size_t getSettleLength() const {
+        return cov.getSettleLength();
+    }
+
+    void step(State &state, const ElementType *inputs, ElementType *outputs, std::size_t outputStride) const {
+        cov.update(state.cov, inputs);
+
+        std::size_t size = cov.getSize();
+        std::vector<ElementType> &vec = state.vec;
+        std::vector<ElementType> &next = state.next;
+        vec = initialVec;
+        for (std::int64_t iter = 0; iter < iters; iter++) {
+            ElementType sumSquares = 0;
+            for (std::size_t i = 0; i < size; i++) {
+                sumSquares += vec[i] * vec[i];
+            }
+            ElementType mag = std::sqrt(sumSquares);
+
+            for (std::size_t i = 0; i < size; i++) {
+                ElementType sum = 0;
+                for (std::size_t j = 0; j < size; j++) {
+                    sum += state.cov[i * size + j] * (vec[j] / mag);
+                }
+                next[i] = sum;
+            }
+            vec.swap(next);
+        }
+
+        for (std::size_t i = 0; i < size; i++) {
+            outputs[i * outputStride] = vec[i];
+        }
+    }
+
+private:
+    DecayedCovariance<ElementType> cov;
+    std::vector<ElementType> initialVec;
+    std::int64_t iters;
+};
+
+// The least squares coefficients of the first input on the rest under the decayed covariance, like mPredict().
+// Channel i is the coefficient of input i + 1.
+template <typename ElementType>
+class DecayedRegressionKernel {
+public:
+    static constexpr bool hasCarry = true;
+
+    struct State {
+        std::vector<ElementType> cov;
+        std::vector<ElementType> aug;
+    };
+
+    DecayedRegressionKernel(std::size_t numRegressors, ElementType rate)
+        : cov(numRegressors + 1, rate)
+    {
+        if (numRegressors == 0) {
+            throw InvalidParameterException("DecayedRegressionKernel: needs at least one regressor");
+        }
+    }
+
+    std::size_t getNumInputs() const {
+        return cov.getSize();
+    }
+    std::size_t getNumChannels() const {
+        return cov.getSize() - 1;
+    }
+
+    State getInitialState() const {
+        std::size_t n = cov.getSize() - 1;
+        return State{cov.getInitial(), std::vector<ElementType>(n * (n + 1))};
+    }
+    std::size_t getSettleLength() const {
+        return cov.getSettleLength();
+    }
+
+    void step(State &state, const ElementType *inputs, ElementType *outputs, std::size_t outputStride) const {
+        cov.update(state.cov, inputs);
+
+        // The regressors' block of the covariance, augmented with their covariance with the target
+        std::size_t size = cov.getSize();
+        std::size_t n = size - 1;
+        std::vector<ElementType> &aug = state.aug;
+        for (std::size_t i = 0; i < n; i++) {
+            for (std::size_t j = 0; j < n; j++) {
+                aug[i * (n + 1) + j] = state.cov[(i + 1) * size + j + 1];
+            }
+            aug[i * (n + 1) + n] = state.cov[(i + 1) * size];
+        }
+
+        solveAugmented(aug.data(), n);
+
+        for (std::size_t i = 0; i < n; i++) {
+            outputs[i * outputStride] = aug[i * (n + 1) + n];
+        }
+    }
+
+private:
+    DecayedCovariance<ElementType> cov;
+};
+
+// Solves A x = b row by row, for inputs A (n * n of them, row-major) followed by b. Channel i is x_i. Like mSolve().
+template <typename ElementType>
+class SolveKernel {
+public:
+    static constexpr bool hasCarry = false;
+
+    // Nothing carries over between rows, this is just scratch space
+    struct State {
+        std::vector<ElementType> aug;
+    };
+
+    SolveKernel(std::size_t size)
+        : size(size)
+    {
+        if (size == 0) {
+            throw InvalidParameterException("SolveKernel: the system can't be empty");
+        }
+    }
+
+    std::size_t getNumInputs() const {
+        return size * size + size;
+    }
+    std::size_t getNumChannels() const {
+        return size;
+    }
+
+    State getInitialState() const {
+        return State{std::vector<ElementType>(size * (size + 1))};
+    }
+
+    void step(State &state, const ElementType *inputs, ElementType *outputs, std::size_t outputStride) const {
+        std::vector<ElementType> &aug = state.aug;
+        for (std::size_t i = 0; i < size; i++) {
+            std::copy_n(inputs + i * size, size, aug.begin() + i * (size + 1));
+            aug[i * (size + 1) + size] = inputs[size * size + i];
+        }
+
+        solveAugmented(aug.data(), size);
+
+        for (std::size_t i = 0; i < size; i++) {
+            outputs[i * outputStride] = aug[i * (size + 1) + size];
+        }
+    }
+
+private:
+    std::size_t size;
+};
+
+}
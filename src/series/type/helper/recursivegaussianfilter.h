@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cassert>
+#include <complex>
+#include <string>
+#include <vector>
+
+#include "series/invalidparameterexception.h"
+
+namespace series {
+
+// A causal IIR filter whose impulse response approximates a sum of one-sided gaussians weight_m * exp(-(i / scale_m)^2), i >= 0.
+// Deriche style, exp(-u^2) is approximated by sum_k((a_k * cos(omega_k * u) + b_k * sin(omega_k * u)) * exp(-lambda_k * u)),
+// so every term is the real part of a one-pole filter with a complex pole, and each sample costs the same however wide the gaussians are.
+// NaNs are handled like ConvSeries does: they blank out the next width outputs, and so does the start of the series unless backfillZeros is set.
+class RecursiveGaussianFilter {
+public:
+    struct Component {
+        double scale;
+        double weight;
+    };
+
+    struct State {
+        std::vector<std::complex<double>> terms;
+        std::int64_t nanLeft;
+    };
+
+    static constexpr unsigned int maxOrder = 4;
+
+    // With normalizeEach, every gaussian is normalized to unit gain before it's weighted, like sub(norm(gaussian(scale_0)), norm(gaussian(scale_1))).
+    // Otherwise the weighted sum is normalized as a whole, like norm(sub(gaussian(scale_0), gaussian(scale_1))).
+    RecursiveGaussianFilter(const std::vector<Component> &components, bool normalizeEach, std::int64_t order, std::int64_t width, bool backfillZeros)
+        : width(width)
+        , backfillZeros(backfillZeros)
+    {
+        if (order < 1 || order > maxOrder) {
+            throw InvalidParameterException("RecursiveGaussianFilter: order must be between 1 and " + std::to_string(maxOrder));
+        }
+        if (width < 1) {
+            throw InvalidParameterException("RecursiveGaussianFilter: width must be at least 1");
+        }
+
+        double totalGain = 0.0;
+        for (const Component &component : components) {
+            if (!(component.scale > 0.0)) {
+                throw InvalidParameterException("RecursiveGaussianFilter: scale must be greater than zero");
+            }
+
+            // Each term is Re(gain * pole^i), with pole = exp((-lambda + omega * j) / scale) and gain = a - b * j
+            std::size_t begin = poles.size();
+            double componentGain = 0.0;
+            for (const Term &term : getTerms(order)) {
+                std::complex<double> pole = std::exp(std::complex<double>(-term.lambda, term.omega) / component.scale);
+                std::complex<double> gain(term.a, -term.b);
+                poles.push_back(pole);
+                gains.push_back(gain);
+                componentGain += (gain / (1.0 - pole)).real();
+            }
+
+            double mul = normalizeEach ? component.weight / componentGain : component.weight;
+            for (std::size_t i = begin; i < gains.size(); i++) {
+                gains[i] *= mul;
+            }
+            totalGain += componentGain * mul;
+        }
+
+        if (!normalizeEach) {
+            if (totalGain == 0.0) {
+                throw InvalidParameterException("RecursiveGaussianFilter: the kernel sums to zero, so it can't be normalized");
+            }
+            for (std::complex<double> &gain : gains) {
+                gain /= totalGain;
+            }
+        }
+    }
+
+    State getInitialState() const {
+        return State{std::vector<std::complex<double>>(poles.size(), 0.0), backfillZeros ? 0 : width - 1};
+    }
+
+    // How many samples it takes for everything before them to fade out of the state.
+    // Stepping over that many from a zeroed state (or from the initial one, if the series starts sooner) rebuilds a lost state to about 1e-12.
+    std::int64_t getSettleLength() const {
+        double length = static_cast<double>(width);
+        for (const std::complex<double> &pole : poles) {
+            length = std::max(length, std::log(1e-12) / std::log(std::abs(pole)));
+        }
+        return static_cast<std::int64_t>(std::ceil(length));
+    }
+
+    State getSettledState() const {
+        return State{std::vector<std::complex<double>>(poles.size(), 0.0), 0};
+    }
+
+    double step(State &state, double value) const {
+        if (std::isnan(value)) {
+            std::fill(state.terms.begin(), state.terms.end(), 0.0);
+            state.nanLeft = width;
+        } else {
+            for (std::size_t i = 0; i < poles.size(); i++) {
+                state.terms[i] = state.terms[i] * poles[i] + value;
+            }
+        }
+
+        if (state.nanLeft > 0) {
+            state.nanLeft--;
+            return NAN;
+        }
+
+        double sum = 0.0;
+        for (std::size_t i = 0; i < poles.size(); i++) {
+            sum += state.terms[i].real() * gains[i].real() - state.terms[i].imag() * gains[i].imag();
+        }
+        return sum;
+    }
+
+private:
+    struct Term {
+        double a;
+        double b;
+        double omega;
+        double lambda;
+    };
+
+    std::vector<std::complex<double>> poles;
+    std::vector<std::complex<double>> gains;
+    std::int64_t width;
+    bool backfillZeros;
+
+    // Least squares fits of exp(-u^2) over u in [0, 12], the max error is noted for each order
+    static const std::vector<Term> &getTerms(unsigned int order) {
+        static const std::array<std::vector<Term>, maxOrder> terms = {{
+            // 3.8e-2
+            {
+                {0.96157868, 1.94903243, 1.19520616, 1.7847124},
+            },
+            // 6.1e-4
+            {
+                {1.680379, 3.7506392, 0.89370724, 2.52454948},
+                {-0.68098449, -0.26372951, 2.82467805, 2.43929566},
+            },
+            // 7.4e-6
+            {
+                {3.15131536, 7.28961447, 0.74465056, 3.08506992},
+                {-2.30934244, -0.91199351, 2.28530065, 3.04106062},
+                {0.15801964, -0.0445291, 4.03957493, 2.9386347},
+            },
+            // 2.7e-7
+            {
+                {-0.11223316, -0.70624489, 3.07613205, 2.96021128},
+                {3.28695919, 0.4783161, 0.3933541, 2.65780776},
+                {-2.20017864, 2.40763578, 1.6466297, 2.91008071},
+                {0.02545252, 0.02007779, 4.73900171, 2.91137734},
+            },
+        }};
+        assert(order >= 1 && order <= maxOrder);
+        return terms[order - 1];
+    }
+};
+
+}
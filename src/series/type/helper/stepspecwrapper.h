@@ -13,6 +13,7 @@ struct StepSpecWrapper : public BaseType {
 
     static constexpr unsigned int fftSize = 1u << BaseType::fftSizeLog2;
     static constexpr unsigned int strideSize = fftSize / 2;
+    static constexpr unsigned int spectrumSize = fftSize / 2 + 1;
 
     static_assert(BaseType::resultBegin >= 0, "Having a resultBegin less than zero doesn't make sense");
     static_assert(BaseType::dstOffsetFromCc >= 0, "Cannot change values that have already been emitted");
@@ -1,10 +1,18 @@
 #pragma once
 
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <atomic>
+
 #include "jw_util/hash.h"
 
+#include "log.h"
+
 #include "series/dataseries.h"
 
 #include "defs/ENABLE_CHUNK_MULTITHREADING.h"
+#include "defs/ENABLE_BOUNDED_RETENTION.h"
 
 // TODO: Hold chunk pointer (prevents refcount thrashing)
 
@@ -15,15 +23,20 @@ class InputSeries : public DataSeries<ElementType> {
 public:
     InputSeries(app::AppContext &context, const std::string &name)
         : DataSeries<ElementType>(context, false)
-    {
-        (void) name;
-    }
+        , name(name)
+    {}
 
     Chunk<ElementType> *makeChunk(std::size_t chunkIndex) override {
         return this->constructChunk([this, chunkIndex](ElementType *dst, unsigned int computedCount) -> unsigned int {
-            (void) dst;
             (void) computedCount;
 
+            if (isRetired(chunkIndex)) {
+                // It was freed without being spilled, so its data is gone
+                std::fill_n(dst, CHUNK_SIZE, static_cast<ElementType>(NAN));
+                markLost(chunkIndex);
+                return CHUNK_SIZE;
+            }
+
             std::uint64_t ni = nextIndex;
             std::size_t finishedChunks = ni / CHUNK_SIZE;
             if (chunkIndex < finishedChunks) {
@@ -43,12 +56,17 @@ public:
 
         propagateUntilImpl(index);
 
+        ChunkBase::Wavefront wavefront;
         std::size_t end = (index - 1) / CHUNK_SIZE;
         for (std::size_t i = notifyIdx / CHUNK_SIZE; i <= end; i++) {
             this->getChunk(i)->notify();
         }
 
         notifyIdx = index;
+
+#if ENABLE_BOUNDED_RETENTION
+        retireUntil(index);
+#endif
     }
 
     void set(std::uint64_t index, ElementType value) {
@@ -59,7 +77,52 @@ public:
         nextIndex++;
     }
 
+    // Sets count values starting at index, reading them from src every stride bytes.
+    // They're converted straight into chunk memory, and src doesn't have to be aligned.
+    template <typename ValueType>
+    void setBlock(std::uint64_t index, const char *src, std::size_t count, std::size_t stride) {
+        propagateUntilImpl(index);
+
+        while (count) {
+            std::uint64_t ni = nextIndex;
+            std::size_t offset = ni % CHUNK_SIZE;
+            std::size_t blockCount = std::min<std::size_t>(count, CHUNK_SIZE - offset);
+
+            ElementType *dst = this->getChunk(ni / CHUNK_SIZE)->getMutableData() + offset;
+            for (std::size_t i = 0; i < blockCount; i++) {
+                ValueType value;
+                std::memcpy(&value, src, sizeof(ValueType));
+                dst[i] = static_cast<ElementType>(value);
+                src += stride;
+            }
+
+            prevValue = dst[blockCount - 1];
+            // Only advance once the values are written, since that's what the chunk reports as computed
+            nextIndex = ni + blockCount;
+            count -= blockCount;
+        }
+    }
+
+protected:
+    bool isCacheable() const override {
+        return false;
+    }
+
+    bool canRecompute() const override {
+        return false;
+    }
+
+    bool isRetired(std::size_t chunkIndex) const override {
+        return chunkIndex < retiredEnd;
+    }
+
+    std::size_t getLostEnd() const override {
+        return lostEnd.load(std::memory_order_relaxed);
+    }
+
 private:
+    std::string name;
+
     ElementType prevValue = NAN;
 
 #if ENABLE_CHUNK_MULTITHREADING
@@ -69,6 +132,42 @@ private:
 #endif
     std::size_t notifyIdx = 0;
 
+    // Chunks before this are behind every consumer's horizon
+    std::size_t retiredEnd = 0;
+
+    // Retired chunks that were asked for again after their data was gone, see getLostEnd().
+    // Updated from whichever thread runs the chunk.
+    std::atomic<std::size_t> lostEnd = 0;
+    std::atomic<bool> hasWarnedLost = false;
+
+    void markLost(std::size_t chunkIndex) {
+        std::size_t end = (chunkIndex + 1) * CHUNK_SIZE;
+        std::size_t prev = lostEnd.load(std::memory_order_relaxed);
+        while (prev < end && !lostEnd.compare_exchange_weak(prev, end, std::memory_order_relaxed)) {}
+
+        if (!hasWarnedLost.exchange(true, std::memory_order_relaxed)) {
+            SPDLOG_WARN("Input {} was read at chunk {}, which was retired and freed without being spilled, so it reads as NaN. Use --spill-dir to keep retired input around.", name, chunkIndex);
+        }
+    }
+
+    void retireUntil(std::uint64_t index) {
+        // Worker threads making chunks check retiredEnd through isRetired()
+        typename DataSeries<ElementType>::GraphLock lock;
+
+        std::size_t horizon = this->getHorizon();
+        if (horizon == DataSeriesBase::unboundedLookback || index <= horizon) {
+            return;
+        }
+
+        // Keep one extra chunk, since consumers fetch whole chunks around the element they need
+        std::size_t end = (index - horizon) / CHUNK_SIZE;
+        end = end > 0 ? end - 1 : 0;
+        while (retiredEnd < end) {
+            retiredEnd++;
+            this->retireChunk(retiredEnd - 1);
+        }
+    }
+
     void propagateUntilImpl(std::uint64_t index) {
         assert(nextIndex <= index);
         while (nextIndex < index) {
@@ -23,8 +23,8 @@ private:
         };
 
         static const HeapToRangeCache &getInstance() {
-            jw_util::Thread::assert_main_thread(); // Only want to create one cache
-            static thread_local HeapToRangeCache inst;
+            // Worker threads make chunks too, and they can all share it
+            static const HeapToRangeCache inst;
             return inst;
         }
 
@@ -147,6 +147,10 @@ public:
         });
     }
 
+    std::size_t getLookback(const DataSeriesBase &operand) const override {
+        return &operand == &data ? maxCount - 1 : 0;
+    }
+
 private:
     OperatorType op;
 
@@ -0,0 +1,354 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <unordered_map>
+
+#include "jw_util/thread.h"
+
+#include "series/dataseries.h"
+#include "series/invalidparameterexception.h"
+
+namespace series {
+
+// A series with several channels per element, computed together by a kernel that reads a row of every input at once.
+// Things like a covariance matrix would otherwise be a separate series per entry, each with its own chunks and scheduling.
+// Here a block of CHUNK_SIZE rows is computed for all channels in one pass, and each channel is a DataSeries that copies its part out.
+// Whichever channel's chunk gets there first computes the block, like with ConvBank.
+//
+// A kernel provides:
+//   static constexpr bool hasCarry: whether State carries over from one row to the next, like a scan
+//   State getInitialState() const
+//   std::size_t getSettleLength() const, if it has carry: how many rows it takes for everything before them to fade out of the state
+//   std::size_t getNumInputs() const, std::size_t getNumChannels() const
+//   void step(State &state, const ElementType *inputs, ElementType *outputs, std::size_t outputStride) const,
+//     which writes channel i of the row to outputs[i * outputStride]
+template <typename ElementType, typename KernelType>
+class MultiChannelSeries {
+    typedef typename KernelType::State State;
+
+    // Same as RecursiveGaussianSeries, only the next block needs the state at the end of a block
+    struct EndState {
+        bool isSet = false;
+        State state;
+    };
+
+    struct Block {
+        // The data is charged to the GC like chunks are, since there's one value per channel per row
+        Block(GarbageCollector<ChunkBase> &gc, std::size_t numChannels)
+            : gc(gc)
+            , data(numChannels * CHUNK_SIZE)
+            , isReading(numChannels)
+        {
+            gc.updateMemoryUsage(getDataSize());
+        }
+
+        ~Block() {
+            dropData();
+        }
+
+        std::make_signed<std::size_t>::type getDataSize() const {
+            return data.capacity() * sizeof(ElementType);
+        }
+
+        void dropData() {
+            if (!isDropped) {
+                gc.updateMemoryUsage(-getDataSize());
+                std::vector<ElementType>().swap(data);
+                isDropped = true;
+            }
+        }
+
+        GarbageCollector<ChunkBase> &gc;
+        std::mutex mutex;
+
+        bool hasStarted = false;
+        unsigned int computedCount = 0;
+        State state;
+        std::shared_ptr<EndState> prevEndState;
+        std::shared_ptr<EndState> endState;
+
+        // Channel i is at [i * CHUNK_SIZE, (i + 1) * CHUNK_SIZE)
+        std::vector<ElementType> data;
+
+        // Once every chunk reading the block has copied all of its rows, the data isn't needed anymore.
+        // Channels nobody reads never attach, so they don't hold it up.
+        std::vector<bool> isReading;
+        std::size_t numReading = 0;
+        bool isDropped = false;
+    };
+
+    class Channel : public DataSeries<ElementType> {
+    public:
+        Channel(app::AppContext &context, std::shared_ptr<MultiChannelSeries> owner, std::size_t channel)
+            : DataSeries<ElementType>(context)
+            , owner(std::move(owner))
+            , channel(channel)
+        {}
+
+        Chunk<ElementType> *makeChunk(std::size_t chunkIndex) override {
+            ChunkPtr<ElementType> prevChunk = KernelType::hasCarry && chunkIndex > 0 ? this->getChunk(chunkIndex - 1) : ChunkPtr<ElementType>::null();
+
+            std::vector<ChunkPtr<ElementType>> inputChunks;
+            inputChunks.reserve(owner->inputs.size());
+            for (DataSeries<ElementType> *input : owner->inputs) {
+                inputChunks.emplace_back(input->getChunk(chunkIndex));
+            }
+
+            std::shared_ptr<Block> block = owner->attach(chunkIndex, channel);
+
+            // The previous block's end state is gone if this channel's previous chunk completed without it being kept,
+            // so this chunk has to be able to rebuild it from the inputs, see RecursiveGaussianSeries
+            std::size_t settleBegin = 0;
+            std::vector<std::vector<ChunkPtr<ElementType>>> settleChunks;
+            if constexpr (KernelType::hasCarry) {
+                if (prevChunk.has() && prevChunk->getComputedCount() == CHUNK_SIZE && owner->isMissingPrevEndState(*block)) {
+                    std::size_t settleLength = owner->kernel.getSettleLength();
+                    settleBegin = chunkIndex * CHUNK_SIZE > settleLength ? chunkIndex * CHUNK_SIZE - settleLength : 0;
+                    settleChunks.resize(owner->inputs.size());
+                    for (std::size_t i = 0; i < owner->inputs.size(); i++) {
+                        for (std::size_t j = settleBegin / CHUNK_SIZE; j < chunkIndex; j++) {
+                            settleChunks[i].emplace_back(owner->inputs[i]->getChunk(j));
+                        }
+                    }
+                }
+            }
+
+            return this->constructChunk([this, chunkIndex, prevChunk = std::move(prevChunk), inputChunks = std::move(inputChunks), block = std::move(block), settleBegin, settleChunks = std::move(settleChunks)](ElementType *dst, unsigned int computedCount) -> unsigned int {
+                if (computedCount == 0 && prevChunk.has() && prevChunk->getComputedCount() != CHUNK_SIZE) {
+                    return 0;
+                }
+                return owner->fill(chunkIndex, *block, inputChunks, settleBegin, settleChunks, channel, dst, computedCount);
+            });
+        }
+
+        bool hasCarry() const override {
+            return KernelType::hasCarry;
+        }
+
+    protected:
+        // Same as RecursiveGaussianSeries, the state at the end of each block only lives in memory
+        bool isCacheable() const override {
+            return !KernelType::hasCarry;
+        }
+
+    private:
+        std::shared_ptr<MultiChannelSeries> owner;
+        std::size_t channel;
+    };
+
+public:
+    static std::vector<DataSeries<ElementType> *> create(app::AppContext &context, KernelType kernel, std::vector<DataSeries<ElementType> *> inputs) {
+        if (inputs.size() != kernel.getNumInputs()) {
+            throw InvalidParameterException("MultiChannelSeries: Expected " + std::to_string(kernel.getNumInputs()) + " inputs, got " + std::to_string(inputs.size()));
+        }
+
+        std::shared_ptr<MultiChannelSeries> owner(new MultiChannelSeries(context, std::move(kernel), std::move(inputs)));
+
+        std::vector<DataSeries<ElementType> *> channels;
+        std::size_t numChannels = owner->kernel.getNumChannels();
+        channels.reserve(numChannels);
+        for (std::size_t i = 0; i < numChannels; i++) {
+            channels.push_back(new Channel(context, owner, i));
+        }
+        return channels;
+    }
+
+private:
+    MultiChannelSeries(app::AppContext &context, KernelType kernel, std::vector<DataSeries<ElementType> *> inputs)
+        : context(context)
+        , kernel(std::move(kernel))
+        , inputs(std::move(inputs))
+    {}
+
+    app::AppContext &context;
+    KernelType kernel;
+    std::vector<DataSeries<ElementType> *> inputs;
+
+    // Blocks live as long as the chunks that use them
+    std::unordered_map<std::size_t, std::weak_ptr<Block>> blocks;
+    std::size_t sweepSize = 16;
+
+    // End states live as long as the blocks on either side of them, plus the newest one for the next block to be made
+    std::mutex endStatesMutex;
+    std::unordered_map<std::size_t, std::weak_ptr<EndState>> endStates;
+    std::size_t endStatesSweepSize = 16;
+    std::size_t lastEndStateIndex = 0;
+    std::shared_ptr<EndState> lastEndState;
+
+    std::shared_ptr<Block> attach(std::size_t chunkIndex, std::size_t channel) {
+        DataSeriesBase::GraphLock::assertHeld();
+
+        std::shared_ptr<Block> block = blocks[chunkIndex].lock();
+        if (block) {
+            std::lock_guard<std::mutex> lock(block->mutex);
+            if (block->isDropped) {
+                // Every chunk reading it was done with it, and now another one is wanted
+                block.reset();
+            } else if (!block->isReading[channel]) {
+                // Still around for another channel, so this one reads it too
+                block->isReading[channel] = true;
+                block->numReading++;
+            }
+        }
+
+        if (!block) {
+            block = std::make_shared<Block>(context.get<GarbageCollector<ChunkBase>>(), kernel.getNumChannels());
+            block->isReading[channel] = true;
+            block->numReading = 1;
+            if constexpr (KernelType::hasCarry) {
+                block->prevEndState = chunkIndex > 0 ? getEndState(chunkIndex - 1) : nullptr;
+                block->endState = getEndState(chunkIndex);
+            }
+            blocks[chunkIndex] = block;
+
+            if (blocks.size() >= sweepSize) {
+                std::erase_if(blocks, [](const auto &pair) {
+                    return pair.second.expired();
+                });
+                sweepSize = std::max<std::size_t>(16, blocks.size() * 2);
+            }
+        }
+
+        return block;
+    }
+
+    bool isMissingPrevEndState(Block &block) {
+        if constexpr (KernelType::hasCarry) {
+            std::lock_guard<std::mutex> lock(block.mutex);
+            std::lock_guard<std::mutex> endStatesLock(endStatesMutex);
+            return !block.hasStarted && block.prevEndState && !block.prevEndState->isSet;
+        } else {
+            return false;
+        }
+    }
+
+    // Computes as many rows of the block as the inputs allow, and copies the given channel's new rows to dst
+    unsigned int fill(std::size_t chunkIndex, Block &block, const std::vector<ChunkPtr<ElementType>> &inputChunks, std::size_t settleBegin, const std::vector<std::vector<ChunkPtr<ElementType>>> &settleChunks, std::size_t channel, ElementType *dst, unsigned int computedCount) {
+        std::lock_guard<std::mutex> lock(block.mutex);
+        assert(!block.isDropped);
+
+        if (!block.hasStarted) {
+            if (!start(block, settleBegin, settleChunks)) {
+                // Whoever computes the previous block, or has the inputs to rebuild its end state, starts this one
+                return 0;
+            }
+            block.hasStarted = true;
+        }
+
+        unsigned int endCount = CHUNK_SIZE;
+        for (const ChunkPtr<ElementType> &input : inputChunks) {
+            endCount = std::min(endCount, input->getComputedCount());
+        }
+
+        if (endCount > block.computedCount) {
+            std::vector<ElementType> row(inputChunks.size());
+            for (unsigned int i = block.computedCount; i < endCount; i++) {
+                for (std::size_t j = 0; j < inputChunks.size(); j++) {
+                    row[j] = inputChunks[j]->getElement(i);
+                }
+                kernel.step(block.state, row.data(), block.data.data() + i, CHUNK_SIZE);
+            }
+            block.computedCount = endCount;
+
+            if constexpr (KernelType::hasCarry) {
+                if (endCount == CHUNK_SIZE) {
+                    setEndState(chunkIndex, block);
+                }
+            }
+        }
+
+        unsigned int count = block.computedCount;
+        const ElementType *src = block.data.data() + channel * CHUNK_SIZE;
+        std::copy(src + computedCount, src + count, dst + computedCount);
+
+        if (count == CHUNK_SIZE && block.isReading[channel]) {
+            block.isReading[channel] = false;
+            if (--block.numReading == 0) {
+                block.dropData();
+            }
+        }
+
+        return count;
+    }
+
+    bool start(Block &block, std::size_t settleBegin, const std::vector<std::vector<ChunkPtr<ElementType>>> &settleChunks) {
+        if constexpr (KernelType::hasCarry) {
+            if (block.prevEndState) {
+                std::lock_guard<std::mutex> lock(endStatesMutex);
+                if (block.prevEndState->isSet) {
+                    block.state = block.prevEndState->state;
+                    block.prevEndState.reset();
+                    return true;
+                }
+            }
+
+            if (!settleChunks.empty()) {
+                return settle(block.state, settleBegin, settleChunks);
+            } else if (block.prevEndState) {
+                return false;
+            }
+        }
+
+        block.state = kernel.getInitialState();
+        return true;
+    }
+
+    // Steps from the initial state over the input rows before the block, with the outputs thrown away
+    bool settle(State &state, std::size_t begin, const std::vector<std::vector<ChunkPtr<ElementType>>> &chunks) const {
+        for (const std::vector<ChunkPtr<ElementType>> &inputChunks : chunks) {
+            for (const ChunkPtr<ElementType> &chunk : inputChunks) {
+                if (chunk->getComputedCount() != CHUNK_SIZE) {
+                    return false;
+                }
+            }
+        }
+
+        state = kernel.getInitialState();
+        std::size_t firstIndex = chunks.front().front()->getIndex();
+        std::size_t end = (firstIndex + chunks.front().size()) * CHUNK_SIZE;
+        std::vector<ElementType> row(chunks.size());
+        std::vector<ElementType> outputs(kernel.getNumChannels());
+        for (std::size_t i = begin; i < end; i++) {
+            for (std::size_t j = 0; j < chunks.size(); j++) {
+                row[j] = chunks[j][i / CHUNK_SIZE - firstIndex]->getElement(i % CHUNK_SIZE);
+            }
+            kernel.step(state, row.data(), outputs.data(), 1);
+        }
+        return true;
+    }
+
+    std::shared_ptr<EndState> getEndState(std::size_t chunkIndex) {
+        std::lock_guard<std::mutex> lock(endStatesMutex);
+
+        std::shared_ptr<EndState> endState = endStates[chunkIndex].lock();
+        if (!endState) {
+            endState = std::make_shared<EndState>();
+            endStates[chunkIndex] = endState;
+
+            if (endStates.size() >= endStatesSweepSize) {
+                std::erase_if(endStates, [](const auto &pair) {
+                    return pair.second.expired();
+                });
+                endStatesSweepSize = std::max<std::size_t>(16, endStates.size() * 2);
+            }
+        }
+        return endState;
+    }
+
+    void setEndState(std::size_t chunkIndex, Block &block) {
+        std::lock_guard<std::mutex> lock(endStatesMutex);
+        block.endState->state = block.state;
+        block.endState->isSet = true;
+
+        // A recomputed block can complete after later ones, and shouldn't take their place
+        if (!lastEndState || chunkIndex >= lastEndStateIndex) {
+            lastEndStateIndex = chunkIndex;
+            lastEndState = block.endState;
+        }
+    }
+};
+
+}
@@ -77,6 +77,12 @@ public:
         });
     }
 
+    // The norm factor comes from the first normSize elements, however far back they are
+    std::size_t getLookback(const DataSeriesBase &operand) const override {
+        (void) operand;
+        return DataSeriesBase::unboundedLookback;
+    }
+
 private:
     ArgType arg;
 
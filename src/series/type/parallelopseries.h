@@ -1,6 +1,9 @@
 #pragma once
 
+#include <type_traits>
+
 #include "series/dataseries.h"
+#include "util/simd.h"
 
 namespace series {
 
@@ -17,8 +20,21 @@ public:
         auto chunks = std::apply([chunkIndex](auto &... x){return std::make_tuple(x.getChunk(chunkIndex)...);}, args);
         return this->constructChunk([this, chunks = std::move(chunks)](ElementType *dst, unsigned int computedCount) -> unsigned int {
             unsigned int endCount = std::apply([](auto &... x){return std::min({x->getComputedCount()...});}, chunks);
-            for (std::size_t i = computedCount; i < endCount; i++) {
-                dst[i] = std::apply([this, i](auto &... s){return op(s->getElement(i)...);}, chunks);
+            std::size_t i = computedCount;
+            if constexpr (canVectorize()) {
+                typedef util::Simd<ElementType> S;
+                for (; i + S::width <= endCount; i += S::width) {
+                    S::store(dst + i, std::apply([this, i](auto &... s){return op(S::load(s->getData() + i)...);}, chunks));
+                }
+                // Same as FusedOpImpl, so an element doesn't depend on how many were computed with it
+                if (i < endCount) {
+                    std::size_t count = endCount - i;
+                    S::storePartial(dst + i, std::apply([this, i, count](auto &... s){return op(S::loadPartial(s->getData() + i, count)...);}, chunks), count);
+                }
+            } else {
+                for (; i < endCount; i++) {
+                    dst[i] = std::apply([this, i](auto &... s){return op(s->getData()[i]...);}, chunks);
+                }
             }
             return endCount;
         });
@@ -27,6 +43,15 @@ public:
 private:
     OperatorType op;
 
+    // Ops that also take util::Simd vectors get run a block at a time
+    static constexpr bool canVectorize() {
+        if constexpr ((std::is_same<typename std::remove_reference<ArgTypes>::type::ElementType, ElementType>::value && ...)) {
+            return std::is_invocable_r<typename util::Simd<ElementType>::Vec, OperatorType &, typename util::Simd<typename std::remove_reference<ArgTypes>::type::ElementType>::Vec...>::value;
+        } else {
+            return false;
+        }
+    }
+
     std::tuple<ArgTypes...> args;
 };
 
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <unordered_map>
+
+#include "series/dataseries.h"
+#include "series/type/helper/recursivegaussianfilter.h"
+
+namespace series {
+
+// Gaussian smoothing at a constant cost per sample, see RecursiveGaussianFilter.
+// Like ScannedSeries, each chunk continues from where the previous one left off, so chunks are computed in order.
+template <typename ElementType>
+class RecursiveGaussianSeries : public DataSeries<ElementType> {
+public:
+    RecursiveGaussianSeries(app::AppContext &context, DataSeries<ElementType> &arg, RecursiveGaussianFilter filter)
+        : DataSeries<ElementType>(context)
+        , arg(arg)
+        , filter(std::move(filter))
+    {}
+
+    Chunk<ElementType> *makeChunk(std::size_t chunkIndex) override {
+        ChunkPtr<ElementType> prevChunk = chunkIndex > 0 ? this->getChunk(chunkIndex - 1) : ChunkPtr<ElementType>::null();
+        ChunkPtr<ElementType> argChunk = arg.getChunk(chunkIndex);
+
+        std::shared_ptr<EndState> endState = getEndState(chunkIndex);
+        std::shared_ptr<EndState> prevEndState = chunkIndex > 0 ? getEndState(chunkIndex - 1) : nullptr;
+
+        // A previous chunk that completed without its end state (it was restored, or computed before this one was freed) has lost it,
+        // so it's rebuilt from the input before this chunk instead, see RecursiveGaussianFilter::getSettleLength()
+        std::int64_t settleBegin = 0;
+        std::vector<ChunkPtr<ElementType>> settleChunks;
+        if (prevChunk.has() && prevChunk->getComputedCount() == CHUNK_SIZE && !prevEndState->isSet) {
+            std::int64_t begin = static_cast<std::int64_t>(chunkIndex * CHUNK_SIZE) - filter.getSettleLength();
+            settleBegin = std::max<std::int64_t>(begin, 0);
+            for (std::size_t i = settleBegin / CHUNK_SIZE; i < chunkIndex; i++) {
+                settleChunks.push_back(arg.getChunk(i));
+            }
+        }
+
+        return this->constructChunk([this, chunkIndex, prevChunk = std::move(prevChunk), argChunk = std::move(argChunk), endState = std::move(endState), prevEndState = std::move(prevEndState), settleBegin, settleChunks = std::move(settleChunks), state = RecursiveGaussianFilter::State()](ElementType *dst, unsigned int computedCount) mutable -> unsigned int {
+            if (computedCount == 0) {
+                if (!settleChunks.empty()) {
+                    if (!settle(state, settleBegin, settleChunks)) {
+                        return 0;
+                    }
+                } else if (prevChunk.has()) {
+                    if (prevChunk->getComputedCount() != CHUNK_SIZE) {
+                        return 0;
+                    }
+                    assert(prevEndState->isSet);
+                    state = prevEndState->state;
+                } else {
+                    state = filter.getInitialState();
+                }
+            }
+
+            unsigned int endCount = argChunk->getComputedCount();
+            for (unsigned int i = computedCount; i < endCount; i++) {
+                dst[i] = filter.step(state, argChunk->getElement(i));
+            }
+
+            if (endCount == CHUNK_SIZE) {
+                endState->state = std::move(state);
+                endState->isSet = true;
+                setLastEndState(chunkIndex, endState);
+            }
+            return endCount;
+        });
+    }
+
+    bool hasCarry() const override {
+        return true;
+    }
+
+protected:
+    // The filter state at the end of each chunk only lives in memory, so a chunk restored from the persistent cache would leave the next one without it
+    bool isCacheable() const override {
+        return false;
+    }
+
+private:
+    DataSeries<ElementType> &arg;
+    RecursiveGaussianFilter filter;
+
+    // Only the next chunk needs a chunk's end state, so it's shared between the two and goes away with them.
+    // The last one to complete is kept around too, since the next chunk usually isn't made until the input for it arrives.
+    struct EndState {
+        bool isSet = false;
+        RecursiveGaussianFilter::State state;
+    };
+
+    std::mutex endStatesMutex;
+    std::unordered_map<std::size_t, std::weak_ptr<EndState>> endStates;
+    std::size_t sweepSize = 16;
+    std::size_t lastEndStateIndex = 0;
+    std::shared_ptr<EndState> lastEndState;
+
+    std::shared_ptr<EndState> getEndState(std::size_t chunkIndex) {
+        std::lock_guard<std::mutex> lock(endStatesMutex);
+
+        std::shared_ptr<EndState> endState = endStates[chunkIndex].lock();
+        if (!endState) {
+            endState = std::make_shared<EndState>();
+            endStates[chunkIndex] = endState;
+
+            if (endStates.size() >= sweepSize) {
+                std::erase_if(endStates, [](const auto &pair) {
+                    return pair.second.expired();
+                });
+                sweepSize = std::max<std::size_t>(16, endStates.size() * 2);
+            }
+        }
+        return endState;
+    }
+
+    void setLastEndState(std::size_t chunkIndex, std::shared_ptr<EndState> endState) {
+        std::lock_guard<std::mutex> lock(endStatesMutex);
+        // A recomputed chunk can complete after later ones, and shouldn't take their place
+        if (!lastEndState || chunkIndex >= lastEndStateIndex) {
+            lastEndStateIndex = chunkIndex;
+            lastEndState = std::move(endState);
+        }
+    }
+
+    bool settle(RecursiveGaussianFilter::State &state, std::int64_t begin, const std::vector<ChunkPtr<ElementType>> &chunks) const {
+        for (const ChunkPtr<ElementType> &chunk : chunks) {
+            if (chunk->getComputedCount() != CHUNK_SIZE) {
+                return false;
+            }
+        }
+
+        state = begin == 0 ? filter.getInitialState() : filter.getSettledState();
+        std::size_t firstIndex = chunks.front()->getIndex();
+        for (std::size_t i = static_cast<std::size_t>(begin); i < (firstIndex + chunks.size()) * CHUNK_SIZE; i++) {
+            filter.step(state, chunks[i / CHUNK_SIZE - firstIndex]->getElement(i % CHUNK_SIZE));
+        }
+        return true;
+    }
+};
+
+}
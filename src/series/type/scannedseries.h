@@ -2,6 +2,9 @@
 
 #include "series/dataseries.h"
 #include "program/progobj.h"
+#include "app/options.h"
+
+#include "defs/ENABLE_SCAN_SPLIT_FLAG.h"
 
 namespace {
 
@@ -50,6 +53,12 @@ static ChunkArrayIterator<ElementType> getData(const std::vector<typename series
 
 namespace series {
 
+// Operators can declare how a chunk's scan can be started before the previous chunk is done:
+//   static constexpr bool isAssociative = true: op(op(a, b), c) == op(a, op(b, c)), so a chunk can scan its own elements and fold in the carry at the end.
+//   RealType getCarryFactor() const: op(a, b) == getCarryFactor() * a + op(0, b), so the carry's contribution just decays along the chunk.
+// Either way the chunks of a long history are scanned in parallel, and only the cheap carry fix-up is left for when the previous chunk completes.
+// That rounds differently than scanning in order, and which way a chunk goes depends on thread timing, so results can differ in the last bits between runs.
+// Tests force the split way with --scan-split, see tests/scan.ts.
 template <typename ElementType, typename OperatorType, typename... ArgTypes>
 class ScannedSeries : public DataSeries<ElementType> {
 public:
@@ -63,23 +72,39 @@ public:
     Chunk<ElementType> *makeChunk(std::size_t chunkIndex) override {
         auto prevChunk = chunkIndex > 0 ? this->getChunk(chunkIndex - 1) : ChunkPtr<ElementType>::null();
         auto chunks = std::apply([chunkIndex](auto &... x){return std::make_tuple(x.getChunk(chunkIndex)...);}, args);
-        return this->constructChunk([this, prevChunk = std::move(prevChunk), chunks = std::move(chunks)](ElementType *dst, unsigned int computedCount) -> unsigned int {
+        return this->constructChunk([this, prevChunk = std::move(prevChunk), chunks = std::move(chunks), localCount = 0u](ElementType *dst, unsigned int computedCount) mutable -> unsigned int {
+            unsigned int endCount = std::apply([](auto &... x){return std::min({x->getComputedCount()...});}, chunks);
+
             ElementType value;
             if (computedCount > 0) {
                 value = dst[computedCount - 1];
             } else {
                 if (prevChunk.has()) {
-                    if (prevChunk->getComputedCount() == CHUNK_SIZE) {
-                        value = prevChunk->getElement(CHUNK_SIZE - 1);
-                    } else {
+                    bool isPrevDone = prevChunk->getComputedCount() == CHUNK_SIZE;
+                    if constexpr (isAssociative || isLinear) {
+                        if (!isPrevDone || shouldSplit()) {
+                            // Nobody reads dst before we return a count, so it holds the local scan in the meantime
+                            scanLocal(dst, localCount, endCount, std::get<0>(chunks));
+                            localCount = endCount;
+                        }
+                    }
+                    if (!isPrevDone) {
                         return 0;
                     }
+                    value = prevChunk->getElement(CHUNK_SIZE - 1);
                 } else {
                     value = initialValue;
                 }
+
+                if constexpr (isAssociative || isLinear) {
+                    if (localCount > 0) {
+                        applyCarry(dst, localCount, value);
+                        computedCount = localCount;
+                        value = dst[computedCount - 1];
+                    }
+                }
             }
 
-            unsigned int endCount = std::apply([](auto &... x){return std::min({x->getComputedCount()...});}, chunks);
             for (std::size_t i = computedCount; i < endCount; i++) {
                 value = std::apply([this, value, i](auto &... s){return op(value, s->getElement(i)...);}, chunks);
                 dst[i] = value;
@@ -89,11 +114,65 @@ public:
         });
     }
 
+    bool hasCarry() const override {
+        return true;
+    }
+
 private:
+    static constexpr bool isAssociative = sizeof...(ArgTypes) == 1 && requires { requires OperatorType::isAssociative; };
+    static constexpr bool isLinear = sizeof...(ArgTypes) == 1 && requires (const OperatorType &op) { op.getCarryFactor(); };
+
     OperatorType op;
 
     ElementType initialValue;
     std::tuple<ArgTypes...> args;
+
+    static bool shouldSplit() {
+#if ENABLE_SCAN_SPLIT_FLAG
+        return app::Options::getInstance().scanSplit;
+#else
+        return false;
+#endif
+    }
+
+    template <typename ChunkPtrType>
+    void scanLocal(ElementType *dst, unsigned int begin, unsigned int end, const ChunkPtrType &chunk) const {
+        if (begin == end) {
+            return;
+        }
+
+        ElementType value;
+        if constexpr (isAssociative) {
+            // The first element goes in as is, applyCarry() passes it through op
+            if (begin == 0) {
+                dst[0] = chunk->getElement(0);
+                begin = 1;
+            }
+            value = dst[begin - 1];
+        } else {
+            value = begin > 0 ? dst[begin - 1] : static_cast<ElementType>(0);
+        }
+
+        for (unsigned int i = begin; i < end; i++) {
+            value = op(value, chunk->getElement(i));
+            dst[i] = value;
+        }
+    }
+
+    void applyCarry(ElementType *dst, unsigned int count, ElementType carry) const {
+        if constexpr (isAssociative) {
+            for (unsigned int i = 0; i < count; i++) {
+                dst[i] = op(carry, dst[i]);
+            }
+        } else {
+            ElementType factor = op.getCarryFactor();
+            ElementType term = op(carry, static_cast<ElementType>(0));
+            for (unsigned int i = 0; i < count; i++) {
+                dst[i] += term;
+                term *= factor;
+            }
+        }
+    }
 };
 
 }
@@ -0,0 +1,14 @@
+#version 410 core
+
+#defines
+
+layout(location = POSITION_Y_LOCATION) in ELEMENT_TYPE position_y;
+
+uniform vec2 offset;
+uniform vec2 scale;
+uniform int firstVertex;
+
+void main(void) {
+    // A triangle strip that alternates between the bottom and top edge, so two vertices per x
+    gl_Position = vec4(offset + vec2((gl_VertexID - firstVertex) / 2, position_y) * scale, 0.0, 1.0);
+}
@@ -6,7 +6,8 @@ layout(location = POSITION_Y_LOCATION) in ELEMENT_TYPE position_y;
 
 uniform vec2 offset;
 uniform vec2 scale;
+uniform int firstVertex;
 
 void main(void) {
-    gl_Position = vec4(offset + vec2(gl_VertexID, position_y) * scale, 0.0, 1.0);
+    gl_Position = vec4(offset + vec2(gl_VertexID - firstVertex, position_y) * scale, 0.0, 1.0);
 }
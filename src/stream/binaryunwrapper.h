@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "log.h"
+
+#include "app/appcontext.h"
+
+namespace stream {
+
+// Decodes the records of a length-prefixed binary stream, see FilePoller::Framing::LengthPrefixed.
+// Everything is native-endian. Each record starts with a one byte type:
+//   'H': the column names. A uint32 count, then for each column a uint16 length and the name's bytes.
+//   'r': a block of rows of float32 values. A uint32 row count, then the values row by row.
+//   'R': the same with float64 values.
+//   'c': a block of rows of float32 values, laid out column by column. A uint32 row count, then each column's values.
+//   'C': the same with float64 values.
+// Blocks must follow a header and contain every column in header order. Missing values are NaN.
+template <typename ReceiverClass>
+class BinaryUnwrapper {
+public:
+    BinaryUnwrapper(app::AppContext &context)
+        : context(context)
+    {}
+
+    void recvLine(const char *data, std::size_t size) {
+        if (size == 0) {
+            SPDLOG_WARN("Discarding empty binary record");
+            return;
+        }
+
+        const char *end = data + size;
+        char type = *data++;
+        switch (type) {
+            case 'H': recvHeader(data, end); break;
+            case 'r': recvBlock<float>(data, end, true); break;
+            case 'R': recvBlock<double>(data, end, true); break;
+            case 'c': recvBlock<float>(data, end, false); break;
+            case 'C': recvBlock<double>(data, end, false); break;
+            default:
+                SPDLOG_WARN("Discarding binary record with unknown type {}", static_cast<int>(type));
+                break;
+        }
+    }
+
+    bool shouldYield() {
+        return context.get<ReceiverClass>().shouldYield();
+    }
+
+    void yield() {
+        context.get<ReceiverClass>().yield();
+    }
+
+    void end() {
+        context.get<ReceiverClass>().end();
+    }
+
+private:
+    app::AppContext &context;
+
+    template <typename ValueType>
+    static bool readValue(const char *&data, const char *end, ValueType &dst) {
+        if (static_cast<std::size_t>(end - data) < sizeof(ValueType)) {
+            return false;
+        }
+        std::memcpy(&dst, data, sizeof(ValueType));
+        data += sizeof(ValueType);
+        return true;
+    }
+
+    void recvHeader(const char *data, const char *end) {
+        std::uint32_t numColumns;
+        if (!readValue(data, end, numColumns)) {
+            SPDLOG_WARN("Discarding truncated binary header");
+            return;
+        }
+
+        std::vector<std::string> names;
+        names.reserve(numColumns);
+        for (std::uint32_t i = 0; i < numColumns; i++) {
+            std::uint16_t nameSize;
+            if (!readValue(data, end, nameSize) || static_cast<std::size_t>(end - data) < nameSize) {
+                SPDLOG_WARN("Discarding truncated binary header");
+                return;
+            }
+            names.emplace_back(data, nameSize);
+            data += nameSize;
+        }
+
+        context.get<ReceiverClass>().recvColumns(names);
+    }
+
+    template <typename ValueType>
+    void recvBlock(const char *data, const char *end, bool rowMajor) {
+        std::uint32_t numRows;
+        if (!readValue(data, end, numRows)) {
+            SPDLOG_WARN("Discarding truncated binary block");
+            return;
+        }
+
+        ReceiverClass &receiver = context.get<ReceiverClass>();
+        std::size_t numColumns = receiver.getNumColumns();
+        if (numColumns == 0) {
+            // Otherwise an empty block would still move the row index along
+            SPDLOG_WARN("Discarding binary block of {} rows, since no header with columns came before it", numRows);
+            return;
+        }
+
+        std::size_t blockSize = numRows * numColumns * sizeof(ValueType);
+        if (static_cast<std::size_t>(end - data) != blockSize) {
+            SPDLOG_WARN("Discarding binary block of {} bytes, expected {} rows of {} columns", end - data, numRows, numColumns);
+            return;
+        }
+
+        if (rowMajor) {
+            receiver.template recvBlock<ValueType>(data, numRows, numColumns * sizeof(ValueType), sizeof(ValueType));
+        } else {
+            receiver.template recvBlock<ValueType>(data, numRows, sizeof(ValueType), numRows * sizeof(ValueType));
+        }
+    }
+};
+
+}
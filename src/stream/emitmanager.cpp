@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <stdio.h>
+#include <utility>
 
 #include "rapidjson/document.h"
 #include "rapidjson/stringbuffer.h"
@@ -14,6 +15,11 @@
 #include "series/chunkbase.h"
 
 #include "defs/ENABLE_PMUOI_FLAG.h"
+#include "defs/ENABLE_CHUNK_MULTITHREADING.h"
+
+#if ENABLE_CHUNK_MULTITHREADING
+#include "util/taskscheduler.h"
+#endif
 
 namespace stream {
 
@@ -24,7 +30,14 @@ EmitManager::EmitManager(app::AppContext &context)
 }
 
 EmitManager::~EmitManager() {
+#if ENABLE_CHUNK_MULTITHREADING
+    // Emitting can create chunks that get computed on worker threads, so keep going until they've all finished
+    do {
+        emit();
+    } while (context.get<util::TaskScheduler<series::ChunkBase>>().waitIdle());
+#else
     emit();
+#endif
 }
 
 void EmitManager::clearEmitters() {
@@ -60,12 +73,21 @@ void EmitManager::tick(app::TickerContext &tickerContext) {
 }
 
 void EmitManager::emit() {
-    switch (app::Options::getInstance().emitFormat) {
-        case app::Options::EmitFormat::Json: emitJson(); break;
-        case app::Options::EmitFormat::Floats: emitBinary<float>(); break;
-        case app::Options::EmitFormat::Doubles: emitBinary<double>(); break;
-        default: assert(false);
-    }
+    // Every emitter asks for its chunks inside one wave, so chunks that share work (like the convolutions of a ConvBank) all exist before any of them runs.
+    // Chunks that were only queued run when the wave closes, so go around again until a pass gets nothing more out.
+    bool isFirstPass = true;
+    std::size_t prevEmitIndex;
+    do {
+        prevEmitIndex = nextEmitIndex;
+
+        series::ChunkBase::Wavefront wavefront;
+        switch (app::Options::getInstance().emitFormat) {
+            case app::Options::EmitFormat::Json: emitJson(); break;
+            case app::Options::EmitFormat::Floats: emitBinary<float>(); break;
+            case app::Options::EmitFormat::Doubles: emitBinary<double>(); break;
+            default: assert(false);
+        }
+    } while (std::exchange(isFirstPass, false) || nextEmitIndex != prevEmitIndex);
 }
 
 void EmitManager::emitJson() {
@@ -78,10 +100,13 @@ void EmitManager::emitJson() {
 
         writer.StartObject();
 
+        bool isReady = true;
         for (SeriesEmitter *emitter : curEmitters) {
+            // Keeps going after one isn't ready, so the rest ask for their chunks in the same wave
             std::pair<bool, double> res = emitter->getValue(nextEmitIndex);
-            if (!res.first) {
-                return;
+            isReady &= res.first;
+            if (!isReady) {
+                continue;
             }
 
             writer.Key(emitter->getKey().data(), emitter->getKey().size());
@@ -92,6 +117,9 @@ void EmitManager::emitJson() {
             }
         }
 
+        if (!isReady) {
+            return;
+        }
         writer.EndObject();
 
         std::cout << buffer.GetString() << std::endl;
@@ -108,13 +136,16 @@ void EmitManager::emitBinary() {
     while (!curEmitters.empty()) {
         buffer.clear();
 
+        bool isReady = true;
         for (SeriesEmitter *emitter : curEmitters) {
             std::pair<bool, RealType> res = emitter->getValue(nextEmitIndex);
-            if (!res.first) {
-                return;
+            isReady &= res.first;
+            if (isReady) {
+                buffer.push_back(res.second);
             }
-
-            buffer.push_back(res.second);
+        }
+        if (!isReady) {
+            return;
         }
 
         fwrite(buffer.data(), sizeof(RealType), buffer.size(), stdout);
@@ -1,7 +1,12 @@
 #include "filepoller.h"
 
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <csignal>
 
 #include "log.h"
@@ -81,6 +86,11 @@ void FilePoller::tick(app::TickerContext &tickerContext) {
 
             msg.dispatch(context, msg.data, msg.size);
 
+            if (file.shouldYieldDispatcher(context)) {
+                // Let the batch propagate and emit before it gets too old
+                break;
+            }
+
 #if FILEPOLLER_TICK_TIMEOUT_MS
             if (std::chrono::steady_clock::now() > timeout) {
                 break;
@@ -93,14 +103,49 @@ void FilePoller::tick(app::TickerContext &tickerContext) {
 }
 
 void FilePoller::loop(FilePoller *filePoller, File &file) {
-    static constexpr std::size_t initialChunkSize = 1024 * 1024;
-
     int fileNo = file.path != "-" ? open(file.path.data(), O_RDONLY) : STDIN_FILENO;
     if (fileNo == -1) {
         SPDLOG_ERROR("Syscall open() returned -1 and set errno == {}", errno);
         return;
     }
 
+    struct stat st;
+    bool mapped = false;
+    if (file.path != "-" && fstat(fileNo, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        mapped = loopMapped(filePoller, file, fileNo, st.st_size);
+    }
+    if (!mapped) {
+        loopRead(filePoller, file, fileNo);
+    }
+
+    if (file.path != "-") {
+        close(fileNo);
+    }
+
+    file.messages.enqueue(Message(file.endDispatcher, 0, 0));
+}
+
+bool FilePoller::loopMapped(FilePoller *filePoller, File &file, int fileNo, std::size_t size) {
+    // Records point straight into the mapping, so there's nothing to copy or allocate per record
+    void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileNo, 0);
+    if (map == MAP_FAILED) {
+        SPDLOG_WARN("Couldn't mmap {} (errno == {}), falling back to read()", file.path, errno);
+        return false;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    // Like read(), this stops at the end of the file as it was when it was opened
+    const char *data = static_cast<const char *>(map);
+    std::size_t queuePendingSize = 0;
+    splitRecords(filePoller, file, data, 0, size, queuePendingSize);
+
+    file.messages.enqueue(Message(&unmapper, data, size));
+    return true;
+}
+
+void FilePoller::loopRead(FilePoller *filePoller, File &file, int fileNo) {
+    static constexpr std::size_t initialChunkSize = 1024 * 1024;
+
     std::size_t chunkSize = initialChunkSize;
     char *data = new char[chunkSize];
     std::size_t lineStart = 0;
@@ -121,20 +166,8 @@ void FilePoller::loop(FilePoller *filePoller, File &file) {
         }
         assert(readBytes > 0);
 
-        for (std::size_t end = index + readBytes; index < end; index++) {
-            if (data[index] == '\n') {
-                file.messages.enqueue(Message(file.lineDispatcher, data + lineStart, index - lineStart));
-                lineStart = index + 1;
-
-                queuePendingSize++;
-                if (queuePendingSize > FILEPOLLER_MAX_QUEUE_SIZE) {
-                    queuePendingSize = file.messages.size_approx();
-                    if (queuePendingSize > FILEPOLLER_MAX_QUEUE_SIZE) {
-                        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                    }
-                }
-            }
-        }
+        index += readBytes;
+        lineStart = splitRecords(filePoller, file, data, lineStart, index, queuePendingSize);
 
         assert(index <= chunkSize);
         if (index == chunkSize) {
@@ -157,12 +190,47 @@ void FilePoller::loop(FilePoller *filePoller, File &file) {
     }
 
     file.messages.enqueue(Message(&freeer, data, 0));
+}
 
-    if (file.path != "-") {
-        close(fileNo);
+std::size_t FilePoller::splitRecords(FilePoller *filePoller, File &file, const char *data, std::size_t begin, std::size_t end, std::size_t &queuePendingSize) {
+    while (filePoller->running) {
+        const char *recordData;
+        std::size_t recordSize;
+
+        if (file.framing == Framing::Lines) {
+            const char *newline = static_cast<const char *>(std::memchr(data + begin, '\n', end - begin));
+            if (!newline) {
+                break;
+            }
+            recordData = data + begin;
+            recordSize = newline - recordData;
+            begin += recordSize + 1;
+        } else {
+            if (end - begin < sizeof(std::uint32_t)) {
+                break;
+            }
+            std::uint32_t prefix;
+            std::memcpy(&prefix, data + begin, sizeof(prefix));
+            if (end - begin - sizeof(prefix) < prefix) {
+                break;
+            }
+            recordData = data + begin + sizeof(prefix);
+            recordSize = prefix;
+            begin += sizeof(prefix) + recordSize;
+        }
+
+        file.messages.enqueue(Message(file.lineDispatcher, recordData, recordSize));
+
+        queuePendingSize++;
+        if (queuePendingSize > FILEPOLLER_MAX_QUEUE_SIZE) {
+            queuePendingSize = file.messages.size_approx();
+            if (queuePendingSize > FILEPOLLER_MAX_QUEUE_SIZE) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+        }
     }
 
-    file.messages.enqueue(Message(file.endDispatcher, 0, 0));
+    return begin;
 }
 
 }
@@ -2,6 +2,7 @@
 
 #include <deque>
 #include <thread>
+#include <sys/mman.h>
 
 #include "readerwriterqueue/readerwriterqueue.h"
 
@@ -17,12 +18,21 @@ public:
     FilePoller(app::AppContext &context);
     ~FilePoller();
 
+    enum class Framing {
+        // Records are separated by newlines
+        Lines,
+        // Each record is preceded by its size as a native-endian uint32
+        LengthPrefixed,
+    };
+
     // Only one file should be blocking; we want it to be the most important one because it'll respond most quickly to new records
     template <typename ReceiverClass>
-    void addFile(const std::string &path, bool blocking) {
+    void addFile(const std::string &path, bool blocking, Framing framing = Framing::Lines) {
         File &file = files.emplace_back();
         file.path = path;
+        file.framing = framing;
         file.lineDispatcher = &dispatchLine<ReceiverClass>;
+        file.shouldYieldDispatcher = &dispatchShouldYield<ReceiverClass>;
         file.yieldDispatcher = &dispatchYield<ReceiverClass>;
         file.endDispatcher = &dispatchEnd<ReceiverClass>;
         file.thread = std::thread(loop, this, std::ref(file));
@@ -50,7 +60,9 @@ private:
 
     struct File {
         std::string path;
+        Framing framing;
         void (*lineDispatcher)(app::AppContext &context, const char *data, std::size_t size);
+        bool (*shouldYieldDispatcher)(app::AppContext &context);
         void (*yieldDispatcher)(app::AppContext &context);
         void (*endDispatcher)(app::AppContext &context, const char *data, std::size_t size);
 
@@ -71,6 +83,11 @@ private:
         context.get<ReceiverClass>().recvLine(data, size);
     }
 
+    template <typename ReceiverClass>
+    static bool dispatchShouldYield(app::AppContext &context) {
+        return context.get<ReceiverClass>().shouldYield();
+    }
+
     template <typename ReceiverClass>
     static void dispatchYield(app::AppContext &context) {
         context.get<ReceiverClass>().yield();
@@ -89,7 +106,17 @@ private:
         delete[] data;
     }
 
+    static void unmapper(app::AppContext &context, const char *data, std::size_t size) {
+        (void) context;
+        munmap(const_cast<char *>(data), size);
+    }
+
     static void loop(FilePoller *filePoller, File &threadCtx);
+    static bool loopMapped(FilePoller *filePoller, File &file, int fileNo, std::size_t size);
+    static void loopRead(FilePoller *filePoller, File &file, int fileNo);
+
+    // Enqueues every complete record in [begin, end), and returns where the first incomplete one starts
+    static std::size_t splitRecords(FilePoller *filePoller, File &file, const char *data, std::size_t begin, std::size_t end, std::size_t &queuePendingSize);
 };
 
 }
@@ -1,5 +1,7 @@
 #include "inputmanager.h"
 
+#include <algorithm>
+
 #include "app/appcontext.h"
 #include "program/resolver.h"
 #include "log.h"
@@ -30,32 +32,55 @@ void InputManager::recvRecord(const rapidjson::Document &row) {
                 continue;
         }
 
-        series::InputSeries<INPUT_SERIES_ELEMENT_TYPE> *&in = inputs[key];
-        if (!in) {
-            std::vector<program::ProgObj> args {
-                program::ProgObj(key)
-            };
-            program::ProgObj po = context.get<program::Resolver>().call("input", args);
-            series::DataSeries<INPUT_SERIES_ELEMENT_TYPE> *ds = std::get<series::DataSeries<INPUT_SERIES_ELEMENT_TYPE> *>(po);
-            in = dynamic_cast<series::InputSeries<INPUT_SERIES_ELEMENT_TYPE> *>(ds);
-
-            SPDLOG_INFO("Received new input record entry key {}", key);
-        }
-
-        in->set(index, static_cast<INPUT_SERIES_ELEMENT_TYPE>(value));
+        getInput(key)->set(index, static_cast<INPUT_SERIES_ELEMENT_TYPE>(value));
     }
 
+    markPending();
     index++;
 
 #if PROPAGATE_EVERY_ROW
-    propagate();
+    if (!isAdaptive()) {
+        propagate();
+    }
 #endif
 }
 
+void InputManager::recvColumns(const std::vector<std::string> &names) {
+    columns.clear();
+    for (const std::string &name : names) {
+        columns.push_back(getInput(name));
+    }
+}
+
+series::InputSeries<INPUT_SERIES_ELEMENT_TYPE> *InputManager::getInput(const std::string &key) {
+    series::InputSeries<INPUT_SERIES_ELEMENT_TYPE> *&in = inputs[key];
+    if (!in) {
+        std::vector<program::ProgObj> args {
+            program::ProgObj(key)
+        };
+        program::ProgObj po = context.get<program::Resolver>().call("input", args);
+        series::DataSeries<INPUT_SERIES_ELEMENT_TYPE> *ds = std::get<series::DataSeries<INPUT_SERIES_ELEMENT_TYPE> *>(po);
+        in = dynamic_cast<series::InputSeries<INPUT_SERIES_ELEMENT_TYPE> *>(ds);
+
+        SPDLOG_INFO("Received new input record entry key {}", key);
+    }
+    return in;
+}
+
+bool InputManager::shouldYield() const {
+    if (!isAdaptive() || index == propagatedIndex) {
+        return false;
+    }
+
+    std::chrono::duration<float> waited = std::chrono::steady_clock::now() - pendingSince;
+    float predicted = waited.count() + propagateSecsPerRow * (index - propagatedIndex);
+    return predicted >= app::Options::getInstance().propagateLatencyUs * 1e-6f * latencySlack;
+}
+
 void InputManager::yield() {
-#if !PROPAGATE_EVERY_ROW
-    propagate();
-#endif
+    if (!PROPAGATE_EVERY_ROW || isAdaptive()) {
+        propagate();
+    }
 }
 
 void InputManager::end() {
@@ -66,8 +91,31 @@ void InputManager::end() {
 }
 
 void InputManager::propagate() {
-    for (const std::pair<std::string, series::InputSeries<INPUT_SERIES_ELEMENT_TYPE> *> entry : inputs) {
-        entry.second->propagateUntil(index);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    {
+        // One wave for all inputs, so a series that reads several of them only runs once
+        series::ChunkBase::Wavefront wavefront;
+        for (const std::pair<std::string, series::InputSeries<INPUT_SERIES_ELEMENT_TYPE> *> entry : inputs) {
+            entry.second->propagateUntil(index);
+        }
+    }
+
+    std::size_t numRows = index - propagatedIndex;
+    propagatedIndex = index;
+    if (!isAdaptive() || numRows == 0) {
+        return;
+    }
+
+    std::chrono::steady_clock::time_point finish = std::chrono::steady_clock::now();
+    std::chrono::duration<float> duration = finish - start;
+    propagateSecsPerRow += (duration.count() / numRows - propagateSecsPerRow) * 0.1f;
+
+    std::chrono::duration<float> latency = finish - pendingSince;
+    if (latency.count() > app::Options::getInstance().propagateLatencyUs * 1e-6f) {
+        latencySlack = std::max(0.05f, latencySlack * 0.9f);
+    } else {
+        latencySlack = std::min(1.0f, latencySlack + 0.001f);
     }
 }
 
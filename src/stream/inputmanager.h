@@ -1,12 +1,17 @@
 #pragma once
 
 #include <unordered_map>
+#include <vector>
+#include <string>
+#include <chrono>
 
 #include "rapidjson/document.h"
 
+#include "app/options.h"
 #include "series/type/inputseries.h"
 
 #include "defs/INPUT_SERIES_ELEMENT_TYPE.h"
+#include "defs/PROPAGATE_EVERY_ROW.h"
 
 namespace stream {
 
@@ -15,6 +20,33 @@ public:
     InputManager(app::AppContext &context);
 
     void recvRecord(const rapidjson::Document &row);
+
+    // Binary input declares its columns once, so blocks of rows can skip the lookups by name
+    void recvColumns(const std::vector<std::string> &names);
+    std::size_t getNumColumns() const {
+        return columns.size();
+    }
+
+    // The value of column c in row r is at data + r * rowStride + c * colStride
+    template <typename ValueType>
+    void recvBlock(const char *data, std::size_t numRows, std::size_t rowStride, std::size_t colStride) {
+        for (std::size_t c = 0; c < columns.size(); c++) {
+            columns[c]->setBlock<ValueType>(index, data + c * colStride, numRows, rowStride);
+        }
+
+        markPending();
+        index += numRows;
+
+#if PROPAGATE_EVERY_ROW
+        if (!isAdaptive()) {
+            propagate();
+        }
+#endif
+    }
+
+    // With --propagate-latency-us, the FilePoller asks this after each record whether to stop and let the batch propagate.
+    // Bursts then get batched for throughput, while a trickle propagates as soon as the queue runs dry.
+    bool shouldYield() const;
     void yield();
     void end();
 
@@ -25,11 +57,30 @@ private:
 
     std::size_t index = 0;
 
+    // Adaptive batching, see shouldYield()
+    std::size_t propagatedIndex = 0;
+    std::chrono::steady_clock::time_point pendingSince;
+    float propagateSecsPerRow = 0.0f;
+    // Multiplies the latency target, backing off when a batch misses it and creeping back when they don't, which settles around 1% misses
+    float latencySlack = 1.0f;
+
     std::unordered_map<std::string, series::InputSeries<INPUT_SERIES_ELEMENT_TYPE> *> inputs;
+    std::vector<series::InputSeries<INPUT_SERIES_ELEMENT_TYPE> *> columns;
 
     bool running = true;
 
+    series::InputSeries<INPUT_SERIES_ELEMENT_TYPE> *getInput(const std::string &key);
     void propagate();
+
+    static bool isAdaptive() {
+        return app::Options::getInstance().propagateLatencyUs != 0;
+    }
+
+    void markPending() {
+        if (isAdaptive() && index == propagatedIndex) {
+            pendingSince = std::chrono::steady_clock::now();
+        }
+    }
 };
 
 }
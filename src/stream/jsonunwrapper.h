@@ -27,6 +27,10 @@ public:
         }
     }
 
+    bool shouldYield() {
+        return context.get<ReceiverClass>().shouldYield();
+    }
+
     void yield() {
         context.get<ReceiverClass>().yield();
     }
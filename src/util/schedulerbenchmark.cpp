@@ -0,0 +1,118 @@
+#include "schedulerbenchmark.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+#include "util/taskscheduler.h"
+#include "log.h"
+
+namespace {
+
+class BenchmarkTask;
+
+struct BenchmarkState {
+    util::TaskScheduler<BenchmarkTask> *scheduler;
+    BenchmarkTask *tasks;
+    std::size_t numTasks;
+    unsigned int workPerTask;
+
+    std::atomic<std::size_t> remaining;
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool done = false;
+};
+
+class BenchmarkTask {
+public:
+    void exec() {
+        // Roughly the cost of a small chunk computation
+        double acc = index;
+        for (unsigned int i = 0; i < state->workPerTask; i++) {
+            acc = std::sin(acc) + 1.0;
+        }
+        result = acc;
+
+        // Children form an implicit binary tree, spawned from inside the worker like chunk notifications are
+        for (std::size_t child = index * 2 + 1; child <= index * 2 + 2 && child < state->numTasks; child++) {
+            state->scheduler->addTask(&state->tasks[child]);
+        }
+
+        if (state->remaining.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            (void) lock;
+            state->done = true;
+            state->cond.notify_all();
+        }
+    }
+
+    void taskDone() {
+        // The tasks live as long as runOnce(), so there's nothing to let go of
+    }
+
+    float getOrdering() const {
+        // Shallower tasks have more work depending on them
+        return -std::log2(static_cast<float>(index + 1));
+    }
+
+    BenchmarkState *state;
+    std::size_t index;
+    double result;
+};
+
+std::chrono::duration<double> runOnce(app::AppContext &context, std::size_t numThreads, std::size_t numTasks, unsigned int workPerTask) {
+    util::TaskScheduler<BenchmarkTask> scheduler(context, numThreads);
+
+    BenchmarkState state;
+    state.scheduler = &scheduler;
+    state.numTasks = numTasks;
+    state.workPerTask = workPerTask;
+    state.remaining = numTasks;
+
+    std::vector<BenchmarkTask> tasks(numTasks);
+    for (std::size_t i = 0; i < numTasks; i++) {
+        tasks[i].state = &state;
+        tasks[i].index = i;
+    }
+    state.tasks = tasks.data();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    scheduler.addTask(&tasks[0]);
+
+    {
+        std::unique_lock<std::mutex> lock(state.mutex);
+        while (!state.done) {
+            state.cond.wait(lock);
+        }
+    }
+
+    return std::chrono::steady_clock::now() - start;
+}
+
+}
+
+namespace util {
+
+void runSchedulerBenchmark(app::AppContext &context, std::size_t maxThreads) {
+    static constexpr std::size_t numTasks = 1 << 16;
+    static constexpr unsigned int workPerTask = 1000;
+
+    // Warm up the caches and the cpu clock
+    runOnce(context, 1, numTasks / 16, workPerTask);
+
+    std::chrono::duration<double> base;
+    for (std::size_t numThreads = 1; numThreads <= maxThreads; numThreads++) {
+        std::chrono::duration<double> elapsed = runOnce(context, numThreads, numTasks, workPerTask);
+        if (numThreads == 1) {
+            base = elapsed;
+        }
+
+        double speedup = base / elapsed;
+        SPDLOG_INFO("Scheduler benchmark: threads={} elapsed={:.3f}s tasks/s={:.0f} speedup={:.2f} efficiency={:.2f}", numThreads, elapsed.count(), numTasks / elapsed.count(), speedup, speedup / numThreads);
+    }
+}
+
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdlib>
+
+namespace app { class AppContext; }
+
+namespace util {
+
+// Runs a synthetic task tree through TaskScheduler with 1..maxThreads workers and logs the speedup
+void runSchedulerBenchmark(app::AppContext &context, std::size_t maxThreads);
+
+}
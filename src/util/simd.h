@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <complex>
+#include <type_traits>
+
+// Vector width follows whatever -march enables; the compiler lowers these to AVX-512, AVX2, SSE or NEON.
+#if defined(__AVX512F__)
+#define UTIL_SIMD_BYTES 64
+#elif defined(__AVX__)
+#define UTIL_SIMD_BYTES 32
+#else
+#define UTIL_SIMD_BYTES 16
+#endif
+
+namespace util {
+
+template <typename ElementType>
+struct Simd {
+    static_assert(std::is_same<ElementType, float>::value || std::is_same<ElementType, double>::value, "Simd only supports float and double");
+
+    typedef typename std::conditional<sizeof(ElementType) == 4, std::int32_t, std::int64_t>::type IntType;
+
+    static constexpr std::size_t width = UTIL_SIMD_BYTES / sizeof(ElementType);
+
+    typedef ElementType Vec __attribute__((vector_size(UTIL_SIMD_BYTES)));
+    typedef IntType Mask __attribute__((vector_size(UTIL_SIMD_BYTES)));
+
+    static Vec load(const ElementType *src) {
+        Vec res;
+        std::memcpy(&res, src, sizeof(Vec));
+        return res;
+    }
+
+    static void store(ElementType *dst, Vec value) {
+        std::memcpy(dst, &value, sizeof(Vec));
+    }
+
+    // For the tail of an array, so it goes through the same vector code as the rest and each element comes out the same either way.
+    // The lanes past count are zero, and their results get dropped.
+    static Vec loadPartial(const ElementType *src, std::size_t count) {
+        Vec res = broadcast(0);
+        std::memcpy(&res, src, count * sizeof(ElementType));
+        return res;
+    }
+
+    static void storePartial(ElementType *dst, Vec value, std::size_t count) {
+        std::memcpy(dst, &value, count * sizeof(ElementType));
+    }
+
+    static Vec broadcast(ElementType value) {
+        Vec res;
+        for (std::size_t i = 0; i < width; i++) {
+            res[i] = value;
+        }
+        return res;
+    }
+
+    // Comparisons give all-ones lanes for true, so these take whatever mask type the comparison produced
+    template <typename MaskType>
+    static Vec select(MaskType mask, Vec a, Vec b) {
+        return (Vec) (((Mask) a & (Mask) mask) | ((Mask) b & ~(Mask) mask));
+    }
+
+    // Turns a comparison result into 1.0 and 0.0, like the scalar bool -> RealType conversion
+    template <typename MaskType>
+    static Vec fromMask(MaskType mask) {
+        return (Vec) ((Mask) mask & (Mask) broadcast(1.0));
+    }
+
+    static Mask isNan(Vec a) {
+        return (Mask) (a != a);
+    }
+
+    template <typename FuncType>
+    static Vec map(Vec a, FuncType func) {
+        Vec res;
+        for (std::size_t i = 0; i < width; i++) {
+            res[i] = func(a[i]);
+        }
+        return res;
+    }
+};
+
+template <typename Type>
+struct SimdElement {
+    typedef Type type;
+};
+template <>
+struct SimdElement<Simd<float>::Vec> {
+    typedef float type;
+};
+template <>
+struct SimdElement<Simd<double>::Vec> {
+    typedef double type;
+};
+
+// dst = a * b (or dst += a * b) over interleaved complex arrays.
+// Spelled out on the real and imaginary parts, which the SLP vectorizer turns into lane swaps and addsubs;
+// std::complex's operator* would also drag in the inf/nan handling of __muldc3 in builds without -ffast-math.
+template <bool accumulate, typename ElementType>
+void simdComplexMultiply(std::complex<ElementType> *__restrict dst, const std::complex<ElementType> *__restrict a, const std::complex<ElementType> *__restrict b, std::size_t count) {
+    ElementType *d = reinterpret_cast<ElementType *>(dst);
+    const ElementType *x = reinterpret_cast<const ElementType *>(a);
+    const ElementType *y = reinterpret_cast<const ElementType *>(b);
+
+    for (std::size_t i = 0; i < count * 2; i += 2) {
+        ElementType re = x[i] * y[i] - x[i + 1] * y[i + 1];
+        ElementType im = x[i] * y[i + 1] + x[i + 1] * y[i];
+        if constexpr (accumulate) {
+            d[i] += re;
+            d[i + 1] += im;
+        } else {
+            d[i] = re;
+            d[i + 1] = im;
+        }
+    }
+}
+
+// Lets ops that capture a scalar work for both scalar and vector arguments
+template <typename Type>
+Type simdBroadcast(typename SimdElement<Type>::type value) {
+    if constexpr (std::is_same<Type, typename SimdElement<Type>::type>::value) {
+        return value;
+    } else {
+        return Simd<typename SimdElement<Type>::type>::broadcast(value);
+    }
+}
+
+}
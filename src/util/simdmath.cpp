@@ -0,0 +1,71 @@
+#include "simdmath.h"
+
+#include <cassert>
+#include <vector>
+
+#include "util/testrunner.h"
+
+namespace {
+
+// Checks a kernel against libm, lane by lane, on a sweep of [lo, hi] plus the special values
+template <typename ElementType, typename VecFuncType, typename FuncType>
+void checkKernel(VecFuncType vecFunc, FuncType func, ElementType lo, ElementType hi) {
+    typedef util::Simd<ElementType> S;
+    typedef std::numeric_limits<ElementType> L;
+
+    // A little over what the header promises, since libm isn't exact either
+    static constexpr double tolerance = sizeof(ElementType) == 4 ? 4e-7 : 1e-14;
+    static constexpr unsigned int numSteps = 4096;
+
+    std::vector<ElementType> xs = {L::quiet_NaN(), L::infinity(), -L::infinity(), 0, -static_cast<ElementType>(0), L::denorm_min(), -L::denorm_min(), L::min(), -L::min(), L::max(), L::lowest(), 1, -1};
+    for (unsigned int i = 0; i <= numSteps; i++) {
+        xs.push_back(lo + (hi - lo) * static_cast<ElementType>(i) / numSteps);
+    }
+    // Small magnitudes, where expm1 and tanh have to keep their relative accuracy
+    for (ElementType x = static_cast<ElementType>(1e-30); x < 1; x *= static_cast<ElementType>(1.37)) {
+        xs.push_back(x);
+        xs.push_back(-x);
+    }
+    while (xs.size() % S::width) {
+        xs.push_back(0);
+    }
+
+    for (std::size_t i = 0; i < xs.size(); i += S::width) {
+        typename S::Vec res = vecFunc(S::load(xs.data() + i));
+        for (std::size_t j = 0; j < S::width; j++) {
+            ElementType expected = func(xs[i + j]);
+            ElementType actual = res[j];
+
+            if (std::isnan(expected) || std::isinf(expected) || expected == 0) {
+                assert(std::isnan(actual) == std::isnan(expected));
+                assert(std::isnan(expected) || actual == expected);
+            } else if (std::fpclassify(expected) != FP_SUBNORMAL) {
+                double relErr = std::fabs(static_cast<double>(actual) - expected) / std::fabs(static_cast<double>(expected));
+                assert(relErr <= tolerance);
+                (void) relErr;
+            }
+        }
+    }
+}
+
+template <typename ElementType>
+void checkKernels() {
+    typedef typename util::Simd<ElementType>::Vec Vec;
+    typedef std::numeric_limits<ElementType> L;
+
+    checkKernel<ElementType>([](Vec x) {return util::simdExp<ElementType>(x);}, [](ElementType x) {return std::exp(x);}, -800, 800);
+    checkKernel<ElementType>([](Vec x) {return util::simdExpm1<ElementType>(x);}, [](ElementType x) {return std::expm1(x);}, -50, 90);
+    checkKernel<ElementType>([](Vec x) {return util::simdLog<ElementType>(x);}, [](ElementType x) {return std::log(x);}, 0, 4);
+    checkKernel<ElementType>([](Vec x) {return util::simdLog<ElementType>(x);}, [](ElementType x) {return std::log(x);}, 0, L::max());
+    checkKernel<ElementType>([](Vec x) {return util::simdTanh<ElementType>(x);}, [](ElementType x) {return std::tanh(x);}, -30, 30);
+    checkKernel<ElementType>([](Vec x) {return util::simdSigmoid<ElementType>(x);}, [](ElementType x) {return static_cast<ElementType>(1) / (static_cast<ElementType>(1) + std::exp(-x));}, -800, 800);
+}
+
+}
+
+static int _ = util::TestRunner::getInstance().registerTest([](app::AppContext &context) {
+    (void) context;
+
+    checkKernels<float>();
+    checkKernels<double>();
+});
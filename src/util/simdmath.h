@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+
+#include "util/simd.h"
+
+// Vectorized approximations of the transcendental functions.
+// Relative error is within about 1e-14 for double and 3e-7 for float, apart from results that are subnormal.
+// They're only used by the elementwise ops when ENABLE_APPROX_SIMD_MATH is set, and simdmath.cpp checks them against libm.
+
+namespace util {
+
+namespace simdmath {
+
+template <typename ElementType>
+struct Consts;
+
+template <>
+struct Consts<float> {
+    static constexpr unsigned int mantissaBits = 23;
+    static constexpr std::int32_t exponentBias = 127;
+    static constexpr float expMin = -103.97f;
+    static constexpr float expMax = 88.72f;
+    static constexpr float tanhSaturate = 9.0f;
+    static constexpr unsigned int expDegree = 7;
+    static constexpr unsigned int expm1Degree = 9;
+    static constexpr unsigned int logTerms = 5;
+};
+
+template <>
+struct Consts<double> {
+    static constexpr unsigned int mantissaBits = 52;
+    static constexpr std::int64_t exponentBias = 1023;
+    static constexpr double expMin = -745.13;
+    static constexpr double expMax = 709.78;
+    static constexpr double tanhSaturate = 19.0;
+    static constexpr unsigned int expDegree = 13;
+    static constexpr unsigned int expm1Degree = 15;
+    static constexpr unsigned int logTerms = 11;
+};
+
+template <typename ElementType>
+typename Simd<ElementType>::Vec pow2(typename Simd<ElementType>::Mask k) {
+    typedef Simd<ElementType> S;
+    typedef Consts<ElementType> C;
+    return (typename S::Vec) ((k + C::exponentBias) << C::mantissaBits);
+}
+
+// Sum of x^i / i! for i in [first, degree]
+template <typename ElementType, unsigned int first, unsigned int degree>
+typename Simd<ElementType>::Vec taylorExp(typename Simd<ElementType>::Vec x) {
+    ElementType coefs[degree + 1];
+    coefs[0] = 1;
+    for (unsigned int i = 1; i <= degree; i++) {
+        coefs[i] = coefs[i - 1] / i;
+    }
+
+    typename Simd<ElementType>::Vec res = Simd<ElementType>::broadcast(coefs[degree]);
+    for (unsigned int i = degree; i-- > first;) {
+        res = res * x + coefs[i];
+    }
+    for (unsigned int i = 0; i < first; i++) {
+        res = res * x;
+    }
+    return res;
+}
+
+}
+
+template <typename ElementType>
+typename Simd<ElementType>::Vec simdExp(typename Simd<ElementType>::Vec x) {
+    typedef Simd<ElementType> S;
+    typedef simdmath::Consts<ElementType> C;
+
+    static constexpr ElementType log2e = 1.44269504088896340736;
+    static constexpr ElementType ln2Hi = 6.93145751953125e-1;
+    static constexpr ElementType ln2Lo = 1.42860682030941723212e-6;
+
+    typename S::Mask tooSmall = x < C::expMin;
+    typename S::Mask tooBig = x > C::expMax;
+    x = S::select(tooSmall, S::broadcast(C::expMin), x);
+    x = S::select(tooBig, S::broadcast(C::expMax), x);
+
+    // Split x into k * ln(2) + r, with |r| <= ln(2) / 2
+    typename S::Vec y = x * log2e + static_cast<ElementType>(0.5);
+    typename S::Mask k = __builtin_convertvector(y, typename S::Mask);
+    typename S::Vec kf = __builtin_convertvector(k, typename S::Vec);
+    typename S::Mask kTooBig = (typename S::Mask) (kf > y);
+    k += kTooBig;
+    kf = __builtin_convertvector(k, typename S::Vec);
+    typename S::Vec r = x - kf * ln2Hi - kf * ln2Lo;
+
+    typename S::Vec res = simdmath::taylorExp<ElementType, 0, C::expDegree>(r);
+
+    // Scale in two steps so k can reach the subnormal and the top exponent ranges
+    typename S::Mask k1 = k >> 1;
+    res = res * simdmath::pow2<ElementType>(k1) * simdmath::pow2<ElementType>(k - k1);
+
+    res = S::select(tooSmall, S::broadcast(0), res);
+    res = S::select(tooBig, S::broadcast(std::numeric_limits<ElementType>::infinity()), res);
+    return res;
+}
+
+template <typename ElementType>
+typename Simd<ElementType>::Vec simdExpm1(typename Simd<ElementType>::Vec x) {
+    typedef Simd<ElementType> S;
+    typedef simdmath::Consts<ElementType> C;
+
+    // exp(x) - 1 cancels badly near zero, so use the series there
+    typename S::Vec small = simdmath::taylorExp<ElementType, 1, C::expm1Degree>(x);
+    typename S::Vec large = simdExp<ElementType>(x) - static_cast<ElementType>(1);
+    typename S::Vec absX = (typename S::Vec) ((typename S::Mask) x & ~(typename S::Mask) S::broadcast(-0.0));
+    return S::select((typename S::Mask) (absX < static_cast<ElementType>(0.5)), small, large);
+}
+
+template <typename ElementType>
+typename Simd<ElementType>::Vec simdLog(typename Simd<ElementType>::Vec x) {
+    typedef Simd<ElementType> S;
+    typedef simdmath::Consts<ElementType> C;
+    typedef typename S::IntType IntType;
+
+    static constexpr ElementType ln2 = 6.93147180559945309417e-1;
+    static constexpr ElementType sqrt2 = 1.41421356237309504880;
+    static constexpr ElementType subnormalScale = static_cast<ElementType>(IntType(1) << (C::mantissaBits + 2));
+
+    typename S::Mask subnormal = (typename S::Mask) (x < std::numeric_limits<ElementType>::min());
+    typename S::Vec xs = S::select(subnormal, x * subnormalScale, x);
+
+    typename S::Mask bits = (typename S::Mask) xs;
+    typename S::Mask e = ((bits >> C::mantissaBits) & ((IntType(1) << (sizeof(ElementType) * 8 - 1 - C::mantissaBits)) - 1)) - C::exponentBias;
+    e -= subnormal & static_cast<IntType>(C::mantissaBits + 2);
+    typename S::Vec m = (typename S::Vec) ((bits & ((IntType(1) << C::mantissaBits) - 1)) | (static_cast<IntType>(C::exponentBias) << C::mantissaBits));
+
+    // Keep m in [sqrt(1/2), sqrt(2)) so the series below converges quickly
+    typename S::Mask high = (typename S::Mask) (m > sqrt2);
+    m = S::select(high, m * static_cast<ElementType>(0.5), m);
+    e -= high;
+
+    // log(m) = 2 * atanh((m - 1) / (m + 1))
+    typename S::Vec s = (m - static_cast<ElementType>(1)) / (m + static_cast<ElementType>(1));
+    typename S::Vec s2 = s * s;
+    typename S::Vec sum = S::broadcast(static_cast<ElementType>(1) / (2 * C::logTerms - 1));
+    for (unsigned int i = C::logTerms - 1; i-- > 0;) {
+        sum = sum * s2 + static_cast<ElementType>(1) / (2 * i + 1);
+    }
+    typename S::Vec res = __builtin_convertvector(e, typename S::Vec) * ln2 + static_cast<ElementType>(2) * s * sum;
+
+    res = S::select((typename S::Mask) (x == static_cast<ElementType>(0)), S::broadcast(-std::numeric_limits<ElementType>::infinity()), res);
+    res = S::select((typename S::Mask) (x == std::numeric_limits<ElementType>::infinity()), x, res);
+    res = S::select((typename S::Mask) (x < static_cast<ElementType>(0)) | S::isNan(x), S::broadcast(std::numeric_limits<ElementType>::quiet_NaN()), res);
+    return res;
+}
+
+template <typename ElementType>
+typename Simd<ElementType>::Vec simdTanh(typename Simd<ElementType>::Vec x) {
+    typedef Simd<ElementType> S;
+    typedef simdmath::Consts<ElementType> C;
+
+    // Past this, tanh rounds to +/-1, and clamping keeps expm1 finite
+    x = S::select((typename S::Mask) (x > C::tanhSaturate), S::broadcast(C::tanhSaturate), x);
+    x = S::select((typename S::Mask) (x < -C::tanhSaturate), S::broadcast(-C::tanhSaturate), x);
+
+    typename S::Vec em1 = simdExpm1<ElementType>(x * static_cast<ElementType>(2));
+    return em1 / (em1 + static_cast<ElementType>(2));
+}
+
+template <typename ElementType>
+typename Simd<ElementType>::Vec simdSigmoid(typename Simd<ElementType>::Vec x) {
+    return static_cast<ElementType>(1) / (static_cast<ElementType>(1) + simdExp<ElementType>(-x));
+}
+
+}
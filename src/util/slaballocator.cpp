@@ -0,0 +1,229 @@
+#include "slaballocator.h"
+
+#include <mutex>
+#include <iterator>
+#include <new>
+#include <cstdint>
+#include <cassert>
+#include <sys/mman.h>
+
+#include "log.h"
+#include "app/options.h"
+
+namespace util {
+
+void *SlabAllocator::alloc(std::size_t size) {
+    std::size_t classSize = getClassSize(size);
+
+    std::lock_guard<SpinLock> guard(lock);
+    (void) guard;
+
+    if (classSize > slabSize / 4) {
+        // Too big to share a slab without wasting much of it
+        return mapRegion(classSize);
+    }
+
+    FreeList &freeList = freeLists[classSize];
+    FreeBlock *&head = freeList.resident ? freeList.resident : freeList.trimmed;
+    if (head) {
+        FreeBlock *block = head;
+        head = block->next;
+        freeSize -= getHeldSize(block, classSize);
+        findSlab(block)->second.usedSize += classSize;
+        return block;
+    }
+
+    if (static_cast<std::size_t>(slabEnd - slabPos) < classSize) {
+        if (slabPos) {
+            // The rest of the current slab becomes a free block of the biggest class that fits
+            std::size_t tailSize = slabEnd - slabPos;
+            tailSize -= tailSize % (tailSize < pageSize ? 64 : pageSize);
+            if (tailSize) {
+                pushFree(slabPos, tailSize);
+            }
+        }
+
+        slabPos = static_cast<char *>(mapRegion(slabSize));
+        slabEnd = slabPos + slabSize;
+        currentSlab = slabs.emplace(slabPos, Slab()).first;
+    }
+
+    void *res = slabPos;
+    slabPos += classSize;
+    currentSlab->second.usedSize += classSize;
+    return res;
+}
+
+void SlabAllocator::free(void *ptr, std::size_t size) {
+    std::size_t classSize = getClassSize(size);
+
+    std::lock_guard<SpinLock> guard(lock);
+    (void) guard;
+
+    if (classSize > slabSize / 4) {
+        unmapRegion(ptr, classSize);
+        return;
+    }
+
+    findSlab(ptr)->second.usedSize -= classSize;
+    pushFree(ptr, classSize);
+}
+
+std::size_t SlabAllocator::getFreeSize() {
+    std::lock_guard<SpinLock> guard(lock);
+    (void) guard;
+
+    return freeSize;
+}
+
+SlabAllocator::SlabIterator SlabAllocator::findSlab(void *ptr) {
+    SlabIterator slab = slabs.upper_bound(static_cast<char *>(ptr));
+    assert(slab != slabs.begin());
+    --slab;
+    assert(static_cast<char *>(ptr) < slab->first + slabSize);
+    return slab;
+}
+
+std::size_t SlabAllocator::trim(std::size_t size) {
+    std::lock_guard<SpinLock> guard(lock);
+    (void) guard;
+
+    std::size_t prevFreeSize = freeSize;
+
+    // Empty slabs go first, since nothing of them is left behind
+    SlabIterator slab = slabs.begin();
+    while (slab != slabs.end() && prevFreeSize - freeSize < size) {
+        SlabIterator next = std::next(slab);
+        if (slab->second.usedSize == 0 && slab != currentSlab) {
+            releaseSlab(slab);
+        }
+        slab = next;
+    }
+
+    for (std::pair<const std::size_t, FreeList> &freeList : freeLists) {
+        while (freeList.second.resident && prevFreeSize - freeSize < size) {
+            FreeBlock *block = freeList.second.resident;
+            freeList.second.resident = block->next;
+            trimBlock(block, freeList.first);
+            block->next = freeList.second.trimmed;
+            freeList.second.trimmed = block;
+        }
+    }
+
+    SPDLOG_DEBUG("Trimmed {} bytes of free chunk memory; {} bytes left", prevFreeSize - freeSize, freeSize);
+    return prevFreeSize - freeSize;
+}
+
+void SlabAllocator::pushFree(void *ptr, std::size_t classSize) {
+    FreeBlock *block = static_cast<FreeBlock *>(ptr);
+    block->releasedSize = 0;
+
+    FreeList &freeList = freeLists[classSize];
+    block->next = freeList.resident;
+    freeList.resident = block;
+    freeSize += classSize;
+}
+
+void SlabAllocator::trimBlock(FreeBlock *block, std::size_t classSize) {
+    if (classSize <= pageSize) {
+        return;
+    }
+
+    // Hand back whatever whole pages come after the free list link.
+    // Transparent hugepages get split by this, and explicit ones can only go whole.
+    bool isExplicit = app::Options::getInstance().chunkHugePages == app::Options::HugePages::Explicit;
+    std::uintptr_t granularity = isExplicit ? hugePageSize : pageSize;
+    std::uintptr_t begin = (reinterpret_cast<std::uintptr_t>(block + 1) + granularity - 1) / granularity * granularity;
+    std::uintptr_t end = (reinterpret_cast<std::uintptr_t>(block) + classSize) / granularity * granularity;
+    if (begin < end && madvise(reinterpret_cast<void *>(begin), end - begin, MADV_DONTNEED) == 0) {
+        block->releasedSize = end - begin;
+        freeSize -= block->releasedSize;
+    }
+}
+
+std::size_t SlabAllocator::getHeldSize(const FreeBlock *block, std::size_t classSize) {
+    return classSize - block->releasedSize;
+}
+
+void SlabAllocator::releaseSlab(SlabIterator slab) {
+    char *begin = slab->first;
+    char *end = begin + slabSize;
+
+    for (std::pair<const std::size_t, FreeList> &freeList : freeLists) {
+        purgeList(freeList.second.resident, begin, end, freeList.first);
+        purgeList(freeList.second.trimmed, begin, end, freeList.first);
+    }
+
+    slabs.erase(slab);
+    unmapRegion(begin, slabSize);
+}
+
+void SlabAllocator::purgeList(FreeBlock *&list, char *begin, char *end, std::size_t classSize) {
+    FreeBlock **link = &list;
+    while (*link) {
+        FreeBlock *block = *link;
+        if (reinterpret_cast<char *>(block) >= begin && reinterpret_cast<char *>(block) < end) {
+            *link = block->next;
+            freeSize -= getHeldSize(block, classSize);
+        } else {
+            link = &block->next;
+        }
+    }
+}
+
+std::size_t SlabAllocator::getClassSize(std::size_t size) {
+    // Keeps blocks cache-line aligned, and big blocks page aligned so the OS can back them with whole (huge)pages
+    std::size_t granularity = size < pageSize ? 64 : pageSize;
+    return (size + granularity - 1) / granularity * granularity;
+}
+
+void *SlabAllocator::mapRegion(std::size_t size) {
+    app::Options::HugePages hugePages = app::Options::getInstance().chunkHugePages;
+    size = (size + hugePageSize - 1) / hugePageSize * hugePageSize;
+
+#ifdef MAP_HUGETLB
+    if (hugePages == app::Options::HugePages::Explicit) {
+        void *res = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (res != MAP_FAILED) {
+            reservedSize += size;
+            SPDLOG_DEBUG("Mapped {} bytes of explicit hugepages for chunks; {} bytes reserved", size, reservedSize);
+            return res;
+        }
+        SPDLOG_WARN("Couldn't map {} bytes of explicit hugepages (is vm.nr_hugepages big enough?), falling back to regular pages", size);
+    }
+#endif
+
+    // Over-map so the region can be trimmed to a hugepage boundary
+    char *mapped = static_cast<char *>(mmap(nullptr, size + hugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (mapped == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+
+    char *res = reinterpret_cast<char *>((reinterpret_cast<std::uintptr_t>(mapped) + hugePageSize - 1) / hugePageSize * hugePageSize);
+    if (res != mapped) {
+        munmap(mapped, res - mapped);
+    }
+    if (res + size != mapped + size + hugePageSize) {
+        munmap(res + size, mapped + size + hugePageSize - (res + size));
+    }
+
+#ifdef MADV_HUGEPAGE
+    if (hugePages == app::Options::HugePages::Transparent) {
+        madvise(res, size, MADV_HUGEPAGE);
+    }
+#endif
+
+    reservedSize += size;
+    SPDLOG_DEBUG("Mapped {} bytes for chunks; {} bytes reserved", size, reservedSize);
+    return res;
+}
+
+void SlabAllocator::unmapRegion(void *ptr, std::size_t size) {
+    size = (size + hugePageSize - 1) / hugePageSize * hugePageSize;
+    munmap(ptr, size);
+
+    reservedSize -= size;
+    SPDLOG_DEBUG("Unmapped {} bytes for chunks; {} bytes reserved", size, reservedSize);
+}
+
+}
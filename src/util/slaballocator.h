@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <unordered_map>
+
+#include "util/spinlock.h"
+
+namespace util {
+
+// Hands out blocks carved from large mmap'd slabs, rounded up to a size class.
+// Freed blocks go on a per-class free list and get reused by the next allocation of that class, so they stay resident until trim() is called.
+// That hands everything past their first page back to the OS and unmaps slabs with nothing left in them, which the GC does when it's over its limit.
+// Blocks too big to share a slab get their own mapping, which is unmapped as soon as they're freed.
+class SlabAllocator {
+public:
+    static SlabAllocator &getInstance() {
+        static SlabAllocator instance;
+        return instance;
+    }
+
+    void *alloc(std::size_t size);
+    void free(void *ptr, std::size_t size);
+
+    static std::size_t getClassSize(std::size_t size);
+
+    std::size_t getReservedSize() const {
+        return reservedSize;
+    }
+
+    // What free blocks still take up, minus whatever trim() has handed back
+    std::size_t getFreeSize();
+
+    // Hands free memory back to the OS until at least size bytes are gone or there's nothing left to give, and returns how much went
+    std::size_t trim(std::size_t size);
+
+private:
+    static constexpr std::size_t pageSize = 4096;
+    static constexpr std::size_t hugePageSize = 2 << 20;
+    static constexpr std::size_t slabSize = 64 << 20;
+
+    struct FreeBlock {
+        FreeBlock *next;
+        std::size_t releasedSize;
+    };
+
+    // Blocks that still have all their pages are handed out first, so the trimmed ones only fault back in once those run out
+    struct FreeList {
+        FreeBlock *resident = nullptr;
+        FreeBlock *trimmed = nullptr;
+    };
+
+    struct Slab {
+        std::size_t usedSize = 0;
+    };
+    typedef std::map<char *, Slab>::iterator SlabIterator;
+
+    SpinLock lock;
+    std::unordered_map<std::size_t, FreeList> freeLists;
+    std::map<char *, Slab> slabs;
+
+    SlabIterator currentSlab;
+    char *slabPos = nullptr;
+    char *slabEnd = nullptr;
+    std::size_t reservedSize = 0;
+    std::size_t freeSize = 0;
+
+    void *mapRegion(std::size_t size);
+    void unmapRegion(void *ptr, std::size_t size);
+
+    SlabIterator findSlab(void *ptr);
+    void pushFree(void *ptr, std::size_t classSize);
+    void trimBlock(FreeBlock *block, std::size_t classSize);
+    static std::size_t getHeldSize(const FreeBlock *block, std::size_t classSize);
+    void releaseSlab(SlabIterator slab);
+    void purgeList(FreeBlock *&list, char *begin, char *end, std::size_t classSize);
+};
+
+}
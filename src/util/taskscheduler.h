@@ -2,31 +2,40 @@
 
 #include <cstdlib>
 #include <thread>
-#include <queue>
+#include <vector>
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
+#include <algorithm>
+#include <cstdint>
+
+#include "util/spinlock.h"
 
 namespace app { class AppContext; }
 
 namespace util {
 
+// Each worker owns a heap of tasks ordered by getOrdering(). Tasks spawned on a worker go to its own heap,
+// tasks added from outside the pool are spread round-robin, and idle workers steal the highest-ordered task from their peers.
+// Once a task has run, the scheduler calls its taskDone(), so whoever added it can keep it alive until then.
 template <typename TaskType>
 class TaskScheduler {
 public:
     TaskScheduler(app::AppContext &context, std::size_t numThreads = std::thread::hardware_concurrency())
         : numThreads(numThreads)
         , threads(numThreads ? new std::thread[numThreads] : 0)
+        , workers(numThreads ? new Worker[numThreads] : 0)
     {
         (void) context;
 
         for (std::size_t i = 0; i < numThreads; i++) {
-            threads[i] = std::thread(&TaskScheduler::worker, this);
+            threads[i] = std::thread(&TaskScheduler::worker, this, i);
         }
     }
 
     ~TaskScheduler() {
         {
-            std::lock_guard<std::mutex> lock(mutex);
+            std::lock_guard<std::mutex> lock(sleepMutex);
             (void) lock;
             running = false;
         }
@@ -38,54 +47,179 @@ public:
         }
 
         delete[] threads;
+        delete[] workers;
     }
 
     void addTask(TaskType *task) {
         if (numThreads) {
-            std::unique_lock<std::mutex> lock(mutex);
+            std::size_t workerIndex = currentScheduler == this ? currentWorker : nextWorker.fetch_add(1, std::memory_order_relaxed) % numThreads;
+
+            // Incremented before the push so a worker can never see the task without the count
+            outstanding.fetch_add(1);
+            pending.fetch_add(1);
+            workers[workerIndex].push(task);
 
-            queue.push(task);
-            cond.notify_one();
+            if (sleepers.load() != 0) {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                (void) lock;
+                cond.notify_one();
+            }
         } else {
             task->exec();
+            task->taskDone();
         }
     }
 
+    // Blocks until every task, including the ones spawned by running tasks, has finished.
+    // Returns whether there was anything to wait for.
+    bool waitIdle() {
+        if (outstanding.load() == 0) {
+            return false;
+        }
 
-private:
-    std::size_t numThreads;
-    std::thread *threads;
-    bool running = true;
+        while (outstanding.load() != 0) {
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    std::size_t getNumThreads() const {
+        return numThreads;
+    }
+
+    // Whether the calling thread is a worker, and so covered by hasPassed()
+    static bool isWorkerThread() {
+        return currentScheduler;
+    }
+
+    // For freeing memory that running tasks might still be reading, without waiting for the pool to go idle.
+    // Call this once nothing new can reach the memory, then free it when hasPassed() says every worker has been between tasks since.
+    std::uint64_t retireEpoch() {
+        return epoch.fetch_add(1) + 1;
+    }
 
+    bool hasPassed(std::uint64_t retired) const {
+        for (std::size_t i = 0; i < numThreads; i++) {
+            std::uint64_t pinned = workers[i].pinnedEpoch.load();
+            if (pinned != 0 && pinned < retired) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
     struct TaskOrder {
         bool operator()(const TaskType *left, const TaskType *right) const {
             return left->getOrdering() < right->getOrdering();
         }
     };
-    std::priority_queue<TaskType *, std::vector<TaskType *>, TaskOrder> queue;
 
-    std::mutex mutex;
+    struct alignas(64) Worker {
+        SpinLock lock;
+        std::vector<TaskType *> heap;
+
+        // The epoch this worker saw before it last went looking for a task, or zero while it's idle
+        std::atomic<std::uint64_t> pinnedEpoch = 0;
+
+        void push(TaskType *task) {
+            std::lock_guard<SpinLock> guard(lock);
+            (void) guard;
+            heap.push_back(task);
+            std::push_heap(heap.begin(), heap.end(), TaskOrder());
+        }
+
+        TaskType *pop() {
+            std::lock_guard<SpinLock> guard(lock);
+            (void) guard;
+            if (heap.empty()) {
+                return 0;
+            }
+            std::pop_heap(heap.begin(), heap.end(), TaskOrder());
+            TaskType *task = heap.back();
+            heap.pop_back();
+            return task;
+        }
+    };
+
+    static constexpr unsigned int spinsBeforeSleep = 64;
+
+    std::size_t numThreads;
+    std::thread *threads;
+    Worker *workers;
+    bool running = true;
+
+    // Tasks sitting in a heap
+    std::atomic<std::ptrdiff_t> pending = 0;
+    // Tasks sitting in a heap or running; children are counted before their parent finishes, so zero means idle
+    std::atomic<std::size_t> outstanding = 0;
+    std::atomic<std::size_t> sleepers = 0;
+    std::atomic<std::size_t> nextWorker = 0;
+    // Starts at one, since a pinned epoch of zero means idle
+    std::atomic<std::uint64_t> epoch = 1;
+
+    std::mutex sleepMutex;
     std::condition_variable cond;
 
-    static void workerFunc(TaskScheduler *scheduler) {
-        scheduler->worker();
+    static inline thread_local TaskScheduler *currentScheduler = 0;
+    static inline thread_local std::size_t currentWorker = 0;
+
+    TaskType *findTask(std::size_t workerIndex) {
+        TaskType *task = workers[workerIndex].pop();
+        for (std::size_t i = 1; !task && i < numThreads; i++) {
+            task = workers[(workerIndex + i) % numThreads].pop();
+        }
+        return task;
     }
 
-    void worker() {
-        std::unique_lock<std::mutex> lock(mutex);
+    void worker(std::size_t workerIndex) {
+        currentScheduler = this;
+        currentWorker = workerIndex;
+
+        std::atomic<std::uint64_t> &pinnedEpoch = workers[workerIndex].pinnedEpoch;
+
+        unsigned int spins = 0;
         while (true) {
-            if (queue.empty()) {
-                if (!running) {break;}
-                cond.wait(lock);
-            } else {
-                TaskType *task = queue.top();
-                queue.pop();
+            // Taking a task out of a heap compares the ones around it, which reads them too
+            pinnedEpoch.store(epoch.load());
 
-                lock.unlock();
+            TaskType *task = findTask(workerIndex);
+            if (task) {
+                pending.fetch_sub(1);
                 task->exec();
-                lock.lock();
+                task->taskDone();
+                outstanding.fetch_sub(1);
+                spins = 0;
+                continue;
+            }
+
+            pinnedEpoch.store(0);
+
+            if (pending.load() != 0) {
+                // Some task is between being counted and being pushed
+                std::this_thread::yield();
+                continue;
+            }
+
+            if (spins < spinsBeforeSleep) {
+                spins++;
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleepers.fetch_add(1);
+            while (pending.load() == 0 && running) {
+                cond.wait(lock);
+            }
+            sleepers.fetch_sub(1);
+            if (pending.load() == 0 && !running) {
+                break;
             }
+            spins = 0;
         }
+
+        currentScheduler = 0;
     }
 };
 
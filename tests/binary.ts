@@ -306,4 +306,65 @@ export default [
       9: { z: 0 },
     },
   },
+  {
+    name: `Test fused chain`,
+    variant: 'test-csl2-6',
+    input: {
+      0: { x: NaN, y: NaN },
+      1: { x: 4, y: 7 },
+      2: { x: NaN, y: 8 },
+      3: { x: 2, y: -5 },
+      4: { x: 6, y: NaN },
+      5: { x: -7, y: 22 },
+      6: { x: 6, y: 1 },
+      7: { x: 123, y: 0 },
+      8: { x: 7, y: 7 },
+      9: { x: 0, y: 234 },
+    },
+    program: add(mul(sub(r(input('x')), r(input('y'))), r(2)), r(input('y'))),
+    output: {
+      0: { z: NaN },
+      1: { z: 1 },
+      2: { z: NaN },
+      3: { z: 9 },
+      4: { z: NaN },
+      5: { z: -36 },
+      6: { z: 11 },
+      7: { z: 246 },
+      8: { z: 7 },
+      9: { z: -234 },
+    },
+  },
+  {
+    name: `Test fused chain with shared intermediate`,
+    variant: 'test-csl2-6',
+    input: {
+      0: { x: NaN, y: NaN },
+      1: { x: 4, y: 7 },
+      2: { x: NaN, y: 8 },
+      3: { x: 2, y: -5 },
+      4: { x: 6, y: NaN },
+      5: { x: -7, y: 22 },
+      6: { x: 6, y: 1 },
+      7: { x: 123, y: 0 },
+      8: { x: 7, y: 7 },
+      9: { x: 0, y: 234 },
+    },
+    program: mul(
+      sub(r(input('x')), r(input('y'))),
+      add(sub(r(input('x')), r(input('y'))), r(1)),
+    ),
+    output: {
+      0: { z: NaN },
+      1: { z: 6 },
+      2: { z: NaN },
+      3: { z: 56 },
+      4: { z: NaN },
+      5: { z: 812 },
+      6: { z: 30 },
+      7: { z: 15252 },
+      8: { z: 0 },
+      9: { z: 54522 },
+    },
+  },
 ];
@@ -0,0 +1,74 @@
+import {
+  abs,
+  add,
+  conv,
+  d,
+  div,
+  input,
+  min,
+  mul,
+  sub,
+  windowDelta,
+  windowRect,
+  windowSimple,
+  windowSmooth,
+} from '../ts/base.ts';
+import { Node } from '../ts/types.ts';
+import { range } from '../ts/util.ts';
+
+const r = d;
+
+// Enough chunks of the test variant for the widest kernel to reach back over several of them
+const numRows = 700;
+
+const rows = [...Array(numRows)].map((_, i) => ({
+  x: Math.sin(i * 0.37) + (i % 11 === 0 ? 0.5 : 0),
+}));
+const inputSpec = Object.fromEntries(rows.map((row, i) => [i, row]));
+
+const x = r(input('x'));
+
+// Convolutions of the same ts share a ConvBank, and compute the prior chunks of a chunk together.
+// Each one is checked against the same convolution of a copy of the ts that nothing else convolves, so it computes alone.
+// The copies have to be different nodes, or the program would deduplicate them back into x.
+const copies: Node[] = [
+  add(x, r(0)),
+  sub(x, r(0)),
+  mul(x, r(1)),
+  div(x, r(1)),
+  min(x, r(1e300)),
+];
+const windows = [
+  windowRect(r(100)),
+  windowSimple(r(30)),
+  windowSmooth(r(20)),
+  windowDelta(r(50)),
+  windowRect(r(300)),
+];
+
+const program = windows
+  .map((window, i) =>
+    abs(sub(conv(window, x, true), conv(window, copies[i], true)))
+  )
+  .reduce((a, b) => add(a, b));
+
+export default [
+  // All the input is there before the chunks are created, like a backfill
+  {
+    name: 'Test grouped convolutions match separate ones',
+    variant: 'test-csl2-6',
+    input: inputSpec,
+    program,
+    output: { 0: { z: 0 }, [numRows - 1]: {} },
+  },
+
+  // The chunks are created before their input arrives
+  {
+    name: 'Test grouped convolutions match separate ones with yields',
+    variant: 'test-csl2-6',
+    input: inputSpec,
+    yields: range(0, numRows, 50),
+    program,
+    output: { 0: { z: 0 }, [numRows - 1]: {} },
+  },
+];
@@ -0,0 +1,92 @@
+import { add, d, input, mul } from '../ts/base.ts';
+import { range } from '../ts/util.ts';
+
+const r = d;
+
+// Records of --input-format binary, see stream/binaryunwrapper.h. Each is prefixed with its size, and everything is little-endian here.
+const record = (type: string, body: number[]) => {
+  const size = new DataView(new ArrayBuffer(4));
+  size.setUint32(0, body.length + 1, true);
+  return [...new Uint8Array(size.buffer), type.charCodeAt(0), ...body];
+};
+const uint32 = (value: number) => {
+  const view = new DataView(new ArrayBuffer(4));
+  view.setUint32(0, value, true);
+  return [...new Uint8Array(view.buffer)];
+};
+const values = (vals: number[], isDouble: boolean) => {
+  const width = isDouble ? 8 : 4;
+  const view = new DataView(new ArrayBuffer(vals.length * width));
+  vals.forEach((val, i) =>
+    isDouble
+      ? view.setFloat64(i * width, val, true)
+      : view.setFloat32(i * width, val, true)
+  );
+  return [...new Uint8Array(view.buffer)];
+};
+
+const header = (names: string[]) => {
+  const body = [...uint32(names.length)];
+  for (const name of names) {
+    body.push(name.length & 0xff, name.length >> 8, ...[...name].map((c) => c.charCodeAt(0)));
+  }
+  return record('H', body);
+};
+
+// rows[i][c] is the value of column c in row i
+const block = (type: string, rows: number[][]) => {
+  const isDouble = type === 'R' || type === 'C';
+  const isRowMajor = type === 'r' || type === 'R';
+  const vals = isRowMajor
+    ? rows.flat()
+    : range(rows[0].length).flatMap((c) => rows.map((row) => row[c]));
+  return record(type, [...uint32(rows.length), ...values(vals, isDouble)]);
+};
+
+// The test variant has 64 rows per chunk
+const xs = range(0, 150).map((i) =>
+  i < 40 ? i * 0.5 : i < 100 ? i / 3 : i < 130 ? NaN : i + 0.25
+);
+const ys = range(0, 150).map((i) =>
+  i < 40 ? -i : i < 100 ? Math.sin(i) : i < 130 ? i * 2 : i % 3 === 0 ? NaN : i
+);
+const rowsOf = (begin: number, end: number, columns: number[][]) =>
+  range(begin, end).map((i) => columns.map((column) => column[i]));
+
+const bytes = new Uint8Array([
+  // Discarded, since there aren't any columns to put it in yet
+  ...block('r', [[1], [2], [3]]),
+
+  ...header(['x', 'y']),
+  ...block('r', rowsOf(0, 40, [xs, ys])),
+  // Crosses into the second chunk
+  ...block('C', rowsOf(40, 100, [xs, ys])),
+
+  // x is missing from this header, so it keeps its last value
+  ...header(['y']),
+  ...block('R', rowsOf(100, 130, [ys])),
+
+  // Float values, with NaN for missing ones
+  ...header(['x', 'y']),
+  ...block('c', rowsOf(130, 150, [xs, ys])),
+]);
+
+const output = Object.fromEntries(
+  range(0, 150).map((i) => {
+    const isFloat = i < 40 || i >= 130;
+    const x = i >= 100 && i < 130 ? xs[99] : isFloat ? Math.fround(xs[i]) : xs[i];
+    const y = isFloat ? Math.fround(ys[i]) : ys[i];
+    return [i, { z: x + y * 1000 }];
+  }),
+);
+
+export default [
+  {
+    name: 'Test binary input',
+    variant: 'test-csl2-6',
+    input: bytes,
+    program: add(r(input('x')), mul(r(input('y')), r(1000))),
+    output,
+    flags: ['--input-format', 'binary'],
+  },
+];
@@ -0,0 +1,50 @@
+import { add, d, gt, input, isNan, mul, sub } from '../ts/base.ts';
+import { range } from '../ts/util.ts';
+
+const r = d;
+
+// Doesn't end on a whole mask word, so the last one is never complete
+const numRows = 300;
+
+const rows = [...Array(numRows)].map((_, i) => ({
+  x: Math.sin(i * 0.37),
+  y: i % 7 === 3 ? NaN : i,
+}));
+const inputSpec = Object.fromEntries(rows.map((row, i) => [i, row]));
+
+const x = r(input('x'));
+const y = r(input('y'));
+
+// Each predicate has two consumers in the fused chain, so they read it as a shared bitmask
+const p = gt(x, r(0.3));
+const q = isNan(y);
+const program = add(
+  add(mul(p, x), sub(x, p)),
+  add(mul(q, r(10)), sub(r(1), q)),
+);
+
+const output = Object.fromEntries(rows.map((row, i) => {
+  const pv = row.x > 0.3 ? 1 : 0;
+  const qv = Number.isNaN(row.y) ? 1 : 0;
+  return [i, { z: (pv * row.x + (row.x - pv)) + (qv * 10 + (1 - qv)) }];
+}));
+
+export default [
+  {
+    name: 'Test predicates shared as masks',
+    variant: 'test-csl2-6',
+    input: inputSpec,
+    program,
+    output,
+  },
+
+  // The masks lag behind their operands by up to a word, so consumers compute the rest from the operands
+  {
+    name: 'Test predicates shared as masks with yields',
+    variant: 'test-csl2-6',
+    input: inputSpec,
+    yields: range(0, numRows, 50),
+    program,
+    output,
+  },
+];
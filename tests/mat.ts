@@ -0,0 +1,82 @@
+import {
+  abs,
+  add,
+  d,
+  decayingSum,
+  delay,
+  gt,
+  i64,
+  input,
+  mul,
+  sub,
+} from '../ts/base.ts';
+import { mCov, mPca } from '../ts/mat.ts';
+import { Node } from '../ts/types.ts';
+import { range } from '../ts/util.ts';
+import { matVecMul, norm } from '../ts/vec.ts';
+
+const r = d;
+
+// Enough chunks of the test variant for the decayed state to be carried over several of them
+const numRows = 512;
+const size = 3;
+
+const rows = [...Array(numRows)].map((_, t) =>
+  Object.fromEntries(
+    range(size).map((i) => [
+      `x${i}`,
+      t === 100 && i === 1
+        ? NaN
+        : Math.sin(t * (0.3 + i * 0.17)) + (t % (i + 5) === 0 ? 0.5 : 0),
+    ]),
+  )
+);
+const inputSpec = Object.fromEntries(rows.map((row, t) => [t, row]));
+
+const xs = range(size).map((i) => r(input(`x${i}`)));
+const initialVec = [1, 0.5, -0.25];
+const iters = 8;
+
+// What mCov() and mPca() build without the native kernels, a series per entry
+const scalarCov = (window: number) =>
+  xs.map((x0) => xs.map((x1) => decayingSum(mul(x0, x1), r(1 / window))));
+const scalarPca = (window: number) =>
+  range(iters).reduce(
+    (acc) => matVecMul(scalarCov(window), norm(acc)),
+    initialVec.map(r),
+  );
+
+// Counts the entries where the native kernels differ from the scalar graph, so everything should come out zero.
+// Every channel is read, so they all share each block.
+const countMisses = (window: number) =>
+  [
+    ...mCov(window, xs).flat().map((entry, i) => [entry, scalarCov(window).flat()[i]]),
+    ...mPca(window, xs, initialVec.map(r), iters).map((entry, i) => [entry, scalarPca(window)[i]]),
+  ]
+    .map(([native, scalar]) => gt(abs(sub(native, scalar)), r(1e-9)))
+    .reduce((a, b) => add(a, b));
+
+const program: Node = add(countMisses(5), countMisses(20));
+
+const lag = 200;
+
+export default [
+  {
+    name: 'Test native matrix kernels match the scalar graph',
+    variant: 'test-csl2-6',
+    input: inputSpec,
+    program,
+    output: { 0: { z: 0 }, [numRows - 1]: {} },
+  },
+
+  // With the GC freeing everything it can, reading a few chunks back has blocks recomputed,
+  // sometimes after the end state of the block before them is gone
+  {
+    name: 'Test native matrix kernels match the scalar graph when recomputed',
+    variant: 'test-csl2-6',
+    input: inputSpec,
+    program: add(program, delay(program, i64(r(lag)))),
+    output: { 0: { z: NaN }, [lag]: { z: 0 }, [numRows - 1]: {} },
+    flags: ['--gc-memory-limit', '0'],
+  },
+];
@@ -0,0 +1,82 @@
+import {
+  abs,
+  add,
+  conv,
+  d,
+  delay,
+  gt,
+  i64,
+  input,
+  recursiveDelta,
+  recursiveSimple,
+  recursiveSmooth,
+  sub,
+  windowDelta,
+  windowSimple,
+  windowSmooth,
+} from '../ts/base.ts';
+import { Node } from '../ts/types.ts';
+
+const r = d;
+
+// Enough chunks of the test variant for the filter state to be carried over several of them
+const numRows = 512;
+
+// Steps and a wave, so there's something for every window to smooth
+const rows = [...Array(numRows)].map((_, i) => ({
+  x: (i % 97 < 40 ? 1 : -0.5) + Math.sin(i * 0.11),
+}));
+const inputSpec = Object.fromEntries(rows.map((row, i) => [i, row]));
+
+const x = r(input('x'));
+
+// The error ts/base.ts documents for each order, times how far the input goes from zero
+const maxAbs = Math.max(...rows.map((row) => Math.abs(row.x)));
+const tolerances = [4e-2, 6e-4, 7e-6, 1e-6].map((tol) => tol * maxAbs);
+
+// Counts the samples where a recursive filter is further off its conv() than its order allows, so everything should come out zero
+const countMisses = (scale: number) =>
+  tolerances
+    .flatMap((tol, i) => {
+      const order = i + 1;
+      return [
+        [
+          recursiveSimple(r(scale), x, true, order),
+          conv(windowSimple(r(scale)), x, true),
+        ],
+        [
+          recursiveSmooth(r(scale), x, r(2), true, order),
+          conv(windowSmooth(r(scale)), x, true),
+        ],
+        [
+          recursiveDelta(r(scale), x, r(2), true, order),
+          conv(windowDelta(r(scale)), x, true),
+        ],
+      ].map(([rec, ref]) => gt(abs(sub(rec, ref)), r(tol)));
+    })
+    .reduce((a, b) => add(a, b));
+
+const program: Node = add(countMisses(5), countMisses(20));
+
+const lag = 200;
+
+export default [
+  {
+    name: 'Test recursive gaussians match conv',
+    variant: 'test-csl2-6',
+    input: inputSpec,
+    program,
+    output: { 0: { z: 0 }, [numRows - 1]: {} },
+  },
+
+  // With the GC freeing everything it can, reading the filters a few chunks back has them recompute chunks
+  // whose previous chunk might still be around without its end state
+  {
+    name: 'Test recursive gaussians match conv when recomputed',
+    variant: 'test-csl2-6',
+    input: inputSpec,
+    program: add(program, delay(program, i64(r(lag)))),
+    output: { 0: { z: NaN }, [lag]: { z: 0 }, [numRows - 1]: {} },
+    flags: ['--gc-memory-limit', '0'],
+  },
+];
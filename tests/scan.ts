@@ -0,0 +1,82 @@
+import {
+  cumLogSumExp,
+  cumProd,
+  cumSum,
+  d,
+  decayingSum,
+  fwdFillZero,
+  input,
+  monotonify,
+} from '../ts/base.ts';
+import { Node } from '../ts/types.ts';
+
+const r = d;
+
+// Spans a few chunks of the test variant, so every chunk but the first has a carry to fold in
+const numRows = 300;
+
+// Some zeros for fwd_fill_zero, and p stays close to 1 so cum_prod neither vanishes nor blows up
+const rows = [...Array(numRows)].map((_, i) => ({
+  x: i % 7 === 0 ? 0 : (((i * 37) % 23) - 11) / 8,
+  p: 1 + (((i * 13) % 9) - 4) / 64,
+}));
+const inputSpec = Object.fromEntries(rows.map((row, i) => [i, row]));
+
+// Scans in order, like ScannedSeries does when the previous chunk is already done
+const scan = (
+  column: 'x' | 'p',
+  op: (a: number, b: number) => number,
+  initialValue: number,
+) => {
+  let value = initialValue;
+  return Object.fromEntries(
+    rows.map((row, i) => [i, { z: (value = op(value, row[column])) }]),
+  );
+};
+
+const logSumExp = (a: number, b: number) => {
+  const max = Math.max(a, b);
+  return Math.log(Math.exp(a - max) + Math.exp(b - max)) + max;
+};
+
+// Each scan runs once as is and once with --scan-split, which makes every chunk scan its own elements first and apply the carry after.
+// Both have to match the in-order result.
+const scanTests = (
+  name: string,
+  program: Node,
+  column: 'x' | 'p',
+  op: (a: number, b: number) => number,
+  initialValue: number,
+) =>
+  [[], ['--scan-split']].map((flags) => ({
+    name: `Test ${name}${flags.length ? ' split' : ''}`,
+    variant: 'test-csl2-6',
+    input: inputSpec,
+    program,
+    output: scan(column, op, initialValue),
+    flags,
+  }));
+
+const x = r(input('x'));
+const p = r(input('p'));
+
+export default [
+  ...scanTests('cum_sum', cumSum(x), 'x', (a, b) => a + b, 0),
+  ...scanTests('cum_prod', cumProd(p), 'p', (a, b) => a * b, 1),
+  ...scanTests('monotonify', monotonify(x), 'x', Math.max, -Infinity),
+  ...scanTests('cum_log_sum_exp', cumLogSumExp(x), 'x', logSumExp, 0),
+  ...scanTests(
+    'fwd_fill_zero',
+    fwdFillZero(x),
+    'x',
+    (a, b) => (b === 0 ? a : b),
+    0,
+  ),
+  ...scanTests(
+    'decaying_sum',
+    decayingSum(x, r(0.1)),
+    'x',
+    (a, b) => a * (1 - 0.1) + b * 0.1,
+    0,
+  ),
+];
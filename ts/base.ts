@@ -146,11 +146,15 @@ export const triCond = (
 ): Node => node('tri_cond', a, b, c, d);
 export const nanTo = (a: Node, b: Node): Node => node('nan_to', a, b);
 
+// cumSum, cumProd, cumLogSumExp, monotonify, fwdFillZero and decayingSum with a constant rate can scan a chunk before the one before it is done,
+// and fold that one's last value in after. That rounds differently than scanning in order, and which chunks go that way depends on thread timing,
+// so results aren't bitwise reproducible between runs, and --chunk-cache-dir keeps whichever came out first.
 export const cumSum = (a: Node): Node => node('cum_sum', a);
 export const cumSumClamped = (a: Node): Node => node('cum_sum_clamped', a);
 export const decayingSum = (a: Node, b: Node): Node =>
   node('decaying_sum', a, b);
 export const cumProd = (a: Node): Node => node('cum_prod', a);
+export const cumLogSumExp = (a: Node): Node => node('cum_log_sum_exp', a);
 export const fwdFillZero = (a: Node): Node => node('fwd_fill_zero', a);
 export const subDelta = (a: Node): Node => node('sub_delta', a);
 export const divDelta = (a: Node): Node => node('div_delta', a);
@@ -161,6 +165,21 @@ export const scanIf = (a: Node, b: Node, c: Node): Node =>
 
 export const dot = (a: Node[], b: Node[]): Node => node('dot', arr(a), arr(b));
 
+// These return an array of series, one per channel, which at() picks from
+export const at = (a: Node, i: number): Node => node('at', a, i64(i));
+export const covDecay = (a: Node[], rate: Node): Node =>
+  node('cov_decay', arr(a), rate);
+export const pcaDecay = (
+  a: Node[],
+  rate: Node,
+  initialVec: Node[],
+  iters: number,
+): Node => node('pca_decay', arr(a), rate, arr(initialVec), i64(iters));
+export const regressDecay = (y: Node, xs: Node[], rate: Node): Node =>
+  node('regress_decay', y, arr(xs), rate);
+export const solve = (A: Node[], b: Node[]): Node =>
+  node('solve', arr(A), arr(b));
+
 export const windowRect = (scale_0: Node): Window => {
   const width = i64(scale_0);
   return { name: 'windowRect', width, kernel: norm(toTs(inv(scale_0)), width) };
@@ -232,6 +251,67 @@ export const conv = (
 ): Node =>
   node('conv', kernel, ts, info(`${name} width`, width), backfillZeros);
 
+// Recursive approximations of conv() with windowSimple, windowSmooth and windowDelta.
+// They cost the same per sample whatever the scale, and are off from the conv() by up to roughly 4e-2, 6e-4, 7e-6 or 1e-6 of the input's magnitude for order 1 to 4.
+const recursiveWidth = (scale: Node, precision: number): Node =>
+  i64(add(mul(d(Math.sqrt(-Math.log(precision))), scale), d(1.0)));
+
+export const recursiveSimple = (
+  scale_0: Node,
+  ts: Node,
+  backfillZeros: boolean = false,
+  order = 3,
+  precision = 1e-9,
+): Node =>
+  node(
+    'recursive_gaussian',
+    ts,
+    scale_0,
+    recursiveWidth(scale_0, precision),
+    i64(order),
+    backfillZeros,
+  );
+
+export const recursiveSmooth = (
+  scale_0: Node,
+  ts: Node,
+  scale_1_mult: Node = d(2),
+  backfillZeros: boolean = false,
+  order = 3,
+  precision = 1e-9,
+): Node => {
+  const scale_1 = mul(scale_0, scale_1_mult);
+  return node(
+    'recursive_gaussian_smooth',
+    ts,
+    scale_0,
+    scale_1,
+    recursiveWidth(max(scale_0, scale_1), precision),
+    i64(order),
+    backfillZeros,
+  );
+};
+
+export const recursiveDelta = (
+  scale_0: Node,
+  ts: Node,
+  scale_1_mult: Node = d(2),
+  backfillZeros: boolean = false,
+  order = 3,
+  precision = 1e-9,
+): Node => {
+  const scale_1 = mul(scale_0, scale_1_mult);
+  return node(
+    'recursive_gaussian_delta',
+    ts,
+    scale_0,
+    scale_1,
+    recursiveWidth(max(scale_0, scale_1), precision),
+    i64(order),
+    backfillZeros,
+  );
+};
+
 export const norm = (a: Node, size: Node, zeroOutside = true): Node =>
   node(
     'norm',
@@ -1,13 +1,41 @@
 import { Node, Window } from './types.ts';
-import { checkEq, delay, div, i64, mul, square, sub } from './base.ts';
+import {
+  at,
+  checkEq,
+  covDecay,
+  delay,
+  div,
+  i64,
+  mul,
+  pcaDecay,
+  regressDecay,
+  solve,
+  square,
+  sub,
+  toConst,
+} from './base.ts';
 import { r } from './config.ts';
 import { zip } from './hof.ts';
 import { decay } from './memory.ts';
 import { assert, range } from './util.ts';
 import { dot, matVecMul, norm } from './vec.ts';
 
-export const mCov = (covWindow: Window | number, centeredSeries: Node[]) =>
-  centeredSeries.map((s0, i0) =>
+// With a plain decay window, these compute the whole matrix in one multi-channel series natively,
+// instead of a series per entry. Other windows still go through conv().
+
+const unpack = (channels: Node, size: number) =>
+  range(size).map((i) => at(channels, i));
+
+export const mCov = (covWindow: Window | number, centeredSeries: Node[]) => {
+  if (typeof covWindow === 'number') {
+    const n = centeredSeries.length;
+    const channels = covDecay(centeredSeries, r(1 / covWindow));
+    return range(n).map((i0) =>
+      range(n).map((i1) => at(channels, i0 * n + i1))
+    );
+  }
+
+  return centeredSeries.map((s0, i0) =>
     centeredSeries.map((s1, i1) =>
       decay(
         covWindow,
@@ -19,6 +47,7 @@ export const mCov = (covWindow: Window | number, centeredSeries: Node[]) =>
       )
     )
   );
+};
 
 export const mPca = (
   covWindow: Window | number,
@@ -26,6 +55,22 @@ export const mPca = (
   initialVec: Node[],
   iters = 8,
 ) => {
+  const initialConsts = initialVec.map(toConst);
+  if (
+    typeof covWindow === 'number' &&
+    initialConsts.every((x) => x !== undefined)
+  ) {
+    return unpack(
+      pcaDecay(
+        centeredSeries,
+        r(1 / covWindow),
+        initialConsts.map((x) => r(x!)),
+        iters,
+      ),
+      centeredSeries.length,
+    );
+  }
+
   const mat = mCov(covWindow, centeredSeries);
 
   return range(iters).reduce(
@@ -36,6 +81,13 @@ export const mPca = (
 
 export const mSolve = (A: Node[][], b: Node[]) => {
   assert(A.length === b.length);
+  if (
+    A.every((x) => x.length === b.length) &&
+    [...A.flat(), ...b].every((x) => toConst(x) === undefined)
+  ) {
+    return unpack(solve(A.flat(), b), b.length);
+  }
+
   let mat = A.map((x, i) => {
     assert(x.length === b.length);
     return [...x, b[i]];
@@ -95,6 +147,13 @@ export const mPredict = (
 ) => {
   const train = centeredXs.map((x) => delay(x, i64(delayTicks)));
 
+  if (typeof covWindow === 'number') {
+    return unpack(
+      regressDecay(y, train, r(1 / covWindow)),
+      centeredXs.length,
+    );
+  }
+
   const mat = mCov(covWindow, [y, ...train]);
   const coefs = mSolve(
     mat.slice(1).map((r) => r.slice(1)),
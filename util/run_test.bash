@@ -8,13 +8,14 @@
 # echo "Input: $3"
 # echo "Program: $4"
 # echo "Output: $5"
+# echo "Flags: $6"
 
 TMP_DIR=$(mktemp -d)
 printf "$3" > $TMP_DIR/input.jsons
 printf "$4" > $TMP_DIR/program.jsons
 printf "$5" > $TMP_DIR/expected_output.jsons
 
-cmd="'$2' --require-existing-wisdom --dont-write-wisdom --wisdom-dir wisdom --log-level warn --emit-format json $TMP_DIR/program.jsons $TMP_DIR/input.jsons"
+cmd="'$2' --require-existing-wisdom --dont-write-wisdom --wisdom-dir wisdom --log-level warn --emit-format json $6 $TMP_DIR/program.jsons $TMP_DIR/input.jsons"
 
 eval $cmd > $TMP_DIR/actual_output.jsons & pid=$!
 ( sleep 5 ; kill $pid ) & watcher=$!
@@ -4,6 +4,9 @@ import { stringify } from '../ts/stringify.ts';
 
 const variant = Deno.args[0];
 
+// Sanitizer variants run the same tests as the variant they're based on
+const testVariant = variant.replace(/-tsan$/, '');
+
 const computeWisdom = false;
 
 // Generate wisdom before so our tests don't time out
@@ -39,6 +42,10 @@ const processJsonStream = (
   return serializeLines(arr2);
 };
 
+// Raw bytes, like for --input-format binary, as escapes that printf turns back into them
+const processBinaryStream = (bytes: Uint8Array) =>
+  [...bytes].map((byte) => '\\x' + byte.toString(16).padStart(2, '0')).join('');
+
 const processProgram = (spec: Node) => serializeLines([[['emit', 'z', spec]]]);
 
 const serializeLines = (lines: any[]) =>
@@ -60,16 +67,19 @@ const serializeLines = (lines: any[]) =>
       yields: any;
       program: any;
       output: any;
+      flags?: string[];
     }[] = (await import(`../${file}`)).default;
 
     tests
       .filter((test) =>
         Array.isArray(test.variant)
-          ? test.variant.includes(variant)
-          : test.variant === variant,
+          ? test.variant.includes(testVariant)
+          : test.variant === testVariant,
       )
-      .forEach(({ name, input, yields, program, output }) => {
-        input = processJsonStream(input, yields);
+      .forEach(({ name, input, yields, program, output, flags }) => {
+        input = input instanceof Uint8Array
+          ? processBinaryStream(input)
+          : processJsonStream(input, yields);
         program = processProgram(program);
         output = processJsonStream(output);
 
@@ -77,7 +87,7 @@ const serializeLines = (lines: any[]) =>
         console.log(
           `: $(BIN_TARGET) ${
             computeWisdom ? 'fftw_wisdom_float.bin fftw_wisdom_double.bin' : ''
-          } |> ^ bash util/run_test.bash '${variant} - ${file} - ${name}' [arguments omitted]^ bash util/run_test.bash '${variant} - ${file} - ${name}' '$(BIN_TARGET)' '${input}' '${program}' '${output}' |>`,
+          } |> ^ bash util/run_test.bash '${variant} - ${file} - ${name}' [arguments omitted]^ bash util/run_test.bash '${variant} - ${file} - ${name}' '$(BIN_TARGET)' '${input}' '${program}' '${output}' '${(flags || []).join(' ')}' |>`,
         );
       });
   }